@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <lib/memory_stats.h>
+#include <lib/parser.h>
+
+#include "script_generator.h"
+
+// Throughput of Lexer::GetTokens and Parser::ParseCode on generated scripts
+// of every standard shape, from 1 MiB up to the size given on the command
+// line (in MiB, 16 by default). Times are the best of a few runs; peak
+// memory is measured in a separate run with allocation accounting on, as
+// the highest number of live bytes allocated while each phase ran.
+
+namespace {
+
+constexpr size_t kMiB = 1 << 20;
+
+size_t CountNodes(const AST::BaseNode *node);
+
+size_t CountNodes(const std::vector<std::unique_ptr<AST::BaseNode>> &nodes) {
+  size_t count = 0;
+  for (const auto &node : nodes) {
+    count += CountNodes(node.get());
+  }
+  return count;
+}
+
+size_t CountNodes(const AST::BaseNode *node) {
+  if (node == nullptr) {
+    return 0;
+  }
+  size_t count = 1;
+  if (auto call = dynamic_cast<const AST::CallNode *>(node)) {
+    count += CountNodes(call->object.get()) + CountNodes(call->args);
+  } else if (auto list = dynamic_cast<const AST::ListNode *>(node)) {
+    count += CountNodes(list->list);
+  } else if (auto dict = dynamic_cast<const AST::DictNode *>(node)) {
+    for (const auto &[key, value] : dict->entries) {
+      count += CountNodes(key.get()) + CountNodes(value.get());
+    }
+  } else if (auto index = dynamic_cast<const AST::IndexNode *>(node)) {
+    count += CountNodes(index->object.get()) + CountNodes(index->index.get());
+  } else if (auto slice = dynamic_cast<const AST::SliceNode *>(node)) {
+    count += CountNodes(slice->object.get()) +
+             CountNodes(slice->start.get()) + CountNodes(slice->end.get());
+  } else if (auto bin = dynamic_cast<const AST::BinOperationNode *>(node)) {
+    count += CountNodes(bin->left.get()) + CountNodes(bin->right.get());
+  } else if (auto unary = dynamic_cast<const AST::UnaryOperationNode *>(node)) {
+    count += CountNodes(unary->node.get());
+  } else if (auto block = dynamic_cast<const AST::BlockNode *>(node)) {
+    count += CountNodes(block->nodes);
+  } else if (auto assign = dynamic_cast<const AST::AssignmentNode *>(node)) {
+    count += CountNodes(assign->value.get());
+  } else if (auto assign =
+                 dynamic_cast<const AST::IndexAssignmentNode *>(node)) {
+    count += CountNodes(assign->indices) + CountNodes(assign->value.get());
+  } else if (auto if_node = dynamic_cast<const AST::IfNode *>(node)) {
+    count += CountNodes(if_node->conditional.get()) +
+             CountNodes(if_node->then.get()) +
+             CountNodes(if_node->eelse.get());
+    for (const auto &[cond, then] : if_node->else_if) {
+      count += CountNodes(cond.get()) + CountNodes(then.get());
+    }
+  } else if (auto while_node = dynamic_cast<const AST::WhileNode *>(node)) {
+    count += CountNodes(while_node->conditional.get()) +
+             CountNodes(while_node->then.get());
+  } else if (auto for_node = dynamic_cast<const AST::ForNode *>(node)) {
+    count += CountNodes(for_node->conditional.get()) +
+             CountNodes(for_node->then.get());
+  } else if (auto func = dynamic_cast<const AST::FunctionNode *>(node)) {
+    count += CountNodes(func->args) + CountNodes(func->then.get());
+  } else if (auto ret = dynamic_cast<const AST::ReturnNode *>(node)) {
+    count += CountNodes(ret->value.get());
+  } else if (auto yield = dynamic_cast<const AST::YieldNode *>(node)) {
+    count += CountNodes(yield->value.get());
+  }
+  return count;
+}
+
+std::vector<Token> Lex(const std::string &source) {
+  std::istringstream input(source);
+  return Lexer(input).GetTokens();
+}
+
+template <class F> double BestSeconds(int runs, F run) {
+  double best = 1e300;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Highest live bytes allocated while `run` ran, over what was live before.
+template <class F> double PeakMiB(F run) {
+  MemoryStats::Reset();
+  MemoryStats::Enable();
+  run();
+  MemoryStats::Disable();
+  double peak = static_cast<double>(MemoryStats::Total().peak_bytes) / kMiB;
+  MemoryStats::Reset();
+  return peak;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t max_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+
+  std::printf("%-17s %6s %9s %11s %9s %11s %9s %9s\n", "shape", "MiB",
+              "lex MB/s", "tokens/s", "parse MB/s", "nodes/s", "lex peak",
+              "parse peak");
+  for (size_t mib = 1; mib <= max_mib; mib *= 4) {
+    int runs = mib >= 16 ? 1 : 3;
+    for (const ScriptShape &shape : StandardShapes(mib * kMiB)) {
+      GeneratedScript script = GenerateScript(shape);
+      double mb = static_cast<double>(script.source.size()) / 1e6;
+
+      std::vector<Token> tokens;
+      double lex_seconds =
+          BestSeconds(runs, [&] { tokens = Lex(script.source); });
+
+      size_t nodes = 0;
+      double parse_seconds = BestSeconds(runs, [&] {
+        std::unique_ptr<AST::BlockNode> root = Parser(tokens).ParseCode();
+        nodes = CountNodes(root.get());
+      });
+
+      std::vector<Token> measured;
+      double lex_peak = PeakMiB([&] { measured = Lex(script.source); });
+      double parse_peak = PeakMiB([&] { Parser(measured).ParseCode(); });
+
+      std::printf("%-17s %6.1f %9.1f %11.3g %9.1f %11.3g %6.1f MiB %6.1f MiB\n",
+                  shape.name.c_str(), mb / 1.048576, mb / lex_seconds,
+                  tokens.size() / lex_seconds, mb / parse_seconds,
+                  nodes / parse_seconds, lex_peak, parse_peak);
+      std::fflush(stdout);
+    }
+    if (mib < max_mib && mib * 4 > max_mib) {
+      mib = max_mib / 4;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <lib/isolate.h>
+
+// Runs representative ITMOScript workloads and reports the median and p95
+// of their run times. Results can be written as JSON and compared with a
+// saved baseline, in which case the exit code is 1 if any benchmark got
+// slower than the threshold allows.
+//
+//   itmoscript_bench [--warmup N] [--repetitions N] [--scale F]
+//                    [--filter TEXT] [--examples DIR] [--json FILE]
+//                    [--baseline FILE] [--threshold PERCENT]
+//
+// Every workload reads its size from the global `n`, which is its default
+// size times --scale. Parsing is not measured; see the front-end benchmark
+// for that.
+
+#ifndef ITMOSCRIPT_EXAMPLES_DIR
+#define ITMOSCRIPT_EXAMPLES_DIR "examples"
+#endif
+
+namespace {
+
+struct Workload {
+  std::string name;
+  std::string source;
+  int64_t n;
+  // Examples are checked in as they are; one that does not run is reported
+  // and skipped instead of failing the whole run.
+  bool optional = false;
+};
+
+struct Result {
+  std::string name;
+  int64_t n = 0;
+  int repetitions = 0;
+  double median_ms = 0;
+  double p95_ms = 0;
+  double min_ms = 0;
+  double mean_ms = 0;
+};
+
+struct Options {
+  int warmup = 2;
+  int repetitions = 10;
+  double scale = 1;
+  std::string filter;
+  std::string examples_dir = ITMOSCRIPT_EXAMPLES_DIR;
+  std::string json_file;
+  std::string baseline_file;
+  double threshold = 10;
+};
+
+std::vector<Workload> BuiltinWorkloads() {
+  return {
+      {"fib_recursive", R"(
+        fib = function(k)
+            if k < 2 then
+                return k
+            end if
+            return fib((k - 1)) + fib((k - 2))
+        end function
+        i = 0
+        while i < n then
+            result = fib(15)
+            i += 1
+        end while
+      )",
+       20},
+      {"loop_arithmetic", R"(
+        s = 0
+        i = 0
+        while i < n then
+            s += i * 3 % 7 - i / 5
+            i += 1
+        end while
+      )",
+       100000},
+      {"string_building", R"(
+        s = ""
+        i = 0
+        while i < n then
+            s += "item"
+            s += ";"
+            i += 1
+        end while
+        result = len(s)
+      )",
+       20000},
+      {"list_push_pop", R"(
+        items = []
+        i = 0
+        while i < n then
+            items = push(items, i)
+            last = pop(items)
+            i += 1
+        end while
+        result = len(items)
+      )",
+       3000},
+      {"slice_split_join_sort", R"(
+        words = []
+        i = 0
+        while i < n then
+            w = "w" + to_string((i * 7919 % n))
+            words = push(words, w)
+            i += 1
+        end while
+        text = join(words, " ")
+        round = 0
+        while round < 10 then
+            parts = split(text, " ")
+            sorted = sort(parts)
+            half = sorted[0:(len(sorted) / 2)]
+            rest = sorted[(len(sorted) / 2):]
+            text = join(half, " ") + " " + join(rest, " ")
+            round += 1
+        end while
+        result = len(text)
+      )",
+       2000},
+      {"function_calls", R"(
+        add = function(a, b)
+            return a + b
+        end function
+        twice = function(x)
+            return add(x, x)
+        end function
+        s = 0
+        i = 0
+        while i < n then
+            s = add(s, twice(i))
+            i += 1
+        end while
+      )",
+       20000},
+  };
+}
+
+std::vector<Workload> ExampleWorkloads(const std::string &dir) {
+  std::vector<Workload> workloads;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+    if (entry.path().extension() != ".is") {
+      continue;
+    }
+    std::ifstream file(entry.path(), std::ios::binary);
+    std::string source(std::istreambuf_iterator<char>(file), {});
+    workloads.push_back({"example/" + entry.path().stem().string(),
+                         std::move(source), 1, true});
+  }
+  std::sort(workloads.begin(), workloads.end(),
+            [](const Workload &a, const Workload &b) {
+              return a.name < b.name;
+            });
+  return workloads;
+}
+
+// Value at rank `fraction` of sorted `samples` (nearest rank).
+double Percentile(const std::vector<double> &samples, double fraction) {
+  size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+  return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+double Median(const std::vector<double> &samples) {
+  size_t middle = samples.size() / 2;
+  if (samples.size() % 2 == 0) {
+    return (samples[middle - 1] + samples[middle]) / 2;
+  }
+  return samples[middle];
+}
+
+// Runs `program` once in a fresh isolate; false with the error in `error`
+// if the script fails.
+bool RunOnce(const Program &program, int64_t n, double &ms,
+             std::string &error) {
+  StringSink output;
+  Isolate isolate(output);
+  isolate.Set("n", Value(n));
+
+  auto start = std::chrono::steady_clock::now();
+  bool ok = isolate.Run(program);
+  ms = std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now() - start)
+           .count();
+  if (!ok) {
+    error = isolate.Error();
+  }
+  return ok;
+}
+
+bool Measure(const Workload &workload, const Options &options,
+             Result &result, std::string &error) {
+  std::shared_ptr<const Program> program;
+  try {
+    program = Program::Compile(workload.source);
+  } catch (const std::exception &e) {
+    error = e.what();
+    return false;
+  }
+
+  int64_t n = std::max<int64_t>(
+      1, std::llround(static_cast<double>(workload.n) * options.scale));
+  double ms;
+  for (int i = 0; i < options.warmup; ++i) {
+    if (!RunOnce(*program, n, ms, error)) {
+      return false;
+    }
+  }
+
+  std::vector<double> samples;
+  for (int i = 0; i < options.repetitions; ++i) {
+    if (!RunOnce(*program, n, ms, error)) {
+      return false;
+    }
+    samples.push_back(ms);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  result.name = workload.name;
+  result.n = n;
+  result.repetitions = options.repetitions;
+  result.median_ms = Median(samples);
+  result.p95_ms = Percentile(samples, 0.95);
+  result.min_ms = samples.front();
+  double sum = 0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  result.mean_ms = sum / samples.size();
+  return true;
+}
+
+void WriteJson(std::ostream &out, const std::vector<Result> &results) {
+  out << "{\n  \"benchmarks\": [";
+  char line[512];
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    std::snprintf(line, sizeof(line),
+                  "%s\n    {\"name\": \"%s\", \"n\": %lld, "
+                  "\"repetitions\": %d, \"median_ms\": %.6f, "
+                  "\"p95_ms\": %.6f, \"min_ms\": %.6f, \"mean_ms\": %.6f}",
+                  i == 0 ? "" : ",", r.name.c_str(),
+                  static_cast<long long>(r.n), r.repetitions, r.median_ms,
+                  r.p95_ms, r.min_ms, r.mean_ms);
+    out << line;
+  }
+  out << "\n  ]\n}\n";
+}
+
+// Text of the JSON value after `"key":` in `object`, up to the next ',' or
+// '}'; empty if the key is missing.
+std::string Field(const std::string &object, const std::string &key) {
+  size_t pos = object.find("\"" + key + "\"");
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos = object.find(':', pos);
+  if (pos == std::string::npos) {
+    return "";
+  }
+  size_t end = object.find_first_of(",}", pos);
+  std::string value = object.substr(pos + 1, end - pos - 1);
+  value.erase(0, value.find_first_not_of(" \t\n\""));
+  value.erase(value.find_last_not_of(" \t\n\"") + 1);
+  return value;
+}
+
+// Reads the results of an earlier --json run. Only the format written by
+// WriteJson is understood.
+bool ReadBaseline(const std::string &path, std::map<std::string, Result> &out) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string text(std::istreambuf_iterator<char>(file), {});
+  size_t pos = text.find('[');
+  while (pos != std::string::npos) {
+    size_t begin = text.find('{', pos);
+    if (begin == std::string::npos) {
+      break;
+    }
+    size_t end = text.find('}', begin);
+    if (end == std::string::npos) {
+      return false;
+    }
+    std::string object = text.substr(begin, end - begin + 1);
+    Result result;
+    result.name = Field(object, "name");
+    result.n = std::strtoll(Field(object, "n").c_str(), nullptr, 10);
+    result.median_ms = std::strtod(Field(object, "median_ms").c_str(), nullptr);
+    result.p95_ms = std::strtod(Field(object, "p95_ms").c_str(), nullptr);
+    if (result.name.empty()) {
+      return false;
+    }
+    out[result.name] = result;
+    pos = end;
+  }
+  return true;
+}
+
+// Prints the change of every benchmark against `baseline` and returns the
+// number of regressions beyond the threshold.
+int Compare(const std::vector<Result> &results,
+            const std::map<std::string, Result> &baseline,
+            double threshold) {
+  int regressions = 0;
+  std::printf("\n%-28s %12s %12s %9s\n", "benchmark", "baseline ms",
+              "median ms", "change");
+  for (const Result &r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end()) {
+      std::printf("%-28s %12s %12.3f %9s\n", r.name.c_str(), "-",
+                  r.median_ms, "new");
+      continue;
+    }
+    if (it->second.n != r.n) {
+      std::printf("%-28s %12s %12.3f %9s\n", r.name.c_str(), "-",
+                  r.median_ms, "other n");
+      continue;
+    }
+    double change = 100 * (r.median_ms / it->second.median_ms - 1);
+    bool regressed = change > threshold;
+    regressions += regressed;
+    std::printf("%-28s %12.3f %12.3f %+8.1f%%%s\n", r.name.c_str(),
+                it->second.median_ms, r.median_ms, change,
+                regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+void PrintUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--warmup N] [--repetitions N] [--scale F] [--filter TEXT]"
+               " [--examples DIR] [--json FILE] [--baseline FILE]"
+               " [--threshold PERCENT]\n";
+}
+
+bool ParseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--warmup") {
+      options.warmup = std::atoi(value);
+    } else if (arg == "--repetitions") {
+      options.repetitions = std::atoi(value);
+    } else if (arg == "--scale") {
+      options.scale = std::strtod(value, nullptr);
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--examples") {
+      options.examples_dir = value;
+    } else if (arg == "--json") {
+      options.json_file = value;
+    } else if (arg == "--baseline") {
+      options.baseline_file = value;
+    } else if (arg == "--threshold") {
+      options.threshold = std::strtod(value, nullptr);
+    } else {
+      return false;
+    }
+  }
+  return options.warmup >= 0 && options.repetitions > 0 &&
+         options.scale > 0 && options.threshold >= 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, Result> baseline;
+  if (!options.baseline_file.empty() &&
+      !ReadBaseline(options.baseline_file, baseline)) {
+    std::cerr << "Can not read baseline " << options.baseline_file << "\n";
+    return 2;
+  }
+
+  std::vector<Workload> workloads = BuiltinWorkloads();
+  for (Workload &example : ExampleWorkloads(options.examples_dir)) {
+    workloads.push_back(std::move(example));
+  }
+
+  std::vector<Result> results;
+  bool failed = false;
+  std::printf("%-28s %10s %12s %12s %12s\n", "benchmark", "n", "median ms",
+              "p95 ms", "min ms");
+  for (const Workload &workload : workloads) {
+    if (workload.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    Result result;
+    std::string error;
+    if (!Measure(workload, options, result, error)) {
+      std::fprintf(stderr, "%s: %s %s\n", workload.name.c_str(),
+                   workload.optional ? "skipped," : "failed:", error.c_str());
+      failed |= !workload.optional;
+      continue;
+    }
+    std::printf("%-28s %10lld %12.3f %12.3f %12.3f\n", result.name.c_str(),
+                static_cast<long long>(result.n), result.median_ms,
+                result.p95_ms, result.min_ms);
+    std::fflush(stdout);
+    results.push_back(result);
+  }
+
+  if (!options.json_file.empty()) {
+    std::ofstream json(options.json_file);
+    if (!json) {
+      std::cerr << "Can not open " << options.json_file << "\n";
+      return 2;
+    }
+    WriteJson(json, results);
+  }
+
+  int regressions = 0;
+  if (!options.baseline_file.empty()) {
+    regressions = Compare(results, baseline, options.threshold);
+    if (regressions != 0) {
+      std::printf("%d benchmark(s) slower than the baseline by more than "
+                  "%.1f%%\n",
+                  regressions, options.threshold);
+    }
+  }
+  return failed || regressions != 0 ? 1 : 0;
+}
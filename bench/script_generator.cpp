@@ -0,0 +1,188 @@
+#include "script_generator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+
+namespace {
+
+class Generator {
+public:
+  explicit Generator(const ScriptShape &shape)
+      : shape_(shape), rng_(shape.seed) {}
+
+  GeneratedScript Generate() {
+    script_.source.reserve(shape_.target_bytes + 4096);
+    while (script_.source.size() < shape_.target_bytes) {
+      MaybeComment(0);
+      if (Percent() < shape_.function_percent) {
+        Function();
+      } else if (shape_.nesting_depth > 0 && Percent() < 30) {
+        Block(0, shape_.nesting_depth);
+      } else {
+        Simple(0);
+      }
+      ++script_.top_level_statements;
+    }
+    return std::move(script_);
+  }
+
+private:
+  static constexpr const char *kOperators[] = {"+", "-", "*", "/", "%"};
+  static constexpr const char *kComparisons[] = {"<", ">", "<=", ">=", "==",
+                                                 "!="};
+
+  const ScriptShape &shape_;
+  std::mt19937 rng_;
+  GeneratedScript script_;
+
+  int Percent() { return static_cast<int>(rng_() % 100); }
+
+  size_t Below(size_t bound) { return bound == 0 ? 0 : rng_() % bound; }
+
+  void Line(size_t indent, const std::string &text) {
+    script_.source.append(indent * 4, ' ');
+    script_.source += text;
+    script_.source += '\n';
+    ++script_.lines;
+  }
+
+  void MaybeComment(size_t indent) {
+    while (Percent() < shape_.comment_percent) {
+      Line(indent, "// " + Text(20 + Below(60)));
+    }
+  }
+
+  std::string Text(size_t length) {
+    static constexpr char kLetters[] = "abcdefghijklmnopqrstuvwxyz ";
+    std::string text;
+    text.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+      text += kLetters[Below(sizeof(kLetters) - 1)];
+    }
+    return text;
+  }
+
+  std::string Variable() { return "v" + std::to_string(Below(64)); }
+
+  std::string Operand() {
+    switch (Below(4)) {
+    case 0:
+      return std::to_string(Below(1000));
+    case 1:
+      return std::to_string(Below(100)) + "." + std::to_string(Below(100));
+    default:
+      return Variable();
+    }
+  }
+
+  // `length` operands joined by arithmetic operators, with some of them
+  // grouped in parentheses.
+  std::string Expression(size_t length) {
+    std::string expr = Operand();
+    size_t open = 0;
+    for (size_t i = 1; i < length; ++i) {
+      expr += ' ';
+      expr += kOperators[Below(std::size(kOperators))];
+      expr += ' ';
+      if (i + 2 < length && Percent() < 15) {
+        expr += '(';
+        ++open;
+      }
+      expr += Operand();
+      if (open > 0 && Percent() < 30) {
+        expr += ')';
+        --open;
+      }
+    }
+    expr.append(open, ')');
+    return expr;
+  }
+
+  std::string Condition() {
+    return Variable() + " " + kComparisons[Below(std::size(kComparisons))] +
+           " " + Operand();
+  }
+
+  void Simple(size_t indent) {
+    int kind = Percent();
+    if (kind < 15) {
+      Line(indent, Variable() + " = \"" + Text(shape_.string_length) + "\"");
+    } else if (kind < 25) {
+      Line(indent, "print(" + Variable() + ")");
+    } else if (kind < 35) {
+      Line(indent, Variable() + " += " + Operand());
+    } else {
+      size_t length = 1 + Below(shape_.expression_length);
+      Line(indent, Variable() + " = " + Expression(length));
+    }
+  }
+
+  // An if or while whose body nests `depth` more levels.
+  void Block(size_t indent, size_t depth) {
+    bool is_if = Percent() < 60;
+    Line(indent,
+         std::string(is_if ? "if " : "while ") + Condition() + " then");
+    size_t statements = 1 + Below(3);
+    for (size_t i = 0; i < statements; ++i) {
+      MaybeComment(indent + 1);
+      if (depth > 1 && i == 0) {
+        Block(indent + 1, depth - 1);
+      } else {
+        Simple(indent + 1);
+      }
+    }
+    if (is_if && Percent() < 30) {
+      Line(indent, "else");
+      Simple(indent + 1);
+    }
+    Line(indent, is_if ? "end if" : "end while");
+  }
+
+  void Function() {
+    std::string name = "f" + std::to_string(script_.functions++);
+    Line(0, name + " = function(a, b)");
+    size_t statements = 2 + Below(6);
+    for (size_t i = 0; i < statements; ++i) {
+      MaybeComment(1);
+      if (shape_.nesting_depth > 0 && Percent() < 20) {
+        Block(1, std::min<size_t>(shape_.nesting_depth, 2));
+      } else {
+        Simple(1);
+      }
+    }
+    Line(1, "return a + b * " + Operand());
+    Line(0, "end function");
+  }
+};
+
+} // namespace
+
+GeneratedScript GenerateScript(const ScriptShape &shape) {
+  return Generator(shape).Generate();
+}
+
+std::vector<ScriptShape> StandardShapes(size_t target_bytes) {
+  std::vector<ScriptShape> shapes(6);
+  shapes[0].name = "mixed";
+
+  shapes[1].name = "deep_nesting";
+  shapes[1].nesting_depth = 64;
+
+  shapes[2].name = "long_expressions";
+  shapes[2].expression_length = 200;
+
+  shapes[3].name = "many_functions";
+  shapes[3].function_percent = 90;
+
+  shapes[4].name = "long_strings";
+  shapes[4].string_length = 4096;
+
+  shapes[5].name = "comments";
+  shapes[5].comment_percent = 80;
+
+  for (ScriptShape &shape : shapes) {
+    shape.target_bytes = target_bytes;
+  }
+  return shapes;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shape of a generated ITMOScript source. The mix of constructs is what the
+// front end is sensitive to; the generated code is valid syntax but is not
+// meant to be run (loop conditions never change, for example).
+struct ScriptShape {
+  std::string name = "mixed";
+  // Generation stops at the first top-level statement boundary after this
+  // many bytes.
+  size_t target_bytes = 1 << 20;
+  // Depth of nested if and while blocks.
+  size_t nesting_depth = 3;
+  // Operands per expression.
+  size_t expression_length = 6;
+  // Share of top-level statements that define a function, in percent.
+  int function_percent = 10;
+  // Length of string literals.
+  size_t string_length = 16;
+  // Share of lines that are comments, in percent.
+  int comment_percent = 10;
+  uint32_t seed = 239;
+};
+
+struct GeneratedScript {
+  std::string source;
+  // Statements of the outermost block, i.e. ParseCode()->nodes.size().
+  size_t top_level_statements = 0;
+  size_t functions = 0;
+  size_t lines = 0;
+};
+
+GeneratedScript GenerateScript(const ScriptShape &shape);
+
+// Presets: mixed, deep_nesting, long_expressions, many_functions,
+// long_strings and comments, all of `target_bytes`.
+std::vector<ScriptShape> StandardShapes(size_t target_bytes);
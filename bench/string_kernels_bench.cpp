@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <lib/string_kernels.h>
+
+// Throughput of the string kernels at every SIMD level this CPU supports,
+// on inputs from 1 MiB up to the size given on the command line (in MiB,
+// 1024 by default).
+
+namespace {
+
+constexpr size_t kMiB = 1 << 20;
+
+const char *LevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::SCALAR:
+    return "scalar";
+  case SimdLevel::SSE2:
+    return "sse2";
+  case SimdLevel::AVX2:
+    return "avx2";
+  }
+  return "?";
+}
+
+// Mostly ASCII prose with some Cyrillic words and a line break roughly
+// every 80 bytes.
+std::string MakeText(size_t size) {
+  static const char *words[] = {"the",   "quick", "brown", "fox",
+                                "jumps", "over",  "lazy",  "dog",
+                                "Lorem", "ipsum", "ПРИВЕТ", "мир"};
+  std::mt19937 rng(239);
+  std::uniform_int_distribution<size_t> pick(0, std::size(words) - 1);
+
+  std::string text;
+  text.reserve(size + 16);
+  size_t line = 0;
+  while (text.size() < size) {
+    std::string_view word = words[pick(rng)];
+    text += word;
+    line += word.size() + 1;
+    if (line >= 80) {
+      text += '\n';
+      line = 0;
+    } else {
+      text += ' ';
+    }
+  }
+  // Cut at a character boundary.
+  while (text.size() > size ||
+         (static_cast<unsigned char>(text.back()) & 0xC0) == 0xC0) {
+    text.pop_back();
+  }
+  return text;
+}
+
+double BestSeconds(int runs, const std::function<size_t()> &kernel) {
+  double best = 1e300;
+  size_t sink = 0;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    sink += kernel();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  if (sink == 1) {
+    std::puts("");
+  }
+  return best;
+}
+
+size_t CountParts(std::string_view s, std::string_view delim) {
+  size_t parts = 1;
+  for (size_t pos = FindSubstring(s, delim); pos != std::string_view::npos;
+       pos = FindSubstring(s, delim, pos + delim.size())) {
+    ++parts;
+  }
+  return parts;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t max_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+
+  std::vector<SimdLevel> levels = {SimdLevel::SCALAR};
+  if (DetectSimdLevel() >= SimdLevel::SSE2) {
+    levels.push_back(SimdLevel::SSE2);
+  }
+  if (DetectSimdLevel() >= SimdLevel::AVX2) {
+    levels.push_back(SimdLevel::AVX2);
+  }
+
+  std::printf("%-14s %10s %8s %10s\n", "kernel", "size", "level", "GB/s");
+  for (size_t mib = 1; mib <= max_mib; mib *= 16) {
+    std::string text = MakeText(mib * kMiB);
+    int runs = mib >= 256 ? 1 : 5;
+
+    std::vector<std::pair<const char *, std::function<size_t()>>> kernels = {
+        {"validate", [&] { return size_t(IsValidUtf8(text)); }},
+        {"lower", [&] { return ToLowerUtf8(text).size(); }},
+        {"upper", [&] { return ToUpperUtf8(text).size(); }},
+        {"find_byte", [&] { return FindSubstring(text, "#"); }},
+        {"find_word", [&] { return FindSubstring(text, "jumps over it"); }},
+        {"replace", [&] { return ReplaceAll(text, "fox", "wolf").size(); }},
+        {"split_line", [&] { return CountParts(text, "\n"); }},
+        {"split_word", [&] { return CountParts(text, "lazy dog"); }},
+    };
+
+    for (auto &[name, kernel] : kernels) {
+      for (SimdLevel level : levels) {
+        SetSimdLevel(level);
+        double seconds = BestSeconds(runs, kernel);
+        std::printf("%-14s %7zu MiB %8s %10.2f\n", name, mib,
+                    LevelName(level), text.size() / seconds / 1e9);
+      }
+    }
+
+    if (mib < max_mib && mib * 16 > max_mib) {
+      mib = max_mib / 16;
+    }
+  }
+  SetSimdLevel(DetectSimdLevel());
+  return 0;
+}
@@ -1,26 +1,261 @@
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
 #include <sstream>
-#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include <lib/interpreter.h>
+
+namespace {
+
+std::string DefaultCacheDir() {
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return (std::filesystem::path(xdg) / "itmoscript").string();
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return (std::filesystem::path(home) / ".cache" / "itmoscript").string();
+  }
+  std::error_code ec;
+  auto tmp = std::filesystem::temp_directory_path(ec);
+  if (ec) {
+    return "";
+  }
+  return (tmp / "itmoscript").string();
+}
+
+FlushPolicy DefaultFlushPolicy() {
+#if defined(__unix__) || defined(__APPLE__)
+  if (::isatty(1)) {
+    return FlushPolicy::NEWLINE;
+  }
+#endif
+  return FlushPolicy::SIZE;
+}
+
+bool ParseFlushPolicy(const std::string &name, FlushPolicy &policy) {
+  if (name == "none") {
+    policy = FlushPolicy::NONE;
+  } else if (name == "line") {
+    policy = FlushPolicy::NEWLINE;
+  } else if (name == "size") {
+    policy = FlushPolicy::SIZE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A whole decimal number without a sign, for the numeric options.
+bool ParseCount(std::string_view text, uint64_t &value) {
+  auto [end, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc() && end == text.data() + text.size();
+}
+
+// Comma-separated names for --trace-filter.
+std::vector<std::string> SplitNames(const std::string &names) {
+  std::vector<std::string> parts;
+  std::istringstream stream(names);
+  std::string part;
+  while (std::getline(stream, part, ',')) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+// Number of functions in the table printed by --profile.
+constexpr size_t kProfileTop = 20;
+// Number of lines marked as hot by --line-profile.
+constexpr size_t kLineProfileHot = 10;
+// Number of allocation sites in the table printed by --mem-stats.
+constexpr size_t kMemStatsTop = 20;
+// Exit code of a script stopped by --max-steps or --timeout, as opposed to
+// 1 for one that failed.
+constexpr int kStoppedExitCode = 2;
 
-#include <lib/interpreter.cpp>
+void PrintUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--cache-dir DIR] [--no-cache] [--flush none|line|size]"
+               " [--profile FILE] [--profile-interval US] [--line-profile]"
+               " [--mem-stats] [--trace FILE] [--trace-sample N]"
+               " [--trace-min-us US] [--trace-filter NAME,...]"
+               " [--max-steps N] [--timeout MS] file.is\n";
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
-    std::string code;
-    std::string file_name = argv[1];
+  std::string file_name;
+  InterpretOptions options;
+  options.cache_dir = DefaultCacheDir();
+  FlushPolicy flush_policy = DefaultFlushPolicy();
+  std::string profile_file;
+  uint64_t profile_interval = 1000;
+  bool line_profile = false;
+  bool mem_stats = false;
+  std::string trace_file;
+  TraceOptions trace_options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--cache-dir" && i + 1 < argc) {
+      options.cache_dir = argv[++i];
+    } else if (arg == "--flush" && i + 1 < argc) {
+      if (!ParseFlushPolicy(argv[++i], flush_policy)) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profile_file = argv[++i];
+    } else if (arg == "--profile-interval" && i + 1 < argc) {
+      if (!ParseCount(argv[++i], profile_interval) || profile_interval == 0 ||
+          profile_interval > static_cast<uint64_t>(
+                                 std::chrono::microseconds::max().count())) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--line-profile") {
+      line_profile = true;
+    } else if (arg == "--mem-stats") {
+      mem_stats = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_file = argv[++i];
+    } else if (arg == "--trace-sample" && i + 1 < argc) {
+      uint64_t every = 0;
+      if (!ParseCount(argv[++i], every) || every == 0 ||
+          every > std::numeric_limits<uint32_t>::max()) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      trace_options.sample_every = static_cast<uint32_t>(every);
+    } else if (arg == "--trace-min-us" && i + 1 < argc) {
+      uint64_t min_us = 0;
+      if (!ParseCount(argv[++i], min_us) ||
+          min_us > static_cast<uint64_t>(
+                       std::chrono::microseconds::max().count())) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      trace_options.min_duration = std::chrono::microseconds(min_us);
+    } else if (arg == "--trace-filter" && i + 1 < argc) {
+      trace_options.filter = SplitNames(argv[++i]);
+    } else if (arg == "--max-steps" && i + 1 < argc) {
+      if (!ParseCount(argv[++i], options.limits.max_steps)) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--timeout" && i + 1 < argc) {
+      uint64_t timeout = 0;
+      if (!ParseCount(argv[++i], timeout) || timeout == 0 ||
+          timeout > static_cast<uint64_t>(
+                        std::chrono::milliseconds::max().count())) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      options.limits.timeout = std::chrono::milliseconds(timeout);
+    } else if (arg == "--no-cache") {
+      options.cache_dir.clear();
+    } else if (file_name.empty() && !arg.starts_with("--")) {
+      file_name = arg;
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (file_name.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::ifstream fin(file_name, std::ios::binary);
+  if (!fin) {
+    std::cerr << "Can not open " << file_name << "\n";
+    return 1;
+  }
+
+  FdSink output(1, flush_policy);
 
-    std::ifstream fin(file_name);
+  std::optional<Profiler> profiler;
+  if (!profile_file.empty()) {
+    profiler.emplace(std::chrono::microseconds(profile_interval));
+    options.profiler = &*profiler;
+    profiler->Start();
+  }
 
-    char c;
-    while(fin.get(c)){
-        code.push_back(c);
+  std::optional<LineProfiler> line_profiler;
+  if (line_profile) {
+    line_profiler.emplace();
+    options.line_profiler = &*line_profiler;
+  }
+
+  if (mem_stats) {
+    MemoryStats::Enable();
+  }
+
+  std::ofstream trace_out;
+  std::optional<Tracer> tracer;
+  if (!trace_file.empty()) {
+    trace_out.open(trace_file, std::ios::binary | std::ios::trunc);
+    if (!trace_out) {
+      std::cerr << "Can not open " << trace_file << "\n";
+      return 1;
+    }
+    tracer.emplace(trace_out, trace_options);
+    options.tracer = &*tracer;
+    tracer->Start();
+  }
+
+  // The source is kept for the annotated listing.
+  std::string source(std::istreambuf_iterator<char>(fin), {});
+  std::istringstream code(source);
+  StopReason stop_reason = StopReason::NONE;
+  options.stop_reason = &stop_reason;
+  bool ok = interpret(code, output, options);
+
+  if (tracer) {
+    tracer->Stop();
+    if (tracer->Dropped() != 0) {
+      std::cerr << "Trace: " << tracer->Dropped()
+                << " events dropped, the buffer was full\n";
     }
+  }
 
-    std::istringstream input(code);
-    std::ostringstream output;
+  if (profiler) {
+    profiler->Stop();
+    std::ofstream folded(profile_file);
+    if (!folded) {
+      std::cerr << "Can not open " << profile_file << "\n";
+      return 1;
+    }
+    profiler->WriteFolded(folded);
+    profiler->WriteTop(std::cerr, kProfileTop);
+  }
 
-    interpret(input, output);
+  if (line_profiler) {
+    line_profiler->WriteListing(std::cerr, source, kLineProfileHot);
+  }
 
-    std::cout << output.str();
+  if (mem_stats) {
+    MemoryStats::Disable();
+    MemoryStats::WriteReport(std::cerr, kMemStatsTop);
+  }
 
-    return 0;
-}
\ No newline at end of file
+  if (stop_reason != StopReason::NONE) {
+    return kStoppedExitCode;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+// Growable character buffer shared by the strings built on top of it. Bytes
+// below `used` are never written again, so every AppendString sees a stable
+// prefix even while later concatenations keep filling the free space.
+struct AppendBuffer {
+  explicit AppendBuffer(size_t capacity)
+      : data(std::make_unique_for_overwrite<char[]>(capacity)),
+        capacity(capacity) {}
+
+  std::unique_ptr<char[]> data;
+  size_t capacity;
+  std::atomic<size_t> used = 0;
+};
+
+// Result of concatenating large strings: the first `size` bytes of a shared
+// AppendBuffer. When the left operand of `+` is the newest string of its
+// buffer, the right operand is appended in place instead of copying both,
+// so `s = s + piece` in a loop runs in linear time. The text is always
+// contiguous, so indexing, comparison and printing read it directly.
+struct AppendString {
+  std::shared_ptr<AppendBuffer> buffer;
+  size_t size;
+
+  std::string_view View() const { return {buffer->data.get(), size}; }
+};
@@ -0,0 +1,385 @@
+#include "array_kernels.h"
+
+#include <cmath>
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Operands of an elementwise kernel: an array, or one number used for every
+// element.
+struct ArrayOperand {
+  const double *p;
+
+  double At(size_t i) const { return p[i]; }
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  __attribute__((target("sse2"))) __m128d Sse2(size_t i) const {
+    return _mm_loadu_pd(p + i);
+  }
+  __attribute__((target("avx2"))) __m256d Avx2(size_t i) const {
+    return _mm256_loadu_pd(p + i);
+  }
+#endif
+};
+
+struct ScalarOperand {
+  double v;
+
+  double At(size_t) const { return v; }
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  __attribute__((target("sse2"))) __m128d Sse2(size_t) const {
+    return _mm_set1_pd(v);
+  }
+  __attribute__((target("avx2"))) __m256d Avx2(size_t) const {
+    return _mm256_set1_pd(v);
+  }
+#endif
+};
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+#define VECTOR_OP(name, scalar_op, sse2_op, avx2_op)                           \
+  struct name {                                                                \
+    static constexpr bool kVector = true;                                      \
+    static double Scalar(double a, double b) { return a scalar_op b; }         \
+    __attribute__((target("sse2"))) static __m128d Sse2(__m128d a,             \
+                                                        __m128d b) {           \
+      return sse2_op(a, b);                                                    \
+    }                                                                          \
+    __attribute__((target("avx2"))) static __m256d Avx2(__m256d a,             \
+                                                        __m256d b) {           \
+      return avx2_op(a, b);                                                    \
+    }                                                                          \
+  };
+#else
+#define VECTOR_OP(name, scalar_op, sse2_op, avx2_op)                           \
+  struct name {                                                                \
+    static constexpr bool kVector = true;                                      \
+    static double Scalar(double a, double b) { return a scalar_op b; }         \
+  };
+#endif
+
+VECTOR_OP(Add, +, _mm_add_pd, _mm256_add_pd)
+VECTOR_OP(Sub, -, _mm_sub_pd, _mm256_sub_pd)
+VECTOR_OP(Mul, *, _mm_mul_pd, _mm256_mul_pd)
+VECTOR_OP(Div, /, _mm_div_pd, _mm256_div_pd)
+
+#undef VECTOR_OP
+
+// There is no vector pow instruction, so it always runs one element at a
+// time.
+struct Pow {
+  static constexpr bool kVector = false;
+  static double Scalar(double a, double b) { return std::pow(a, b); }
+};
+
+template <class Op, class L, class R>
+void ApplyScalar(L l, R r, double *out, size_t size, size_t i = 0) {
+  for (; i < size; ++i) {
+    out[i] = Op::Scalar(l.At(i), r.At(i));
+  }
+}
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+
+template <class Op, class L, class R>
+__attribute__((target("sse2"))) void ApplySse2(L l, R r, double *out,
+                                               size_t size) {
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    _mm_storeu_pd(out + i, Op::Sse2(l.Sse2(i), r.Sse2(i)));
+  }
+  ApplyScalar<Op>(l, r, out, size, i);
+}
+
+template <class Op, class L, class R>
+__attribute__((target("avx2"))) void ApplyAvx2(L l, R r, double *out,
+                                               size_t size) {
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    _mm256_storeu_pd(out + i, Op::Avx2(l.Avx2(i), r.Avx2(i)));
+  }
+  ApplyScalar<Op>(l, r, out, size, i);
+}
+
+#endif
+
+template <class Op, class L, class R>
+void Apply(L l, R r, double *out, size_t size) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  if constexpr (Op::kVector) {
+    switch (GetSimdLevel()) {
+    case SimdLevel::AVX2:
+      return ApplyAvx2<Op>(l, r, out, size);
+    case SimdLevel::SSE2:
+      return ApplySse2<Op>(l, r, out, size);
+    default:
+      break;
+    }
+  }
+#endif
+  ApplyScalar<Op>(l, r, out, size);
+}
+
+template <class L, class R>
+void Dispatch(ArrayOp op, L l, R r, double *out, size_t size) {
+  switch (op) {
+  case ArrayOp::ADD:
+    return Apply<Add>(l, r, out, size);
+  case ArrayOp::SUB:
+    return Apply<Sub>(l, r, out, size);
+  case ArrayOp::MUL:
+    return Apply<Mul>(l, r, out, size);
+  case ArrayOp::DIV:
+    return Apply<Div>(l, r, out, size);
+  case ArrayOp::POW:
+    return Apply<Pow>(l, r, out, size);
+  }
+}
+
+enum struct Extremum { MIN, MAX };
+
+double Pick(double m, double x, Extremum which) {
+  return (which == Extremum::MIN ? x < m : x > m) ? x : m;
+}
+
+double PickScalar(std::span<const double> v, Extremum which, double m,
+                  size_t i) {
+  for (; i < v.size(); ++i) {
+    m = Pick(m, v[i], which);
+  }
+  return m;
+}
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+
+// Two accumulators per loop hide the latency of the additions.
+
+__attribute__((target("sse2"))) double SumSse2(std::span<const double> v) {
+  __m128d a = _mm_setzero_pd(), b = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= v.size(); i += 4) {
+    a = _mm_add_pd(a, _mm_loadu_pd(v.data() + i));
+    b = _mm_add_pd(b, _mm_loadu_pd(v.data() + i + 2));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+  double sum = lanes[0] + lanes[1];
+  for (; i < v.size(); ++i) {
+    sum += v[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2"))) double SumAvx2(std::span<const double> v) {
+  __m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= v.size(); i += 8) {
+    a = _mm256_add_pd(a, _mm256_loadu_pd(v.data() + i));
+    b = _mm256_add_pd(b, _mm256_loadu_pd(v.data() + i + 4));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(a, b));
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < v.size(); ++i) {
+    sum += v[i];
+  }
+  return sum;
+}
+
+__attribute__((target("sse2"))) double DotSse2(const double *l,
+                                               const double *r, size_t size) {
+  __m128d a = _mm_setzero_pd(), b = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    a = _mm_add_pd(a, _mm_mul_pd(_mm_loadu_pd(l + i), _mm_loadu_pd(r + i)));
+    b = _mm_add_pd(
+        b, _mm_mul_pd(_mm_loadu_pd(l + i + 2), _mm_loadu_pd(r + i + 2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+  double sum = lanes[0] + lanes[1];
+  for (; i < size; ++i) {
+    sum += l[i] * r[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2"))) double DotAvx2(const double *l,
+                                               const double *r, size_t size) {
+  __m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    a = _mm256_add_pd(
+        a, _mm256_mul_pd(_mm256_loadu_pd(l + i), _mm256_loadu_pd(r + i)));
+    b = _mm256_add_pd(b, _mm256_mul_pd(_mm256_loadu_pd(l + i + 4),
+                                       _mm256_loadu_pd(r + i + 4)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(a, b));
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < size; ++i) {
+    sum += l[i] * r[i];
+  }
+  return sum;
+}
+
+// min_pd and max_pd return their second operand when either one is NaN, so
+// with the accumulator second they skip NaNs just like Pick.
+
+__attribute__((target("sse2"))) double PickSse2(std::span<const double> v,
+                                                Extremum which) {
+  __m128d m = _mm_set1_pd(v[0]);
+  size_t i = 0;
+  for (; i + 2 <= v.size(); i += 2) {
+    __m128d x = _mm_loadu_pd(v.data() + i);
+    m = which == Extremum::MIN ? _mm_min_pd(x, m) : _mm_max_pd(x, m);
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, m);
+  return PickScalar(v, which, Pick(lanes[0], lanes[1], which), i);
+}
+
+__attribute__((target("avx2"))) double PickAvx2(std::span<const double> v,
+                                                Extremum which) {
+  __m256d m = _mm256_set1_pd(v[0]);
+  size_t i = 0;
+  for (; i + 4 <= v.size(); i += 4) {
+    __m256d x = _mm256_loadu_pd(v.data() + i);
+    m = which == Extremum::MIN ? _mm256_min_pd(x, m) : _mm256_max_pd(x, m);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, m);
+  double result = lanes[0];
+  for (double lane : {lanes[1], lanes[2], lanes[3]}) {
+    result = Pick(result, lane, which);
+  }
+  return PickScalar(v, which, result, i);
+}
+
+__attribute__((target("sse2"))) bool
+ContainsZeroSse2(std::span<const double> v) {
+  __m128d found = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 2 <= v.size(); i += 2) {
+    found = _mm_or_pd(found,
+                      _mm_cmpeq_pd(_mm_loadu_pd(v.data() + i), _mm_setzero_pd()));
+  }
+  bool zero = _mm_movemask_pd(found) != 0;
+  for (; i < v.size(); ++i) {
+    zero |= v[i] == 0;
+  }
+  return zero;
+}
+
+__attribute__((target("avx2"))) bool
+ContainsZeroAvx2(std::span<const double> v) {
+  __m256d found = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= v.size(); i += 4) {
+    found = _mm256_or_pd(found, _mm256_cmp_pd(_mm256_loadu_pd(v.data() + i),
+                                              _mm256_setzero_pd(), _CMP_EQ_OQ));
+  }
+  bool zero = _mm256_movemask_pd(found) != 0;
+  for (; i < v.size(); ++i) {
+    zero |= v[i] == 0;
+  }
+  return zero;
+}
+
+#endif
+
+double PickExtremum(std::span<const double> v, Extremum which) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return PickAvx2(v, which);
+  case SimdLevel::SSE2:
+    return PickSse2(v, which);
+  default:
+    break;
+  }
+#endif
+  return PickScalar(v, which, v[0], 1);
+}
+
+} // namespace
+
+void ApplyArrayOp(ArrayOp op, const double *l, const double *r, double *out,
+                  size_t size) {
+  Dispatch(op, ArrayOperand{l}, ArrayOperand{r}, out, size);
+}
+
+void ApplyArrayOp(ArrayOp op, const double *l, double r, double *out,
+                  size_t size) {
+  Dispatch(op, ArrayOperand{l}, ScalarOperand{r}, out, size);
+}
+
+void ApplyArrayOp(ArrayOp op, double l, const double *r, double *out,
+                  size_t size) {
+  Dispatch(op, ScalarOperand{l}, ArrayOperand{r}, out, size);
+}
+
+bool ContainsZero(std::span<const double> values) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return ContainsZeroAvx2(values);
+  case SimdLevel::SSE2:
+    return ContainsZeroSse2(values);
+  default:
+    break;
+  }
+#endif
+  for (double v : values) {
+    if (v == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double ArraySum(std::span<const double> values) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return SumAvx2(values);
+  case SimdLevel::SSE2:
+    return SumSse2(values);
+  default:
+    break;
+  }
+#endif
+  double sum = 0;
+  for (double v : values) {
+    sum += v;
+  }
+  return sum;
+}
+
+double ArrayDot(std::span<const double> l, std::span<const double> r) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return DotAvx2(l.data(), r.data(), l.size());
+  case SimdLevel::SSE2:
+    return DotSse2(l.data(), r.data(), l.size());
+  default:
+    break;
+  }
+#endif
+  double sum = 0;
+  for (size_t i = 0; i < l.size(); ++i) {
+    sum += l[i] * r[i];
+  }
+  return sum;
+}
+
+double ArrayMin(std::span<const double> values) {
+  return PickExtremum(values, Extremum::MIN);
+}
+
+double ArrayMax(std::span<const double> values) {
+  return PickExtremum(values, Extremum::MAX);
+}
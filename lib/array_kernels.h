@@ -0,0 +1,32 @@
+#pragma once
+
+#include "simd.h"
+#include <cstddef>
+#include <span>
+
+// Elementwise arithmetic and reductions behind float64 arrays, vectorized
+// at the level chosen in simd.h.
+enum struct ArrayOp { ADD, SUB, MUL, DIV, POW };
+
+// out[i] = l[i] op r[i]. `out` may alias either input.
+void ApplyArrayOp(ArrayOp op, const double *l, const double *r, double *out,
+                  size_t size);
+// out[i] = l[i] op r.
+void ApplyArrayOp(ArrayOp op, const double *l, double r, double *out,
+                  size_t size);
+// out[i] = l op r[i].
+void ApplyArrayOp(ArrayOp op, double l, const double *r, double *out,
+                  size_t size);
+
+bool ContainsZero(std::span<const double> values);
+
+// Sums and dot products add up several lanes in parallel, so their last
+// bits may differ from a left-to-right sum.
+double ArraySum(std::span<const double> values);
+double ArrayDot(std::span<const double> l, std::span<const double> r);
+
+// Same as folding with `x < m ? x : m` (and `x > m` for ArrayMax) from the
+// first element, so a NaN only matters when it comes first. `values` must
+// not be empty.
+double ArrayMin(std::span<const double> values);
+double ArrayMax(std::span<const double> values);
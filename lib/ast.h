@@ -1,12 +1,19 @@
 #pragma once
 
 #include "lexer.h"
+#include "name_table.h"
+#include "number_format.h"
+#include <memory>
 
 namespace AST {
 
 struct BaseNode {
     BaseNode() = default;
   virtual ~BaseNode() = default;
+
+  // Source text the node was parsed from; set by the parser for statements
+  // and expressions.
+  SourceSpan span;
 };
 
 struct VariableNode : public BaseNode {
@@ -16,9 +23,21 @@ struct VariableNode : public BaseNode {
 };
 
 struct NumberNode : public BaseNode {
-  NumberNode(Token num) : number(num) {}
+  NumberNode(Token num) : number(num), value(0), integer(0), is_integer(false) {
+    if (ParseInteger(number.GetValue(), integer)) {
+      is_integer = true;
+      value = static_cast<double>(integer);
+    } else if (!ParseNumber(number.GetValue(), value)) {
+      throw std::runtime_error("Invalid number " + number.GetValue());
+    }
+  }
 
   Token number;
+  // Parsed once here instead of on every evaluation. Literals without a
+  // fraction or exponent that fit into int64_t evaluate to exact integers.
+  double value;
+  int64_t integer;
+  bool is_integer;
 };
 
 struct StringNode : public BaseNode {
@@ -42,10 +61,12 @@ struct BoolNode : public BaseNode {
 struct CallNode : public BaseNode {
   CallNode(std::string function, std::unique_ptr<BaseNode> obj,
            std::vector<std::unique_ptr<BaseNode>> arguments)
-      : func(function), object(std::move(obj)),
-        args(std::move(arguments)) {}
+      : func(function), func_id(NameTable::Intern(func)),
+        object(std::move(obj)), args(std::move(arguments)) {}
 
   std::string func;
+  // `func` in the NameTable, for call frames.
+  uint32_t func_id;
   std::unique_ptr<BaseNode> object;
   std::vector<std::unique_ptr<BaseNode>> args;
 };
@@ -57,6 +78,16 @@ struct ListNode : public BaseNode {
   std::vector<std::unique_ptr<BaseNode>> list;
 };
 
+struct DictNode : public BaseNode {
+  DictNode(std::vector<std::pair<std::unique_ptr<BaseNode>,
+                                 std::unique_ptr<BaseNode>>>
+               entries_arg)
+      : entries(std::move(entries_arg)) {}
+
+  std::vector<std::pair<std::unique_ptr<BaseNode>, std::unique_ptr<BaseNode>>>
+      entries;
+};
+
 struct IndexNode : public BaseNode {
   IndexNode(std::unique_ptr<BaseNode> obj, std::unique_ptr<BaseNode> ind)
       : object(std::move(obj)), index(std::move(ind)) {}
@@ -115,6 +146,21 @@ struct AssignmentNode : public BaseNode {
   std::unique_ptr<BaseNode> value;
 };
 
+// `variable[i1][i2]... op value`: assigns to an element of a list or dict
+// stored in a variable, going through one index per level.
+struct IndexAssignmentNode : public BaseNode {
+  IndexAssignmentNode(Token operation_arg, Token var,
+                      std::vector<std::unique_ptr<BaseNode>> indices_arg,
+                      std::unique_ptr<BaseNode> val)
+      : operation(operation_arg), variable(var),
+        indices(std::move(indices_arg)), value(std::move(val)) {}
+
+  Token operation;
+  Token variable;
+  std::vector<std::unique_ptr<BaseNode>> indices;
+  std::unique_ptr<BaseNode> value;
+};
+
 struct IfNode : public BaseNode {
   IfNode(std::unique_ptr<BaseNode> conditional_arg,
          std::unique_ptr<BlockNode> then_arg,
@@ -152,13 +198,58 @@ struct ForNode : public BaseNode {
   std::unique_ptr<BlockNode> then;
 };
 
+struct YieldNode : public BaseNode {
+  YieldNode(std::unique_ptr<BaseNode> val) : value(std::move(val)) {}
+
+  std::unique_ptr<BaseNode> value;
+};
+
+// Whether `block` yields, not counting functions defined inside it. yield is
+// a statement, so only blocks and the bodies of if, while and for are
+// searched.
+inline bool ContainsYield(const BlockNode &block) {
+  for (const auto &node : block.nodes) {
+    if (dynamic_cast<const YieldNode *>(node.get())) {
+      return true;
+    }
+    if (auto if_node = dynamic_cast<const IfNode *>(node.get())) {
+      if (ContainsYield(*if_node->then) ||
+          (if_node->eelse && ContainsYield(*if_node->eelse))) {
+        return true;
+      }
+      for (const auto &[cond, then] : if_node->else_if) {
+        if (ContainsYield(*then)) {
+          return true;
+        }
+      }
+    }
+    if (auto while_node = dynamic_cast<const WhileNode *>(node.get())) {
+      if (ContainsYield(*while_node->then)) {
+        return true;
+      }
+    }
+    if (auto for_node = dynamic_cast<const ForNode *>(node.get())) {
+      if (ContainsYield(*for_node->then)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 struct FunctionNode : public BaseNode {
   FunctionNode(std::vector<std::unique_ptr<BaseNode>> args_arg,
-               std::unique_ptr<BlockNode> then_arg)
-      : args(std::move(args_arg)), then(std::move(then_arg)) {}
+               std::shared_ptr<BlockNode> then_arg)
+      : args(std::move(args_arg)), then(std::move(then_arg)),
+        generator(ContainsYield(*then)) {}
 
   std::vector<std::unique_ptr<BaseNode>> args;
-  std::unique_ptr<BlockNode> then;
+  // Shared with every Function value created from this literal, so the tree
+  // stays intact and can be evaluated again (or reused from the cache).
+  std::shared_ptr<BlockNode> then;
+  // Calling a function whose body yields returns a generator instead of
+  // running the body.
+  bool generator;
 };
 
 struct BreakNode : public BaseNode {
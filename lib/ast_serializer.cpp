@@ -0,0 +1,509 @@
+#include "ast_serializer.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+enum class NodeTag : uint8_t {
+  NONE,
+  VARIABLE,
+  NUMBER,
+  STRING,
+  NIL,
+  BOOL,
+  CALL,
+  LIST,
+  INDEX,
+  SLICE,
+  BIN_OPERATION,
+  UNARY_OPERATION,
+  BLOCK,
+  ASSIGNMENT,
+  IF,
+  WHILE,
+  FOR,
+  FUNCTION,
+  BREAK,
+  CONTINUE,
+  RETURN,
+  YIELD,
+  DICT,
+  INDEX_ASSIGNMENT,
+};
+
+class Writer {
+public:
+  std::string Finish() { return std::move(out_); }
+
+  void WriteU8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+
+  void WriteU32(uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+      out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+  }
+
+  void WriteString(const std::string &s) {
+    WriteU32(static_cast<uint32_t>(s.size()));
+    out_.append(s);
+  }
+
+  void WriteSpan(const SourceSpan &span) {
+    WriteU32(span.begin.line);
+    WriteU32(span.begin.column);
+    WriteU32(span.end.line);
+    WriteU32(span.end.column);
+  }
+
+  void WriteToken(const Token &token) {
+    WriteU8(static_cast<uint8_t>(token.GetType()));
+    WriteString(token.GetValue());
+    WriteSpan(token.GetSpan());
+  }
+
+  void WriteTag(NodeTag tag, const AST::BaseNode *node) {
+    WriteU8(static_cast<uint8_t>(tag));
+    WriteSpan(node->span);
+  }
+
+  void WriteNodes(const std::vector<std::unique_ptr<AST::BaseNode>> &nodes) {
+    WriteU32(static_cast<uint32_t>(nodes.size()));
+    for (const auto &node : nodes) {
+      WriteNode(node.get());
+    }
+  }
+
+  void WriteNode(const AST::BaseNode *node) {
+    if (node == nullptr) {
+      WriteU8(static_cast<uint8_t>(NodeTag::NONE));
+      return;
+    }
+
+    if (auto var = dynamic_cast<const AST::VariableNode *>(node)) {
+      WriteTag(NodeTag::VARIABLE, node);
+      WriteToken(var->variable);
+      return;
+    }
+
+    if (auto num = dynamic_cast<const AST::NumberNode *>(node)) {
+      WriteTag(NodeTag::NUMBER, node);
+      WriteToken(num->number);
+      return;
+    }
+
+    if (auto str = dynamic_cast<const AST::StringNode *>(node)) {
+      WriteTag(NodeTag::STRING, node);
+      WriteToken(str->string);
+      return;
+    }
+
+    if (auto nil = dynamic_cast<const AST::NilNode *>(node)) {
+      WriteTag(NodeTag::NIL, node);
+      WriteToken(nil->nil);
+      return;
+    }
+
+    if (auto bool_node = dynamic_cast<const AST::BoolNode *>(node)) {
+      WriteTag(NodeTag::BOOL, node);
+      WriteToken(bool_node->_bool);
+      return;
+    }
+
+    if (auto call = dynamic_cast<const AST::CallNode *>(node)) {
+      WriteTag(NodeTag::CALL, node);
+      WriteString(call->func);
+      WriteNode(call->object.get());
+      WriteNodes(call->args);
+      return;
+    }
+
+    if (auto list_node = dynamic_cast<const AST::ListNode *>(node)) {
+      WriteTag(NodeTag::LIST, node);
+      WriteNodes(list_node->list);
+      return;
+    }
+
+    if (auto dict_node = dynamic_cast<const AST::DictNode *>(node)) {
+      WriteTag(NodeTag::DICT, node);
+      WriteU32(static_cast<uint32_t>(dict_node->entries.size()));
+      for (const auto &[key, value] : dict_node->entries) {
+        WriteNode(key.get());
+        WriteNode(value.get());
+      }
+      return;
+    }
+
+    if (auto index_node = dynamic_cast<const AST::IndexNode *>(node)) {
+      WriteTag(NodeTag::INDEX, node);
+      WriteNode(index_node->object.get());
+      WriteNode(index_node->index.get());
+      return;
+    }
+
+    if (auto slice_node = dynamic_cast<const AST::SliceNode *>(node)) {
+      WriteTag(NodeTag::SLICE, node);
+      WriteNode(slice_node->object.get());
+      WriteNode(slice_node->start.get());
+      WriteNode(slice_node->end.get());
+      return;
+    }
+
+    if (auto bin = dynamic_cast<const AST::BinOperationNode *>(node)) {
+      WriteTag(NodeTag::BIN_OPERATION, node);
+      WriteToken(bin->operation);
+      WriteNode(bin->left.get());
+      WriteNode(bin->right.get());
+      return;
+    }
+
+    if (auto unary = dynamic_cast<const AST::UnaryOperationNode *>(node)) {
+      WriteTag(NodeTag::UNARY_OPERATION, node);
+      WriteToken(unary->operation);
+      WriteNode(unary->node.get());
+      return;
+    }
+
+    if (auto block = dynamic_cast<const AST::BlockNode *>(node)) {
+      WriteTag(NodeTag::BLOCK, node);
+      WriteNodes(block->nodes);
+      return;
+    }
+
+    if (auto assignment = dynamic_cast<const AST::AssignmentNode *>(node)) {
+      WriteTag(NodeTag::ASSIGNMENT, node);
+      WriteToken(assignment->operation);
+      WriteToken(assignment->variable);
+      WriteNode(assignment->value.get());
+      return;
+    }
+
+    if (auto assignment =
+            dynamic_cast<const AST::IndexAssignmentNode *>(node)) {
+      WriteTag(NodeTag::INDEX_ASSIGNMENT, node);
+      WriteToken(assignment->operation);
+      WriteToken(assignment->variable);
+      WriteNodes(assignment->indices);
+      WriteNode(assignment->value.get());
+      return;
+    }
+
+    if (auto if_node = dynamic_cast<const AST::IfNode *>(node)) {
+      WriteTag(NodeTag::IF, node);
+      WriteNode(if_node->conditional.get());
+      WriteNode(if_node->then.get());
+      WriteU32(static_cast<uint32_t>(if_node->else_if.size()));
+      for (const auto &[cond, then] : if_node->else_if) {
+        WriteNode(cond.get());
+        WriteNode(then.get());
+      }
+      WriteNode(if_node->eelse.get());
+      return;
+    }
+
+    if (auto while_node = dynamic_cast<const AST::WhileNode *>(node)) {
+      WriteTag(NodeTag::WHILE, node);
+      WriteNode(while_node->conditional.get());
+      WriteNode(while_node->then.get());
+      return;
+    }
+
+    if (auto for_node = dynamic_cast<const AST::ForNode *>(node)) {
+      WriteTag(NodeTag::FOR, node);
+      WriteToken(for_node->iterator);
+      WriteNode(for_node->conditional.get());
+      WriteNode(for_node->then.get());
+      return;
+    }
+
+    if (auto func = dynamic_cast<const AST::FunctionNode *>(node)) {
+      WriteTag(NodeTag::FUNCTION, node);
+      WriteNodes(func->args);
+      WriteNode(func->then.get());
+      return;
+    }
+
+    if (dynamic_cast<const AST::BreakNode *>(node)) {
+      WriteTag(NodeTag::BREAK, node);
+      return;
+    }
+
+    if (dynamic_cast<const AST::ContinueNode *>(node)) {
+      WriteTag(NodeTag::CONTINUE, node);
+      return;
+    }
+
+    if (auto return_node = dynamic_cast<const AST::ReturnNode *>(node)) {
+      WriteTag(NodeTag::RETURN, node);
+      WriteNode(return_node->value.get());
+      return;
+    }
+
+    if (auto yield_node = dynamic_cast<const AST::YieldNode *>(node)) {
+      WriteTag(NodeTag::YIELD, node);
+      WriteNode(yield_node->value.get());
+      return;
+    }
+
+    throw std::runtime_error("Unknown AST Node");
+  }
+
+private:
+  std::string out_;
+};
+
+// Reads what Writer wrote. Besides running out of bytes, an image is
+// rejected when a child the AST can not do without is missing or nodes
+// are nested deeper than kMaxDepth, so a damaged file can neither crash
+// the interpreter later nor overflow the stack here.
+class Reader {
+public:
+  static constexpr size_t kMaxDepth = 1024;
+
+  Reader(std::string_view data) : data_(data), pos_(0) {}
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+  uint8_t ReadU8() {
+    Need(1);
+    return static_cast<uint8_t>(data_[pos_++]);
+  }
+
+  uint32_t ReadU32() {
+    Need(4);
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+      v |= static_cast<uint32_t>(static_cast<uint8_t>(data_[pos_++]))
+           << (8 * i);
+    }
+    return v;
+  }
+
+  std::string ReadString() {
+    uint32_t size = ReadU32();
+    Need(size);
+    std::string s(data_.substr(pos_, size));
+    pos_ += size;
+    return s;
+  }
+
+  SourceSpan ReadSpan() {
+    SourceSpan span;
+    span.begin.line = ReadU32();
+    span.begin.column = ReadU32();
+    span.end.line = ReadU32();
+    span.end.column = ReadU32();
+    return span;
+  }
+
+  Token ReadToken() {
+    uint8_t type = ReadU8();
+    if (type > static_cast<uint8_t>(TokenType::IDENTIFIER)) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+    std::string value = ReadString();
+    return Token(static_cast<TokenType>(type), std::move(value), ReadSpan());
+  }
+
+  std::vector<std::unique_ptr<AST::BaseNode>> ReadNodes() {
+    uint32_t size = ReadU32();
+    std::vector<std::unique_ptr<AST::BaseNode>> nodes;
+    for (uint32_t i = 0; i < size; ++i) {
+      nodes.push_back(ReadRequired());
+    }
+    return nodes;
+  }
+
+  std::unique_ptr<AST::BlockNode> ReadBlock() {
+    std::unique_ptr<AST::BlockNode> block = ReadOptionalBlock();
+    if (block == nullptr) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+    return block;
+  }
+
+  std::unique_ptr<AST::BlockNode> ReadOptionalBlock() {
+    std::unique_ptr<AST::BaseNode> node = ReadNode();
+    if (node == nullptr) {
+      return nullptr;
+    }
+    auto block = dynamic_cast<AST::BlockNode *>(node.get());
+    if (block == nullptr) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+    node.release();
+    return std::unique_ptr<AST::BlockNode>(block);
+  }
+
+  std::unique_ptr<AST::BaseNode> ReadRequired() {
+    std::unique_ptr<AST::BaseNode> node = ReadNode();
+    if (node == nullptr) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+    return node;
+  }
+
+  std::unique_ptr<AST::BaseNode> ReadNode() {
+    auto tag = static_cast<NodeTag>(ReadU8());
+    if (tag == NodeTag::NONE) {
+      return nullptr;
+    }
+    if (depth_ == kMaxDepth) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+    ++depth_;
+    SourceSpan span = ReadSpan();
+    std::unique_ptr<AST::BaseNode> node = ReadNodeBody(tag);
+    node->span = span;
+    --depth_;
+    return node;
+  }
+
+  std::unique_ptr<AST::BaseNode> ReadNodeBody(NodeTag tag) {
+    switch (tag) {
+    case NodeTag::NONE:
+      break;
+    case NodeTag::VARIABLE:
+      return std::make_unique<AST::VariableNode>(ReadToken());
+    case NodeTag::NUMBER:
+      return std::make_unique<AST::NumberNode>(ReadToken());
+    case NodeTag::STRING:
+      return std::make_unique<AST::StringNode>(ReadToken());
+    case NodeTag::NIL:
+      return std::make_unique<AST::NilNode>(ReadToken());
+    case NodeTag::BOOL:
+      return std::make_unique<AST::BoolNode>(ReadToken());
+    case NodeTag::CALL: {
+      std::string func = ReadString();
+      std::unique_ptr<AST::BaseNode> object = ReadNode();
+      return std::make_unique<AST::CallNode>(func, std::move(object),
+                                             ReadNodes());
+    }
+    case NodeTag::LIST:
+      return std::make_unique<AST::ListNode>(ReadNodes());
+    case NodeTag::INDEX: {
+      std::unique_ptr<AST::BaseNode> object = ReadRequired();
+      return std::make_unique<AST::IndexNode>(std::move(object),
+                                              ReadRequired());
+    }
+    case NodeTag::SLICE: {
+      std::unique_ptr<AST::BaseNode> object = ReadRequired();
+      std::unique_ptr<AST::BaseNode> start = ReadRequired();
+      return std::make_unique<AST::SliceNode>(std::move(object),
+                                              std::move(start), ReadRequired());
+    }
+    case NodeTag::BIN_OPERATION: {
+      Token operation = ReadToken();
+      std::unique_ptr<AST::BaseNode> left = ReadRequired();
+      return std::make_unique<AST::BinOperationNode>(std::move(left),
+                                                     operation, ReadRequired());
+    }
+    case NodeTag::UNARY_OPERATION: {
+      Token operation = ReadToken();
+      return std::make_unique<AST::UnaryOperationNode>(operation,
+                                                       ReadRequired());
+    }
+    case NodeTag::BLOCK: {
+      auto block = std::make_unique<AST::BlockNode>();
+      block->nodes = ReadNodes();
+      return block;
+    }
+    case NodeTag::ASSIGNMENT: {
+      Token operation = ReadToken();
+      Token variable = ReadToken();
+      return std::make_unique<AST::AssignmentNode>(operation, variable,
+                                                   ReadRequired());
+    }
+    case NodeTag::IF: {
+      std::unique_ptr<AST::BaseNode> conditional = ReadRequired();
+      std::unique_ptr<AST::BlockNode> then = ReadBlock();
+      std::vector<
+          std::pair<std::unique_ptr<AST::BaseNode>, std::unique_ptr<AST::BlockNode>>>
+          else_if;
+      uint32_t size = ReadU32();
+      for (uint32_t i = 0; i < size; ++i) {
+        std::unique_ptr<AST::BaseNode> cond = ReadRequired();
+        else_if.emplace_back(std::move(cond), ReadBlock());
+      }
+      return std::make_unique<AST::IfNode>(std::move(conditional),
+                                           std::move(then), std::move(else_if),
+                                           ReadOptionalBlock());
+    }
+    case NodeTag::WHILE: {
+      std::unique_ptr<AST::BaseNode> conditional = ReadRequired();
+      return std::make_unique<AST::WhileNode>(std::move(conditional),
+                                              ReadBlock());
+    }
+    case NodeTag::FOR: {
+      Token iterator = ReadToken();
+      std::unique_ptr<AST::BaseNode> conditional = ReadRequired();
+      return std::make_unique<AST::ForNode>(iterator, std::move(conditional),
+                                            ReadBlock());
+    }
+    case NodeTag::FUNCTION: {
+      std::vector<std::unique_ptr<AST::BaseNode>> args = ReadNodes();
+      return std::make_unique<AST::FunctionNode>(std::move(args), ReadBlock());
+    }
+    case NodeTag::BREAK:
+      return std::make_unique<AST::BreakNode>();
+    case NodeTag::CONTINUE:
+      return std::make_unique<AST::ContinueNode>();
+    case NodeTag::RETURN: {
+      std::unique_ptr<AST::BaseNode> value = ReadNode();
+      if (value == nullptr) {
+        return std::make_unique<AST::ReturnNode>();
+      }
+      return std::make_unique<AST::ReturnNode>(std::move(value));
+    }
+    case NodeTag::YIELD:
+      return std::make_unique<AST::YieldNode>(ReadRequired());
+    case NodeTag::DICT: {
+      std::vector<std::pair<std::unique_ptr<AST::BaseNode>,
+                            std::unique_ptr<AST::BaseNode>>>
+          entries;
+      uint32_t size = ReadU32();
+      for (uint32_t i = 0; i < size; ++i) {
+        std::unique_ptr<AST::BaseNode> key = ReadRequired();
+        entries.emplace_back(std::move(key), ReadRequired());
+      }
+      return std::make_unique<AST::DictNode>(std::move(entries));
+    }
+    case NodeTag::INDEX_ASSIGNMENT: {
+      Token operation = ReadToken();
+      Token variable = ReadToken();
+      std::vector<std::unique_ptr<AST::BaseNode>> indices = ReadNodes();
+      return std::make_unique<AST::IndexAssignmentNode>(
+          operation, variable, std::move(indices), ReadRequired());
+    }
+    }
+    throw std::runtime_error("Corrupted program cache");
+  }
+
+private:
+  std::string_view data_;
+  size_t pos_;
+  size_t depth_ = 0;
+
+  void Need(size_t size) {
+    if (data_.size() - pos_ < size) {
+      throw std::runtime_error("Corrupted program cache");
+    }
+  }
+};
+
+} // namespace
+
+std::string SerializeProgram(const AST::BlockNode &root) {
+  Writer writer;
+  writer.WriteNode(&root);
+  return writer.Finish();
+}
+
+std::unique_ptr<AST::BlockNode> DeserializeProgram(std::string_view data) {
+  Reader reader(data);
+  std::unique_ptr<AST::BlockNode> root = reader.ReadBlock();
+  if (!reader.AtEnd()) {
+    throw std::runtime_error("Corrupted program cache");
+  }
+  return root;
+}
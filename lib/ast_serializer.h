@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ast.h"
+#include <string>
+#include <string_view>
+
+// Flat pre-order binary encoding of a parsed program. Every node is written
+// as a one byte tag and its source span followed by its tokens and children,
+// so a program can be restored, source positions included, without running
+// the lexer and the parser again.
+std::string SerializeProgram(const AST::BlockNode &root);
+std::unique_ptr<AST::BlockNode> DeserializeProgram(std::string_view data);
@@ -0,0 +1,162 @@
+#include "dict.h"
+#include "number_ops.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Final mixing step of splitmix64: spreads every input bit over the whole
+// word, so the low bits used for the slot and the high bits used for the
+// tag are both well distributed.
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+bool SameKey(const Value &a, const Value &b) {
+  if (a.IsNumber()) {
+    return b.IsNumber() && CompareNumbers(a, b) == 0;
+  }
+  return b.IsString() && a.GetStringView() == b.GetStringView();
+}
+
+uint32_t TagOf(uint64_t hash) { return static_cast<uint32_t>(hash >> 32); }
+
+} // namespace
+
+uint64_t DictTable::HashKey(const Value &key) {
+  // Whole numbers hash by their integer value whichever way they are
+  // stored, so 2 and 2.0 find the same entry.
+  int64_t integer;
+  if (GetInteger(key, integer)) {
+    return Mix(static_cast<uint64_t>(integer));
+  }
+  if (auto d = std::get_if<double>(&key)) {
+    if (std::isnan(*d)) {
+      throw std::runtime_error("NaN can not be a dict key");
+    }
+    return Mix(std::bit_cast<uint64_t>(*d));
+  }
+  if (key.IsString()) {
+    return Mix(std::hash<std::string_view>{}(key.GetStringView()) ^
+               0x9E3779B97F4A7C15ULL);
+  }
+  throw std::runtime_error("Dict keys must be numbers or strings");
+}
+
+DictTable &DictTable::Writable(Dict &dict) {
+  if (dict.table == nullptr) {
+    dict.table = std::make_shared<DictTable>();
+  } else if (dict.table.use_count() > 1) {
+    dict.table = std::make_shared<DictTable>(*dict.table);
+  }
+  return *dict.table;
+}
+
+size_t DictTable::Lookup(const Value &key, uint64_t hash) const {
+  if (index_.empty()) {
+    return 0;
+  }
+  size_t mask = index_.size() - 1;
+  uint32_t tag = TagOf(hash);
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot &slot = index_[i];
+    if (slot.entry == kEmpty) {
+      return index_.size();
+    }
+    if (slot.entry != kErased && slot.tag == tag) {
+      const Entry &entry = entries_[slot.entry];
+      if (entry.hash == hash && SameKey(entry.key, key)) {
+        return i;
+      }
+    }
+  }
+}
+
+const Value *DictTable::Find(const Value &key) const {
+  size_t slot = Lookup(key, HashKey(key));
+  if (slot == index_.size()) {
+    return nullptr;
+  }
+  return &entries_[index_[slot].entry].value;
+}
+
+Value *DictTable::Find(const Value &key) {
+  return const_cast<Value *>(std::as_const(*this).Find(key));
+}
+
+void DictTable::Set(const Value &key, Value value) {
+  uint64_t hash = HashKey(key);
+  size_t slot = Lookup(key, hash);
+  if (slot != index_.size()) {
+    entries_[index_[slot].entry].value = std::move(value);
+    return;
+  }
+
+  // Erased entries still occupy their index slot, so the load factor counts
+  // them until the next rebuild drops them.
+  if ((entries_.size() + 1) * 2 > index_.size()) {
+    Rebuild(std::max<size_t>(8, std::bit_ceil((size_ + 1) * 4)));
+  }
+
+  // Slices of large strings would keep the whole buffer alive as long as
+  // the dict; keys are copied out of them.
+  Value stored_key = key;
+  if (key.IsString() && !std::holds_alternative<std::string>(key)) {
+    stored_key = std::string(key.GetStringView());
+  }
+
+  size_t mask = index_.size() - 1;
+  size_t i = hash & mask;
+  while (index_[i].entry != kEmpty && index_[i].entry != kErased) {
+    i = (i + 1) & mask;
+  }
+  index_[i] = {TagOf(hash), static_cast<uint32_t>(entries_.size())};
+  entries_.push_back({hash, std::move(stored_key), std::move(value)});
+  ++size_;
+}
+
+bool DictTable::Erase(const Value &key) {
+  size_t slot = Lookup(key, HashKey(key));
+  if (slot == index_.size()) {
+    return false;
+  }
+  Entry &entry = entries_[index_[slot].entry];
+  entry.deleted = true;
+  entry.key = nullptr;
+  entry.value = nullptr;
+  index_[slot].entry = kErased;
+  --size_;
+  return true;
+}
+
+const Value *DictTable::NextKey(size_t &position) const {
+  while (position < entries_.size()) {
+    const Entry &entry = entries_[position++];
+    if (!entry.deleted) {
+      return &entry.key;
+    }
+  }
+  return nullptr;
+}
+
+void DictTable::Rebuild(size_t capacity) {
+  std::erase_if(entries_, [](const Entry &entry) { return entry.deleted; });
+  index_.assign(capacity, Slot{0, kEmpty});
+  size_t mask = capacity - 1;
+  for (size_t e = 0; e < entries_.size(); ++e) {
+    size_t i = entries_[e].hash & mask;
+    while (index_[i].entry != kEmpty) {
+      i = (i + 1) & mask;
+    }
+    index_[i] = {TagOf(entries_[e].hash), static_cast<uint32_t>(e)};
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <vector>
+
+// Hash table behind dict values. Entries live in one array in insertion
+// order, and an open-addressing index with linear probing points into it.
+// Index slots hold the top bits of the key's hash next to the entry number,
+// so a probe sequence reads one compact array and compares keys only on a
+// likely match. Entries keep the full hash of their key, so growing the
+// table never hashes a string again.
+//
+// Keys are numbers and strings. -0 and 0 are the same key, NaN is not a
+// valid key.
+class DictTable {
+public:
+  static uint64_t HashKey(const Value &key);
+
+  // Table of `dict` that may be modified, cloned first if it is shared
+  // with other values.
+  static DictTable &Writable(Dict &dict);
+
+  size_t Size() const { return size_; }
+
+  // Value stored under `key`, or nullptr.
+  const Value *Find(const Value &key) const;
+  Value *Find(const Value &key);
+
+  void Set(const Value &key, Value value);
+
+  // Returns false if there was no such key.
+  bool Erase(const Value &key);
+
+  // Key of the first entry at or after `position` in insertion order,
+  // advancing `position` past it; nullptr at the end. Used to iterate.
+  const Value *NextKey(size_t &position) const;
+
+  // Calls f(key, value) for every entry in insertion order.
+  template <class F> void ForEach(F f) const {
+    for (const Entry &entry : entries_) {
+      if (!entry.deleted) {
+        f(entry.key, entry.value);
+      }
+    }
+  }
+
+private:
+  struct Entry {
+    uint64_t hash;
+    Value key;
+    Value value;
+    bool deleted = false;
+  };
+
+  struct Slot {
+    uint32_t tag;
+    uint32_t entry;
+  };
+
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+  static constexpr uint32_t kErased = UINT32_MAX - 1;
+
+  // Index slot holding `key`, or the index size if it is absent.
+  size_t Lookup(const Value &key, uint64_t hash) const;
+  void Rebuild(size_t capacity);
+
+  std::vector<Entry> entries_;
+  std::vector<Slot> index_;
+  size_t size_ = 0;
+};
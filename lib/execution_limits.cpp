@@ -0,0 +1,54 @@
+#include "execution_limits.h"
+
+#include <algorithm>
+#include <string>
+
+const char *StopReasonName(StopReason reason) {
+  switch (reason) {
+  case StopReason::NONE:
+    return "none";
+  case StopReason::STEP_LIMIT:
+    return "step limit exceeded";
+  case StopReason::DEADLINE:
+    return "time limit exceeded";
+  case StopReason::CANCELLED:
+    return "cancelled";
+  }
+  return "";
+}
+
+ExecutionStopped::ExecutionStopped(StopReason reason)
+    : std::runtime_error(std::string("Execution stopped: ") +
+                         StopReasonName(reason)),
+      reason_(reason) {}
+
+ExecutionBudget::ExecutionBudget(const ExecutionLimits &limits)
+    : limits_(limits),
+      deadline_(limits.timeout.count() != 0
+                    ? std::chrono::steady_clock::now() + limits.timeout
+                    : std::chrono::steady_clock::time_point::max()) {}
+
+uint64_t ExecutionBudget::Check(uint64_t steps) {
+  uint64_t total = steps_.fetch_add(steps, std::memory_order_relaxed) + steps;
+  if (limits_.cancel != nullptr &&
+      limits_.cancel->load(std::memory_order_relaxed)) {
+    throw ExecutionStopped(StopReason::CANCELLED);
+  }
+  if (limits_.max_steps != 0 && total > limits_.max_steps) {
+    throw ExecutionStopped(StopReason::STEP_LIMIT);
+  }
+  if (limits_.timeout.count() != 0 &&
+      std::chrono::steady_clock::now() >= deadline_) {
+    throw ExecutionStopped(StopReason::DEADLINE);
+  }
+  if (limits_.safe_point) {
+    limits_.safe_point();
+  }
+
+  uint64_t interval = std::max<uint32_t>(limits_.check_interval, 1);
+  if (limits_.max_steps != 0) {
+    // Check again right at the step that goes over the limit.
+    interval = std::min(interval, limits_.max_steps - total + 1);
+  }
+  return interval;
+}
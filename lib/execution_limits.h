@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
+// Why a run was stopped before the script finished.
+enum struct StopReason { NONE, STEP_LIMIT, DEADLINE, CANCELLED };
+
+const char *StopReasonName(StopReason reason);
+
+// Thrown out of a script that ran into one of its ExecutionLimits. Scripts
+// can not catch it; Isolate::Run reports it like any other error, and
+// tells it apart through Isolate::Stopped().
+class ExecutionStopped : public std::runtime_error {
+public:
+  explicit ExecutionStopped(StopReason reason);
+
+  StopReason Reason() const { return reason_; }
+
+private:
+  StopReason reason_;
+};
+
+// Limits for one run of a script. A step is one iteration of a loop or one
+// call of a user function, so every way a script can run for long takes
+// steps; the limits are checked once every `check_interval` steps. Builtins
+// are not interrupted: a sort of a huge list or a blocking read() finishes
+// before the next check.
+struct ExecutionLimits {
+  // Steps a run may take; 0 is unlimited.
+  uint64_t max_steps = 0;
+  // Wall-clock time a run may take from its start; zero is unlimited.
+  std::chrono::milliseconds timeout{0};
+  // Stops the run at the next check once another thread sets it.
+  const std::atomic<bool> *cancel = nullptr;
+  // Called at every check, on the thread running the script, after the
+  // limits are checked. The embedder may yield or reschedule here, or
+  // throw to stop the run.
+  std::function<void()> safe_point;
+  uint32_t check_interval = 1024;
+
+  bool Limited() const {
+    return max_steps != 0 || timeout.count() != 0 || cancel != nullptr ||
+           safe_point != nullptr;
+  }
+};
+
+// State of one run under ExecutionLimits, shared by the interpreter running
+// the script and the workers of its parallel builtins and spawned tasks.
+// Each interpreter counts its steps locally and reports them here at every
+// check, so the shared counter is touched once per check interval.
+class ExecutionBudget {
+public:
+  explicit ExecutionBudget(const ExecutionLimits &limits);
+
+  // Adds `steps` taken since the last check, throws ExecutionStopped when a
+  // limit is reached and calls the safe point hook. Returns the number of
+  // steps until the next check.
+  uint64_t Check(uint64_t steps);
+
+  uint64_t Steps() const { return steps_.load(std::memory_order_relaxed); }
+
+private:
+  const ExecutionLimits &limits_;
+  std::chrono::steady_clock::time_point deadline_;
+  std::atomic<uint64_t> steps_ = 0;
+};
@@ -10,6 +10,8 @@ struct Scope;
 struct Function {
   std::string name;
   std::vector<std::string> args;
-  std::unique_ptr<AST::BlockNode> body;
+  std::shared_ptr<AST::BlockNode> body;
   std::shared_ptr<Scope> closure;
+  // The body yields: calls return a Generator.
+  bool generator = false;
 };
@@ -0,0 +1,31 @@
+#include "generator.h"
+
+#include "interpreter.h"
+
+Generator::Generator(std::shared_ptr<Function> function,
+                     std::shared_ptr<Scope> scope)
+    : function_(std::move(function)), scope_(std::move(scope)) {
+  frames_.push_back({FrameKind::BLOCK, function_->body.get()});
+}
+
+bool Generator::Next(Value &out) {
+  std::thread::id self = std::this_thread::get_id();
+  if (running_on_.load() == self) {
+    throw std::runtime_error("Generator is already running");
+  }
+
+  std::lock_guard lock(mutex_);
+  if (frames_.empty()) {
+    return false;
+  }
+  running_on_.store(self);
+  try {
+    bool produced = Interpret::Resume(*this, out);
+    running_on_.store(std::thread::id());
+    return produced;
+  } catch (...) {
+    running_on_.store(std::thread::id());
+    frames_.clear();
+    throw;
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ast.h"
+#include "function.h"
+#include "iterator.h"
+#include "value.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Scope;
+
+// Iterator returned by a call to a function that yields. It is stackless:
+// instead of a suspended native stack it keeps the position of every block
+// and loop it is inside of, so a suspended generator costs its local scope
+// and a few frames. Each Next() runs the body from there up to the next
+// yield. Calls from different threads (pmap workers, spawned tasks) take
+// turns, so every value goes to one caller; a call from inside the body
+// itself is an error.
+class Generator : public Iterator {
+public:
+  Generator(std::shared_ptr<Function> function, std::shared_ptr<Scope> scope);
+
+  bool Next(Value &out) override;
+
+private:
+  friend class Interpret;
+
+  enum struct FrameKind { BLOCK, WHILE, FOR };
+
+  struct Frame {
+    FrameKind kind;
+    AST::BaseNode *node;
+    // Next statement of a block, or next element of a list in a for loop.
+    size_t position = 0;
+    // The list or iterator a for loop goes over; nil in other frames.
+    Value iterable = nullptr;
+  };
+
+  std::shared_ptr<Function> function_;
+  std::shared_ptr<Scope> scope_;
+  std::vector<Frame> frames_;
+  std::mutex mutex_;
+  // Thread running the body, if any.
+  std::atomic<std::thread::id> running_on_;
+};
@@ -0,0 +1,105 @@
+#include "input_source.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#define ITMOSCRIPT_HAS_READ 1
+#else
+#include <cstdio>
+#endif
+
+InputSource::InputSource(int fd, size_t buffer_size)
+    : fd_(fd), stream_(nullptr), buffer_(buffer_size == 0 ? 1 : buffer_size),
+      pos_(0), end_(0), eof_(false) {}
+
+InputSource::InputSource(std::istream &in, size_t buffer_size)
+    : fd_(-1), stream_(in.rdbuf()),
+      buffer_(buffer_size == 0 ? 1 : buffer_size), pos_(0), end_(0),
+      eof_(false) {}
+
+InputSource &InputSource::Stdin() {
+  static InputSource input(0);
+  return input;
+}
+
+size_t InputSource::ReadChunk(char *data, size_t size) {
+  if (stream_ != nullptr) {
+    return static_cast<size_t>(
+        stream_->sgetn(data, static_cast<std::streamsize>(size)));
+  }
+#ifdef ITMOSCRIPT_HAS_READ
+  while (true) {
+    ssize_t got = ::read(fd_, data, size);
+    if (got >= 0) {
+      return static_cast<size_t>(got);
+    }
+    if (errno != EINTR) {
+      throw std::runtime_error("Can not read input");
+    }
+  }
+#else
+  return std::fread(data, 1, size, stdin);
+#endif
+}
+
+bool InputSource::Fill() {
+  if (eof_) {
+    return false;
+  }
+  pos_ = 0;
+  end_ = ReadChunk(buffer_.data(), buffer_.size());
+  if (end_ == 0) {
+    eof_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool InputSource::ReadLine(std::string &line) {
+  std::lock_guard lock(mutex_);
+  line.clear();
+  bool got_any = false;
+  while (true) {
+    if (pos_ == end_ && !Fill()) {
+      return got_any;
+    }
+    got_any = true;
+
+    const char *start = buffer_.data() + pos_;
+    size_t available = end_ - pos_;
+    auto newline =
+        static_cast<const char *>(std::memchr(start, '\n', available));
+    if (newline != nullptr) {
+      line.append(start, newline - start);
+      pos_ += (newline - start) + 1;
+      return true;
+    }
+    line.append(start, available);
+    pos_ = end_;
+  }
+}
+
+std::string InputSource::ReadAll() {
+  std::lock_guard lock(mutex_);
+  std::string result(buffer_.data() + pos_, end_ - pos_);
+  pos_ = end_ = 0;
+  if (eof_) {
+    return result;
+  }
+
+  size_t chunk = std::max<size_t>(buffer_.size(), 1 << 20);
+  while (true) {
+    size_t old_size = result.size();
+    result.resize(old_size + chunk);
+    size_t got = ReadChunk(result.data() + old_size, chunk);
+    result.resize(old_size + got);
+    if (got == 0) {
+      eof_ = true;
+      return result;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Block-buffered reader used by the input builtins. It reads a file
+// descriptor (or a streambuf) in large chunks and does not go through the
+// synchronized std::cin machinery. Reads take a lock of their own, so the
+// tasks and parallel workers of one isolate, and isolates sharing Stdin(),
+// can read from the same source: each line goes to exactly one reader.
+class InputSource {
+public:
+  static constexpr size_t kDefaultBufferSize = 1 << 16;
+
+  explicit InputSource(int fd, size_t buffer_size = kDefaultBufferSize);
+  explicit InputSource(std::istream &in,
+                       size_t buffer_size = kDefaultBufferSize);
+
+  InputSource(const InputSource &) = delete;
+  InputSource &operator=(const InputSource &) = delete;
+
+  // Reads the next line without its '\n'. Returns false at end of input.
+  bool ReadLine(std::string &line);
+  std::string ReadAll();
+
+  // Process standard input.
+  static InputSource &Stdin();
+
+private:
+  std::mutex mutex_;
+  int fd_;
+  std::streambuf *stream_;
+  std::vector<char> buffer_;
+  size_t pos_;
+  size_t end_;
+  bool eof_;
+
+  size_t ReadChunk(char *data, size_t size);
+  bool Fill();
+};
@@ -1,21 +1,256 @@
 #include "interpreter.h"
+#include "dict.h"
+#include "number_ops.h"
 
-Interpret *Interpret::current_ = nullptr;
+thread_local Interpret *Interpret::current_ = nullptr;
+
+namespace {
+
+// Makes an interpreter the current one of this thread for a scope.
+class CurrentInterpreter {
+public:
+  CurrentInterpreter(Interpret *interpreter, Interpret *&current)
+      : current_(current), previous_(current) {
+    current_ = interpreter;
+  }
+  ~CurrentInterpreter() { current_ = previous_; }
+
+private:
+  Interpret *&current_;
+  Interpret *previous_;
+};
+
+// Makes `scope` the innermost scope of an interpreter for a scope.
+class EnteredScope {
+public:
+  EnteredScope(std::shared_ptr<Scope> &global, std::shared_ptr<Scope> scope)
+      : global_(global), previous_(std::move(global)) {
+    global_ = std::move(scope);
+  }
+  ~EnteredScope() { global_ = std::move(previous_); }
+
+private:
+  std::shared_ptr<Scope> &global_;
+  std::shared_ptr<Scope> previous_;
+};
+
+// Reports a call to the profiler, if there is one, for a scope.
+class ProfiledCall {
+public:
+  ProfiledCall(Profiler *profiler, std::string_view name)
+      : profiler_(profiler) {
+    if (profiler_ != nullptr) {
+      profiler_->Enter(name);
+    }
+  }
+  ~ProfiledCall() {
+    if (profiler_ != nullptr) {
+      profiler_->Leave();
+    }
+  }
+
+private:
+  Profiler *profiler_;
+};
+
+// Reports the execution of a statement to the line profiler, if there is
+// one, for a scope.
+class ProfiledLine {
+public:
+  ProfiledLine(LineProfiler *profiler, const AST::BaseNode *stmt)
+      : profiler_(profiler) {
+    if (profiler_ != nullptr) {
+      profiler_->Enter(stmt->span.begin.line);
+    }
+  }
+  ~ProfiledLine() {
+    if (profiler_ != nullptr) {
+      profiler_->Leave();
+    }
+  }
+
+private:
+  LineProfiler *profiler_;
+};
+
+// What a binary operation with `left` as its left operand allocates.
+AllocKind ResultKind(const Value &left) {
+  if (left.IsString()) {
+    return AllocKind::STRING;
+  }
+  return left.IsList() ? AllocKind::LIST : AllocKind::OTHER;
+}
+
+// Allocation site of a builtin call: the builtin and the line calling it.
+// Only interned while allocations are counted.
+uint32_t BuiltinSite(const AST::CallNode *call) {
+  if (!MemoryStats::Enabled()) {
+    return 0;
+  }
+  return MemoryStats::NamedSite(call->func + " (line " +
+                                std::to_string(call->span.begin.line) + ")");
+}
+
+// Result of `current op= value` for an assignment operator.
+Value ApplyAssignment(TokenType op, const Value &current, const Value &value) {
+  if (op == TokenType::ASSIGN) {
+    return value;
+  }
+  if (op == TokenType::PLUS_A && current.IsString() && value.IsString()) {
+    return Value::Concat(current, value);
+  }
+  if (!current.IsNumber() || !value.IsNumber()) {
+    throw std::runtime_error("Unsupported operand types");
+  }
+  switch (op) {
+  case TokenType::PLUS_A:
+    return NumberArithmetic(TokenType::PLUS, current, value);
+  case TokenType::MINUS_A:
+    return NumberArithmetic(TokenType::MINUS, current, value);
+  case TokenType::MULTIPLY_A:
+    return NumberArithmetic(TokenType::MULTIPLY, current, value);
+  case TokenType::DIVIDE_A:
+    return NumberArithmetic(TokenType::DIVIDE, current, value);
+  case TokenType::MOD_A:
+    return NumberArithmetic(TokenType::MOD, current, value);
+  case TokenType::POW_A:
+    return NumberArithmetic(TokenType::POW, current, value);
+  default:
+    throw std::runtime_error("Unknown assignment operator");
+  }
+}
+
+// Position `index` in a sequence of `size` elements; throws unless it is a
+// whole number within range.
+size_t CheckedIndex(const Value &index, size_t size) {
+  int64_t i;
+  if (!GetInteger(index, i)) {
+    throw std::runtime_error("Index must be a number");
+  }
+  if (i < 0 || static_cast<uint64_t>(i) >= size) {
+    throw std::runtime_error("Index is out of range");
+  }
+  return static_cast<size_t>(i);
+}
+
+// Bounds [first, last) of the slice [start:end] of a sequence of `size`
+// elements, where a nil bound stands for the start or the end.
+std::pair<size_t, size_t> SliceBounds(const Value &start, const Value &end,
+                                      size_t size) {
+  int64_t first = 0;
+  int64_t last = static_cast<int64_t>(size);
+  if ((!std::holds_alternative<std::nullptr_t>(start) &&
+       !GetInteger(start, first)) ||
+      (!std::holds_alternative<std::nullptr_t>(end) &&
+       !GetInteger(end, last))) {
+    throw std::runtime_error("Index must be an integer number");
+  }
+  if (first < 0 || last <= first || last > static_cast<int64_t>(size)) {
+    throw std::runtime_error("Index is out of range");
+  }
+  return {static_cast<size_t>(first), static_cast<size_t>(last)};
+}
+
+// Element of a list or dict that an index assignment writes to. A list
+// that shares its elements is copied first, a shared dict table is cloned.
+// With `insert`, a missing dict key is added with the value nil.
+Value &ElementForWrite(Value &container, const Value &index, bool insert) {
+  if (auto dict = std::get_if<Dict>(&container)) {
+    DictTable &table = DictTable::Writable(*dict);
+    Value *element = table.Find(index);
+    if (element == nullptr) {
+      if (!insert) {
+        throw std::runtime_error("Key is not in the dict");
+      }
+      table.Set(index, nullptr);
+      element = table.Find(index);
+    }
+    return *element;
+  }
+
+  if (!container.IsList()) {
+    throw std::runtime_error("Only lists and dicts can be assigned by index");
+  }
+  size_t position = CheckedIndex(index, container.GetListView().size());
+  if (!std::holds_alternative<std::vector<Value>>(container)) {
+    container = container.CopyList();
+  }
+  return std::get<std::vector<Value>>(container)[position];
+}
+
+} // namespace
+
+// Pushes the frame of a call for a scope. Nothing is allocated: frames live
+// in a fixed array, and the function is referred to by its interned name.
+class Interpret::CallFrameScope {
+public:
+  CallFrameScope(Interpret &interpreter, const AST::CallNode *call)
+      : interpreter_(interpreter) {
+    size_t depth = interpreter_.depth_++;
+    if (depth < kMaxFrames) {
+      interpreter_.frames_[depth] = {call, call->func_id,
+                                     call->span.begin.line};
+    }
+  }
+  ~CallFrameScope() { --interpreter_.depth_; }
+
+  CallFrameScope(const CallFrameScope &) = delete;
+  CallFrameScope &operator=(const CallFrameScope &) = delete;
+
+private:
+  Interpret &interpreter_;
+};
 
 void Interpret::Run() {
-  Eval(root_.get());
+  CurrentInterpreter guard(this, current_);
+  try {
+    Eval(root_.get());
+  } catch (...) {
+    // Tasks may still use the script's input and output.
+    try {
+      JoinTasks();
+    } catch (...) {
+    }
+    throw;
+  }
+  JoinTasks();
+}
+
+Value Interpret::Call(const Value &func, const std::vector<Value> &args) {
+  CurrentInterpreter guard(this, current_);
+  if (auto fn = std::get_if<std::shared_ptr<Function>>(&func)) {
+    return CallUserFunction(*fn, args);
+  }
+  return CallFunction(func, args);
+}
+
+ExecutionBudget *Interpret::CurrentBudget() {
+  return current_ ? current_->budget_ : nullptr;
+}
+
+void Interpret::CheckBudget() {
+  budget_countdown_ = budget_period_ = budget_->Check(budget_period_);
+}
+
+OutputSink &Interpret::CurrentOutput(OutputSink &fallback) {
+  return current_ ? current_->out_ : fallback;
 }
 
 Value Interpret::Eval(AST::BaseNode *node) {
   if (auto num = dynamic_cast<AST::NumberNode *>(node)) {
-    return Value(std::stod(num->number.GetValue()));
+    return num->is_integer ? Value(num->integer) : Value(num->value);
   }
 
   if (auto var = dynamic_cast<AST::VariableNode *>(node)) {
-    return Value(global_->LookUp(var->variable.GetValue()));
+    // Reading a large string or list shares its buffer with the variable
+    // instead of copying it.
+    Value *slot = global_->Find(var->variable.GetValue());
+    slot->Share();
+    return *slot;
   }
 
   if (auto str = dynamic_cast<AST::StringNode *>(node)) {
+    AllocationScope scope(AllocKind::STRING);
     return Value(str->string.GetValue());
   }
 
@@ -33,6 +268,7 @@ Value Interpret::Eval(AST::BaseNode *node) {
   }
 
   if (auto list_node = dynamic_cast<AST::ListNode *>(node)) {
+    AllocationScope scope(AllocKind::LIST);
     std::vector<Value> list;
     for (const auto &elem : list_node->list) {
       list.push_back(Eval(elem.get()));
@@ -40,6 +276,17 @@ Value Interpret::Eval(AST::BaseNode *node) {
     return Value::MakeList(std::move(list));
   }
 
+  if (auto dict_node = dynamic_cast<AST::DictNode *>(node)) {
+    AllocationScope scope(AllocKind::DICT);
+    Dict dict;
+    DictTable &table = DictTable::Writable(dict);
+    for (const auto &[key, value] : dict_node->entries) {
+      Value k = Eval(key.get());
+      table.Set(k, Eval(value.get()));
+    }
+    return dict;
+  }
+
   if (auto index_node = dynamic_cast<AST::IndexNode *>(node)) {
     return ProcessingIndexNode(index_node);
   }
@@ -52,10 +299,10 @@ Value Interpret::Eval(AST::BaseNode *node) {
     Value value = Eval(unary_node->node.get());
     switch (unary_node->operation.GetType()) {
     case TokenType::MINUS:
-      if (!std::holds_alternative<double>(value)) {
+      if (!value.IsNumber()) {
         throw std::runtime_error("Unary operations are only for numbers");
       }
-      return -std::get<double>(value);
+      return NegateNumber(value);
     }
   }
 
@@ -67,6 +314,11 @@ Value Interpret::Eval(AST::BaseNode *node) {
     return ParseAssignmentNode(assignment_node);
   }
 
+  if (auto assignment_node =
+          dynamic_cast<AST::IndexAssignmentNode *>(node)) {
+    return ProcessingIndexAssignmentNode(assignment_node);
+  }
+
   if (auto if_node = dynamic_cast<AST::IfNode *>(node)) {
     return ProcessingIfNode(if_node);
   }
@@ -76,21 +328,7 @@ Value Interpret::Eval(AST::BaseNode *node) {
   }
 
   if (auto for_node = dynamic_cast<AST::ForNode *>(node)) {
-    Value iterable = Eval(for_node->conditional.get());
-
-    if (!std::holds_alternative<std::vector<Value>>(iterable)) {
-      throw std::runtime_error("Error in for");
-    }
-
-    const std::string &var_name = for_node->iterator.GetValue();
-    const auto &list = std::get<std::vector<Value>>(iterable);
-
-    for (const Value &item : list) {
-      global_->Assign(var_name, item);
-      Eval(for_node->then.get());
-    }
-
-    return Value();
+    return ProcessingForNode(for_node);
   }
 
   if (auto str = dynamic_cast<AST::BreakNode *>(node)) {
@@ -110,6 +348,10 @@ Value Interpret::Eval(AST::BaseNode *node) {
     throw ReturnException(value);
   }
 
+  if (dynamic_cast<AST::YieldNode *>(node)) {
+    throw std::runtime_error("yield outside of a generator");
+  }
+
   if (auto call = dynamic_cast<AST::CallNode *>(node)) {
     return ProcessingCallNode(call);
   }
@@ -122,63 +364,74 @@ Value Interpret::Eval(AST::BaseNode *node) {
 }
 
 Value Interpret::ProcessingCallNode(AST::CallNode *call) {
-  stack_.push_back(call->func);
-  auto funcVal = global_->LookUp(call->func);
-  std::vector<Value> args;
-  for (const auto &elem : call->args) {
-    args.push_back(Eval(elem.get()));
-  }
-  if (auto fn = std::get_if<std::function<Value(const std::vector<Value> &)>>(
-          &funcVal)) {
-    stack_.pop_back();
-    return (*fn)(args);
-  }
-  if (auto fn = std::get_if<std::shared_ptr<Function>>(&funcVal)) {
-    auto result = CallUserFunction(*fn, args);
-    stack_.pop_back();
-    return result;
-  }
+  CallFrameScope frame(*this, call);
+  ProfiledCall profiled(profiler_, call->func);
+  try {
+    auto funcVal = global_->LookUp(call->func);
+    std::vector<Value> args;
+    for (const auto &elem : call->args) {
+      args.push_back(Eval(elem.get()));
+    }
+    if (auto fn =
+            std::get_if<std::function<Value(const std::vector<Value> &)>>(
+                &funcVal)) {
+      AllocationScope scope(AllocKind::OTHER, BuiltinSite(call));
+      TraceScope traced(tracer_, Tracer::Category::BUILTIN, call->func);
+      return (*fn)(args);
+    }
+    if (auto fn = std::get_if<std::shared_ptr<Function>>(&funcVal)) {
+      return CallUserFunction(*fn, args);
+    }
 
-  throw std::runtime_error(call->func + " is not a function");
+    throw std::runtime_error(call->func + " is not a function");
+  } catch (const BreakException &) {
+    throw;
+  } catch (const ContinueException &) {
+    throw;
+  } catch (const ReturnException &) {
+    throw;
+  } catch (...) {
+    CaptureErrorStack();
+    throw;
+  }
 }
 
 Value Interpret::ProcessingBinOperationNode(AST::BinOperationNode *bin) {
   auto left = Eval(bin->left.get());
   auto right = Eval(bin->right.get());
-  if (auto l = std::get_if<std::string>(&left)) {
-    if (auto r = std::get_if<std::string>(&right)) {
-      return ProcessingString(bin, *l, *r);
+  AllocationScope scope(ResultKind(left));
+  if (std::holds_alternative<NumberArray>(left) ||
+      std::holds_alternative<NumberArray>(right)) {
+    return ProcessingArray(bin, left, right);
+  }
+  if (left.IsString() && right.IsString()) {
+    if (bin->operation.GetType() == TokenType::PLUS) {
+      return Value::Concat(left, right);
     }
+    return ProcessingString(bin, left.GetStringView(), right.GetStringView());
   }
 
-  if (auto l = std::get_if<double>(&left)) {
-    if (auto r = std::get_if<double>(&right)) {
-      return ProcessingNumber(bin, *l, *r);
-    }
+  if (left.IsNumber() && right.IsNumber()) {
+    return ProcessingNumber(bin, left, right);
   }
 
-  if (auto l = std::get_if<std::string>(&left)) {
-    if (auto r = std::get_if<double>(&right)) {
-      return ProcessingNumberString(bin, *l, *r);
-    }
+  if (left.IsString() && right.IsNumber()) {
+    return ProcessingNumberString(bin, left.GetStringView(),
+                                  right.GetNumber());
   }
 
-  if (auto l = std::get_if<std::string>(&left)) {
+  if (left.IsString()) {
     if (auto r = std::get_if<bool>(&right)) {
-      return ProcessingNumberString(bin, *l, *r);
+      return ProcessingNumberString(bin, left.GetStringView(), *r);
     }
   }
 
-  if (auto l = std::get_if<std::vector<Value>>(&left)) {
-    if (auto r = std::get_if<std::vector<Value>>(&right)) {
-      return ProcessingListList(bin, *l, *r);
-    }
+  if (left.IsList() && right.IsList()) {
+    return ProcessingListList(bin, left, right);
   }
 
-  if (auto l = std::get_if<std::vector<Value>>(&left)) {
-    if (auto r = std::get_if<double>(&right)) {
-      return ProcessingListNumber(bin, *l, *r);
-    }
+  if (left.IsList() && right.IsNumber()) {
+    return ProcessingListNumber(bin, left, right.GetNumber());
   }
 
   throw std::runtime_error("Unknown operation");
@@ -187,6 +440,9 @@ Value Interpret::ProcessingBinOperationNode(AST::BinOperationNode *bin) {
 Value Interpret::ProcessingBlockNode(AST::BlockNode *block) {
   Value last = nullptr;
   for (const auto &stmt : block->nodes) {
+    ProfiledLine profiled(line_profiler_, stmt.get());
+    AllocationScope scope(AllocKind::OTHER,
+                          MemoryStats::LineSite(stmt->span.begin.line));
     last = Eval(stmt.get());
   }
   return last;
@@ -217,65 +473,119 @@ Value Interpret::ProcessingIfNode(AST::IfNode *if_node) {
 
 Value Interpret::ProcessingWhileNode(AST::WhileNode *while_node) {
   while (std::get<bool>(Eval(while_node->conditional.get()))) {
+    Step();
     try {
       ProcessingBlockNode(while_node->then.get());
-    } catch (BreakException) {
+    } catch (const BreakException &) {
       break;
-    } catch (ContinueException) {
+    } catch (const ContinueException &) {
       continue;
     }
   }
   return nullptr;
 }
 
-Value Interpret::ProcessingNumber(AST::BinOperationNode *bin, double l,
-                                  double r) {
+Value Interpret::ProcessingForNode(AST::ForNode *for_node) {
+  Value iterable = Eval(for_node->conditional.get());
+  const std::string &var_name = for_node->iterator.GetValue();
+
+  auto run_body = [&](const Value &item) {
+    Step();
+    global_->Assign(var_name, item);
+    try {
+      Eval(for_node->then.get());
+    } catch (const ContinueException &) {
+    }
+  };
+
+  try {
+    if (iterable.IsList()) {
+      std::span<const Value> items = iterable.GetListView();
+      if (items.empty()) {
+        return Value();
+      }
+      // The loop variable is looked up once, and again only after a task
+      // spawned by the body froze it along with its scope.
+      global_->Assign(var_name, items.front());
+      Value *slot = global_->FindForWrite(var_name);
+      uint64_t freezes = Scope::Freezes();
+      for (const Value &item : items) {
+        Step();
+        if (Scope::Freezes() != freezes) {
+          slot = global_->FindForWrite(var_name);
+          freezes = Scope::Freezes();
+        }
+        *slot = item;
+        try {
+          Eval(for_node->then.get());
+        } catch (const ContinueException &) {
+        }
+      }
+    } else if (auto it = std::get_if<std::shared_ptr<Iterator>>(&iterable)) {
+      Value item;
+      while ((*it)->Next(item)) {
+        run_body(item);
+      }
+    } else if (auto array = std::get_if<NumberArray>(&iterable)) {
+      for (double item : array->View()) {
+        run_body(item);
+      }
+    } else if (auto dict = std::get_if<Dict>(&iterable)) {
+      // `iterable` keeps this table alive and unchanged: assignments in the
+      // body clone it before writing.
+      size_t position = 0;
+      while (const Value *key = dict->table->NextKey(position)) {
+        run_body(*key);
+      }
+    } else {
+      throw std::runtime_error("Error in for");
+    }
+  } catch (const BreakException &) {
+  }
+
+  return Value();
+}
+
+Value Interpret::ProcessingNumber(AST::BinOperationNode *bin, const Value &l,
+                                  const Value &r) {
   switch (bin->operation.GetType()) {
   case TokenType::PLUS:
-    return l + r;
   case TokenType::MINUS:
-    return l - r;
   case TokenType::MULTIPLY:
-    return l * r;
   case TokenType::POW:
-    return pow(l, r);
   case TokenType::MOD:
-    return std::fmod(l, r);
   case TokenType::DIVIDE:
-    if (r == 0)
-      throw std::runtime_error("Division by 0");
-    return l / r;
+    return NumberArithmetic(bin->operation.GetType(), l, r);
   case TokenType::EQ:
-    return (l == r);
+    return CompareNumbers(l, r) == 0;
   case TokenType::N_EQ:
-    return (l != r);
+    return CompareNumbers(l, r) != 0;
   case TokenType::GREATER:
-    return (l > r);
+    return CompareNumbers(l, r) > 0;
   case TokenType::LESS:
-    return (l < r);
+    return CompareNumbers(l, r) < 0;
   case TokenType::GREATER_EQ:
-    return (l >= r);
+    return CompareNumbers(l, r) >= 0;
   case TokenType::LESS_EQ:
-    return (l <= r);
+    return CompareNumbers(l, r) <= 0;
   default:
     throw std::runtime_error("Unknown operator");
   }
 }
 
-Value Interpret::ProcessingString(AST::BinOperationNode *bin, std::string l,
-                                  std::string r) {
+Value Interpret::ProcessingString(AST::BinOperationNode *bin,
+                                  std::string_view l, std::string_view r) {
   switch (bin->operation.GetType()) {
-  case TokenType::PLUS:
-    return l + r;
   case TokenType::MINUS:
-    if ((l.length() >= r.length()) &&
-        (l.substr(l.length() - r.length(), r.length()) == r)) {
-      return l.substr(0, l.length() - r.length());
+    if (l.ends_with(r)) {
+      return std::string(l.substr(0, l.length() - r.length()));
     } else {
       throw std::runtime_error("Left string is not a substring of the right");
     }
   case TokenType::EQ:
     return (l == r);
+  case TokenType::N_EQ:
+    return (l != r);
   case TokenType::GREATER:
     return (l > r);
   case TokenType::LESS:
@@ -290,7 +600,7 @@ Value Interpret::ProcessingString(AST::BinOperationNode *bin, std::string l,
 }
 
 Value Interpret::ProcessingNumberString(AST::BinOperationNode *bin,
-                                        std::string l, double r) {
+                                        std::string_view l, double r) {
   switch (bin->operation.GetType()) {
   case TokenType::MULTIPLY: {
     if (r < 0) {
@@ -300,6 +610,7 @@ Value Interpret::ProcessingNumberString(AST::BinOperationNode *bin,
     int full = static_cast<int>(r);
     double frac = r - full;
     std::string res = "";
+    res.reserve(static_cast<size_t>(r * l.length()) + 1);
     for (int i = 0; i < full; ++i) {
       res += l;
     }
@@ -317,102 +628,54 @@ Value Interpret::ProcessingIndexNode(AST::IndexNode *index_node) {
   Value index = Eval(index_node->index.get());
   Value object = Eval(index_node->object.get());
 
-  if (!std::holds_alternative<double>(index)) {
-    throw std::runtime_error("Index must be a number");
+  if (auto dict = std::get_if<Dict>(&object)) {
+    const Value *value = dict->table->Find(index);
+    if (value == nullptr) {
+      throw std::runtime_error("Key is not in the dict");
+    }
+    return *value;
   }
 
-  double dindex = std::get<double>(index);
-  int iindex = static_cast<int>(dindex);
-
-  if (dindex != iindex) {
-    throw std::runtime_error("Index must be a number");
+  if (object.IsString()) {
+    std::string_view s = object.GetStringView();
+    return Value(std::string(1, s[CheckedIndex(index, s.size())]));
   }
 
-  if (std::holds_alternative<std::string>(object)) {
-    std::string s = std::get<std::string>(object);
-
-    if (iindex < 0 || iindex >= static_cast<int>(s.size())) {
-      throw std::runtime_error("Index is out of range");
-    }
-
-    return Value(std::string(1, s[iindex]));
+  if (object.IsList()) {
+    std::span<const Value> v = object.GetListView();
+    return v[CheckedIndex(index, v.size())];
   }
 
-  if (std::holds_alternative<std::vector<Value>>(object)) {
-    std::vector<Value> v = std::get<std::vector<Value>>(object);
-
-    if (iindex < 0 || iindex >= static_cast<int>(v.size())) {
-      throw std::runtime_error("Index is out of range");
-    }
-
-    return v[iindex];
+  if (auto array = std::get_if<NumberArray>(&object)) {
+    return array->View()[CheckedIndex(index, array->size)];
   }
 
+  int64_t unused;
+  if (!GetInteger(index, unused)) {
+    throw std::runtime_error("Index must be a number");
+  }
   return nullptr;
 }
 
 Value Interpret::ProcessingSliceNode(AST::SliceNode *slice_node) {
   Value start = Eval(slice_node->start.get());
   Value end = Eval(slice_node->end.get());
-  if (std::holds_alternative<nullptr_t>(start)) {
-    start = double(0);
-  }
   Value object = Eval(slice_node->object.get());
-  if (std::holds_alternative<std::string>(object)) {
-    if (std::holds_alternative<nullptr_t>(end)) {
-      end = double(std::get<std::string>(object).length());
-    }
-    if (!std::holds_alternative<double>(start)) {
-      throw std::runtime_error("Index must be an integer number");
-    }
-    if (!std::holds_alternative<double>(end)) {
-      throw std::runtime_error("Index must be an integer number");
-    }
-    double dstart = std::get<double>(start);
-    double dend = std::get<double>(end);
-    int istart = static_cast<int>(dstart);
-    int iend = static_cast<int>(dend);
-    if (dstart != istart || dend != iend) {
-      throw std::runtime_error("Index must be an integer number");
-    }
-    std::string s = std::get<std::string>(object);
-
-    if (istart < 0 || iend <= istart || iend > static_cast<int>(s.length())) {
-      throw std::runtime_error("Index is out of range");
-    }
 
-    return Value(s.substr(istart, iend - istart + 1));
+  if (object.IsString()) {
+    auto [first, last] =
+        SliceBounds(start, end, object.GetStringView().length());
+    return object.Slice(first, last - first);
   }
 
-  if (std::holds_alternative<std::vector<Value>>(object)) {
-    if (std::holds_alternative<nullptr_t>(end)) {
-      end = double(std::get<std::vector<Value>>(object).size());
-    }
-    if (!std::holds_alternative<double>(start)) {
-      throw std::runtime_error("Index must be an integer number");
-    }
-    if (!std::holds_alternative<double>(end)) {
-      throw std::runtime_error("Index must be an integer number");
-    }
-    double dstart = std::get<double>(start);
-    double dend = std::get<double>(end);
-    int istart = static_cast<int>(dstart);
-    int iend = static_cast<int>(dend);
-    if (dstart != istart || dend != iend) {
-      throw std::runtime_error("Index must be a number");
-    }
-    std::vector<Value> v = std::get<std::vector<Value>>(object);
-
-    if (istart < 0 || iend <= istart || iend > static_cast<int>(v.size())) {
-      throw std::runtime_error("Index is out of range");
-    }
-
-    std::vector<Value> res;
-    for (int i = istart; i < iend; ++i) {
-      res.push_back(v[i]);
-    }
+  if (object.IsList()) {
+    auto [first, last] = SliceBounds(start, end, object.GetListView().size());
+    return object.Slice(first, last - first);
+  }
 
-    return Value(res);
+  if (auto array = std::get_if<NumberArray>(&object)) {
+    auto [first, last] = SliceBounds(start, end, array->size);
+    return array->Slice(first, last - first);
   }
   return nullptr;
 }
@@ -430,89 +693,110 @@ Value Interpret::ParseAssignmentNode(AST::AssignmentNode *assignment_node) {
 
     return val;
   }
-  case TokenType::PLUS_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(), val + current);
-    return val;
-  }
-  case TokenType::MINUS_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(), current - val);
-    return val;
-  }
-  case TokenType::DIVIDE_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(), current / val);
-    return val;
-  }
-  case TokenType::MULTIPLY_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(), val * current);
-    return val;
+  default: {
+    Value value = Eval(assignment_node->value.get());
+    Value *current =
+        global_->FindForWrite(assignment_node->variable.GetValue());
+    *current = ApplyAssignment(assignment_node->operation.GetType(), *current,
+                               value);
+    return value;
   }
-  case TokenType::POW_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(), pow(current, val));
-    return val;
   }
-  case TokenType::MOD_A: {
-    double val = std::get<double>(Eval(assignment_node->value.get()));
-    double current =
-        std::get<double>(global_->LookUp(assignment_node->variable.GetValue()));
-    global_->Assign(assignment_node->variable.GetValue(),
-                    std::fmod(current, val));
-    return val;
+  return nullptr;
+}
+
+Value Interpret::ProcessingIndexAssignmentNode(
+    AST::IndexAssignmentNode *assignment_node) {
+  Value value = Eval(assignment_node->value.get());
+  std::vector<Value> indices;
+  for (const auto &index : assignment_node->indices) {
+    indices.push_back(Eval(index.get()));
   }
+
+  TokenType op = assignment_node->operation.GetType();
+  Value *element =
+      global_->FindForWrite(assignment_node->variable.GetValue());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    bool last = i + 1 == indices.size();
+    element = &ElementForWrite(*element, indices[i],
+                               last && op == TokenType::ASSIGN);
   }
-  return nullptr;
+  *element = ApplyAssignment(op, *element, value);
+
+  return value;
 }
 
-void Interpret::Print(const Value &v, std::ostream &output) {
+void Interpret::Print(const Value &v, OutputSink &output) {
   if (auto d = std::get_if<double>(&v)) {
-    output << *d;
-  } else if (auto s = std::get_if<std::string>(&v)) {
-    output << *s;
+    char buf[kMaxNumberLength];
+    output.Write(std::string_view(buf, FormatNumber(*d, buf)));
+  } else if (auto i = std::get_if<int64_t>(&v)) {
+    char buf[kMaxNumberLength];
+    output.Write(std::string_view(buf, FormatNumber(*i, buf)));
+  } else if (v.IsString()) {
+    output.Write(v.GetStringView());
   } else if (auto b = std::get_if<bool>(&v)) {
-    output << (*b ? "true" : "false");
+    output.Write(*b ? "true" : "false");
   } else if (std::get_if<std::nullptr_t>(&v)) {
-    output << "nil";
-  } else if (auto vec = std::get_if<std::vector<Value>>(&v)) {
-    output << "[";
-    for (int i = 0; i < (*vec).size(); ++i) {
-      Print((*vec)[i], output);
-      if (i != (*vec).size() - 1) {
-        output << ", ";
+    output.Write("nil");
+  } else if (v.IsList()) {
+    std::span<const Value> vec = v.GetListView();
+    output.Write("[");
+    for (int i = 0; i < vec.size(); ++i) {
+      Print(vec[i], output);
+      if (i != vec.size() - 1) {
+        output.Write(", ");
+      }
+    }
+    output.Write("]");
+  } else if (auto dict = std::get_if<Dict>(&v)) {
+    bool first = true;
+    output.Write("{");
+    dict->table->ForEach([&](const Value &key, const Value &value) {
+      if (!first) {
+        output.Write(", ");
+      }
+      first = false;
+      Print(key, output);
+      output.Write(": ");
+      Print(value, output);
+    });
+    output.Write("}");
+  } else if (std::get_if<std::shared_ptr<Iterator>>(&v)) {
+    output.Write("<iterator>");
+  } else if (std::get_if<std::shared_ptr<Task>>(&v)) {
+    output.Write("<task>");
+  } else if (auto array = std::get_if<NumberArray>(&v)) {
+    std::span<const double> values = array->View();
+    char buf[kMaxNumberLength];
+    output.Write("[");
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i != 0) {
+        output.Write(", ");
       }
+      output.Write(std::string_view(buf, FormatNumber(values[i], buf)));
     }
-    output << "]";
+    output.Write("]");
   }
 }
 
 Value Interpret::ProcessingListList(AST::BinOperationNode *bin,
-                                    std::vector<Value> &l,
-                                    std::vector<Value> &r) {
+                                    const Value &left, const Value &right) {
+  std::span<const Value> l = left.GetListView();
+  std::span<const Value> r = right.GetListView();
   switch (bin->operation.GetType()) {
   case TokenType::PLUS: {
     std::vector<Value> res;
-    for (int i = 0; i < l.size(); ++i) {
-      res.push_back(l[i]);
-    }
-
-    for (int i = 0; i < r.size(); ++i) {
-      res.push_back(r[i]);
-    }
-
-    return Value(res);
+    res.reserve(l.size() + r.size());
+    res.insert(res.end(), l.begin(), l.end());
+    res.insert(res.end(), r.begin(), r.end());
+
+    ElementKind kind = l.empty()   ? right.ListKind()
+                       : r.empty() ? left.ListKind()
+                       : left.ListKind() == right.ListKind()
+                           ? left.ListKind()
+                           : ElementKind::MIXED;
+    return Value::MakeList(std::move(res), kind);
   }
   default:
     throw std::runtime_error("Unknown operation");
@@ -520,7 +804,8 @@ Value Interpret::ProcessingListList(AST::BinOperationNode *bin,
 }
 
 Value Interpret::ProcessingListNumber(AST::BinOperationNode *bin,
-                                      std::vector<Value> &l, double r) {
+                                      const Value &left, double r) {
+  std::span<const Value> l = left.GetListView();
   switch (bin->operation.GetType()) {
   case TokenType::MULTIPLY: {
     std::vector<Value> res;
@@ -536,22 +821,154 @@ Value Interpret::ProcessingListNumber(AST::BinOperationNode *bin,
       res.push_back(l[i]);
     }
 
-    return Value(res);
+    return Value::MakeList(std::move(res), left.ListKind());
   }
   default:
     throw std::runtime_error("Unknown operation");
   }
 }
 
+Value Interpret::ProcessingArray(AST::BinOperationNode *bin, const Value &l,
+                                 const Value &r) {
+  ArrayOp op;
+  switch (bin->operation.GetType()) {
+  case TokenType::PLUS:
+    op = ArrayOp::ADD;
+    break;
+  case TokenType::MINUS:
+    op = ArrayOp::SUB;
+    break;
+  case TokenType::MULTIPLY:
+    op = ArrayOp::MUL;
+    break;
+  case TokenType::DIVIDE:
+    op = ArrayOp::DIV;
+    break;
+  case TokenType::POW:
+    op = ArrayOp::POW;
+    break;
+  default:
+    throw std::runtime_error("Unknown operation");
+  }
+
+  auto l_array = std::get_if<NumberArray>(&l);
+  auto r_array = std::get_if<NumberArray>(&r);
+  std::optional<double> l_number, r_number;
+  if (l.IsNumber()) {
+    l_number = l.GetNumber();
+  }
+  if (r.IsNumber()) {
+    r_number = r.GetNumber();
+  }
+  if (op == ArrayOp::DIV &&
+      ((r_number && *r_number == 0) ||
+       (r_array && ContainsZero(r_array->View())))) {
+    throw std::runtime_error("Division by 0");
+  }
+
+  double *out;
+  if (l_array && r_array) {
+    if (l_array->size != r_array->size) {
+      throw std::runtime_error("Arrays must have the same size");
+    }
+    NumberArray result = NumberArray::Allocate(l_array->size, out);
+    ApplyArrayOp(op, l_array->data.get(), r_array->data.get(), out,
+                 result.size);
+    return result;
+  }
+  if (l_array && r_number) {
+    NumberArray result = NumberArray::Allocate(l_array->size, out);
+    ApplyArrayOp(op, l_array->data.get(), *r_number, out, result.size);
+    return result;
+  }
+  if (l_number && r_array) {
+    NumberArray result = NumberArray::Allocate(r_array->size, out);
+    ApplyArrayOp(op, *l_number, r_array->data.get(), out, result.size);
+    return result;
+  }
+  throw std::runtime_error("Unknown operation");
+}
+
 std::vector<std::string> Interpret::GetStackTrace() {
-  if (current_ == nullptr)
+  if (current_ == nullptr || current_->depth_ == 0) {
     return {};
-  return current_->stack_;
+  }
+  return FrameNames(current_->frames_.get(), current_->depth_ - 1);
+}
+
+std::vector<std::string>
+Interpret::FrameNames(const CallFrame *frames, size_t depth,
+                      const std::vector<std::string> *unnamed) {
+  std::vector<std::string> names;
+  names.reserve(std::min(depth, kMaxFrames) + 1);
+  size_t next_unnamed = 0;
+  for (size_t i = 0; i < std::min(depth, kMaxFrames); ++i) {
+    if (frames[i].function != NameTable::kUnnamed) {
+      names.push_back(NameTable::Name(frames[i].function));
+    } else if (unnamed != nullptr) {
+      names.push_back((*unnamed)[next_unnamed++]);
+    } else {
+      names.push_back(frames[i].call->func);
+    }
+  }
+  if (depth > kMaxFrames) {
+    names.push_back("... " + std::to_string(depth - kMaxFrames) +
+                    " more frames");
+  }
+  return names;
+}
+
+void Interpret::CaptureErrorStack() {
+  if (error_captured_) {
+    return;
+  }
+  error_captured_ = true;
+  error_depth_ = depth_;
+  error_frames_.assign(frames_.get(),
+                       frames_.get() + std::min(depth_, kMaxFrames));
+  error_unnamed_.clear();
+  for (const CallFrame &frame : error_frames_) {
+    if (frame.function == NameTable::kUnnamed) {
+      error_unnamed_.push_back(frame.call->func);
+    }
+  }
+}
+
+Value Interpret::CallFunction(const Value &func,
+                               const std::vector<Value> &args) {
+  if (auto fn = std::get_if<std::function<Value(const std::vector<Value> &)>>(
+          &func)) {
+    return (*fn)(args);
+  }
+  if (auto fn = std::get_if<std::shared_ptr<Function>>(&func)) {
+    if (current_ == nullptr) {
+      throw std::runtime_error("No script is running");
+    }
+    return current_->CallUserFunction(*fn, args);
+  }
+  throw std::runtime_error("Argument must be a function");
 }
 
-std::vector<std::string> Interpret::GetStack() { return stack_; }
+std::vector<std::string> Interpret::GetStack() {
+  if (error_captured_) {
+    return FrameNames(error_frames_.data(), error_depth_, &error_unnamed_);
+  }
+  return FrameNames(frames_.get(), depth_);
+}
+
+std::vector<uint32_t> Interpret::GetStackLines() {
+  const CallFrame *frames = error_captured_ ? error_frames_.data()
+                                            : frames_.get();
+  size_t depth = error_captured_ ? error_depth_ : depth_;
+  std::vector<uint32_t> lines;
+  for (size_t i = 0; i < std::min(depth, kMaxFrames); ++i) {
+    lines.push_back(frames[i].line);
+  }
+  return lines;
+}
 
 Value Interpret::ProcessingFunctionNode(AST::FunctionNode *func) {
+  AllocationScope scope(AllocKind::FUNCTION);
   Function function;
   function.closure = global_;
   function.args.reserve(func->args.size());
@@ -563,7 +980,8 @@ Value Interpret::ProcessingFunctionNode(AST::FunctionNode *func) {
     }
   }
 
-  function.body = std::make_unique<AST::BlockNode>(std::move(*(func->then)));
+  function.body = func->then;
+  function.generator = func->generator;
 
   return Value(std::make_shared<Function>(std::move(function)));
 }
@@ -573,10 +991,23 @@ Value Interpret::CallUserFunction(std::shared_ptr<Function> func,
   if (args.size() != func->args.size()) {
     throw std::runtime_error("Error in number of arguments");
   }
+  Step();
+  TraceScope traced(tracer_, Tracer::Category::FUNCTION,
+                    func->name.empty() ? std::string_view("<anonymous>")
+                                       : std::string_view(func->name));
+
+  std::shared_ptr<Scope> local;
+  {
+    AllocationScope scope(AllocKind::SCOPE);
+    local = std::make_shared<Scope>(func->closure);
+    for (size_t i = 0; i < args.size(); ++i) {
+      local->Define(func->args[i], args[i]);
+    }
+  }
 
-  auto local = std::make_shared<Scope>(func->closure);
-  for (size_t i = 0; i < args.size(); ++i) {
-    local->Assign(func->args[i], args[i]);
+  if (func->generator) {
+    return Value(std::shared_ptr<Iterator>(
+        std::make_shared<Generator>(std::move(func), std::move(local))));
   }
 
   auto old_env = global_;
@@ -593,21 +1024,165 @@ Value Interpret::CallUserFunction(std::shared_ptr<Function> func,
   return result;
 }
 
-bool interpret(std::istream &input, std::ostream &output) {
-  try {
-    Lexer lexer(input);
-    auto tokens = lexer.GetTokens();
+void Interpret::TrackTask(std::shared_ptr<Task> task) {
+  if (current_ == nullptr) {
+    return;
+  }
+  std::vector<std::shared_ptr<Task>> &spawned = current_->spawned_;
+  if (spawned.size() >= current_->prune_spawned_at_) {
+    std::erase_if(spawned, [](const std::shared_ptr<Task> &t) {
+      return t->Done() && t->Observed();
+    });
+    current_->prune_spawned_at_ = std::max<size_t>(64, spawned.size() * 2);
+  }
+  spawned.push_back(std::move(task));
+}
+
+void Interpret::JoinTasks() {
+  std::exception_ptr error;
+  for (const std::shared_ptr<Task> &task : spawned_) {
+    std::exception_ptr task_error = task->UnobservedError();
+    out_.Write(task->TakeOutput());
+    if (task_error && !error) {
+      error = task_error;
+    }
+  }
+  spawned_.clear();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool Interpret::Resume(Generator &generator, Value &out) {
+  if (current_ == nullptr) {
+    throw std::runtime_error("No script is running");
+  }
+  return current_->ResumeGenerator(generator, out);
+}
+
+// Drops the frames above the innermost loop, and the loop itself unless
+// `keep_loop` is set (continue).
+void Interpret::PopToLoop(std::vector<Generator::Frame> &frames,
+                          bool keep_loop) {
+  while (!frames.empty() &&
+         frames.back().kind == Generator::FrameKind::BLOCK) {
+    frames.pop_back();
+  }
+  if (!frames.empty() && !keep_loop) {
+    frames.pop_back();
+  }
+}
+
+bool Interpret::ResumeGenerator(Generator &generator, Value &out) {
+  using Kind = Generator::FrameKind;
+  std::vector<Generator::Frame> &frames = generator.frames_;
+
+  EnteredScope entered(global_, generator.scope_);
+
+  while (!frames.empty()) {
+    Generator::Frame &frame = frames.back();
+
+    if (frame.kind == Kind::WHILE) {
+      auto while_node = static_cast<AST::WhileNode *>(frame.node);
+      if (std::get<bool>(Eval(while_node->conditional.get()))) {
+        Step();
+        frames.push_back({Kind::BLOCK, while_node->then.get()});
+      } else {
+        frames.pop_back();
+      }
+      continue;
+    }
 
-    Parser parser(tokens);
+    if (frame.kind == Kind::FOR) {
+      auto for_node = static_cast<AST::ForNode *>(frame.node);
+      Value item;
+      bool has_item = false;
+      if (frame.iterable.IsList()) {
+        std::span<const Value> list = frame.iterable.GetListView();
+        if (frame.position < list.size()) {
+          item = list[frame.position++];
+          has_item = true;
+        }
+      } else if (auto array = std::get_if<NumberArray>(&frame.iterable)) {
+        if (frame.position < array->size) {
+          item = array->View()[frame.position++];
+          has_item = true;
+        }
+      } else if (auto dict = std::get_if<Dict>(&frame.iterable)) {
+        if (const Value *key = dict->table->NextKey(frame.position)) {
+          item = *key;
+          has_item = true;
+        }
+      } else {
+        has_item =
+            std::get<std::shared_ptr<Iterator>>(frame.iterable)->Next(item);
+      }
+      if (has_item) {
+        Step();
+        global_->Assign(for_node->iterator.GetValue(), item);
+        frames.push_back({Kind::BLOCK, for_node->then.get()});
+      } else {
+        frames.pop_back();
+      }
+      continue;
+    }
 
-    auto global = std::make_shared<Scope>();
-    AddSystemFunction(global, output);
+    auto block = static_cast<AST::BlockNode *>(frame.node);
+    if (frame.position == block->nodes.size()) {
+      frames.pop_back();
+      continue;
+    }
+    AST::BaseNode *stmt = block->nodes[frame.position++].get();
+    ProfiledLine profiled(line_profiler_, stmt);
+    AllocationScope scope(AllocKind::OTHER,
+                          MemoryStats::LineSite(stmt->span.begin.line));
+
+    if (auto yield_node = dynamic_cast<AST::YieldNode *>(stmt)) {
+      out = Eval(yield_node->value.get());
+      return true;
+    }
 
-    Interpret interpreter(parser.ParseCode(), global, output);
-    interpreter.Run();
-  } catch (const std::exception &e) {
-    output << e.what() << std::endl;
-    return false;
+    if (auto if_node = dynamic_cast<AST::IfNode *>(stmt)) {
+      AST::BlockNode *branch = nullptr;
+      if (std::get<bool>(Eval(if_node->conditional.get()))) {
+        branch = if_node->then.get();
+      } else {
+        for (auto &[cond, then] : if_node->else_if) {
+          if (std::get<bool>(Eval(cond.get()))) {
+            branch = then.get();
+            break;
+          }
+        }
+        if (branch == nullptr) {
+          branch = if_node->eelse.get();
+        }
+      }
+      if (branch != nullptr) {
+        frames.push_back({Kind::BLOCK, branch});
+      }
+    } else if (auto while_node = dynamic_cast<AST::WhileNode *>(stmt)) {
+      frames.push_back({Kind::WHILE, while_node});
+    } else if (auto for_node = dynamic_cast<AST::ForNode *>(stmt)) {
+      Value iterable = Eval(for_node->conditional.get());
+      if (!iterable.IsList() &&
+          !std::holds_alternative<std::shared_ptr<Iterator>>(iterable) &&
+          !std::holds_alternative<NumberArray>(iterable) &&
+          !std::holds_alternative<Dict>(iterable)) {
+        throw std::runtime_error("Error in for");
+      }
+      frames.push_back({Kind::FOR, for_node, 0, std::move(iterable)});
+    } else if (dynamic_cast<AST::BreakNode *>(stmt)) {
+      PopToLoop(frames, false);
+    } else if (dynamic_cast<AST::ContinueNode *>(stmt)) {
+      PopToLoop(frames, true);
+    } else if (auto return_node = dynamic_cast<AST::ReturnNode *>(stmt)) {
+      if (return_node->value) {
+        Eval(return_node->value.get());
+      }
+      frames.clear();
+    } else {
+      Eval(stmt);
+    }
   }
-  return true;
-}
\ No newline at end of file
+  return false;
+}
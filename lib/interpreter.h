@@ -1,17 +1,29 @@
 #pragma once
 
+#include "array_kernels.h"
 #include "ast.h"
+#include "execution_limits.h"
 #include "function.h"
+#include "generator.h"
+#include "input_source.h"
 #include "lexer.h"
+#include "line_profiler.h"
+#include "memory_stats.h"
+#include "output_sink.h"
 #include "parser.h"
+#include "profiler.h"
+#include "program_cache.h"
 #include "scope.h"
 #include "standart_library_func.h"
+#include "task.h"
+#include "tracer.h"
 #include "value.h"
 #include <cmath>
 #include <fstream>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <string>
@@ -19,22 +31,117 @@
 
 class Interpret {
 public:
-  Interpret(std::unique_ptr<AST::BlockNode> root, std::shared_ptr<Scope> global,
-            std::ostream &out)
-      : root_(std::move(root)), global_(std::move(global)), out_(out) {}
+  Interpret(std::shared_ptr<AST::BlockNode> root, std::shared_ptr<Scope> global,
+            OutputSink &out)
+      : root_(std::move(root)), global_(std::move(global)), out_(out),
+        frames_(std::make_unique_for_overwrite<CallFrame[]>(kMaxFrames)) {}
 
+  // Functions of the calls in progress, outermost first. After an error,
+  // the calls that were in progress where it was raised.
   std::vector<std::string> GetStack();
-  static void Print(const Value &v, std::ostream &output);
+  // Lines of the call sites of GetStack().
+  std::vector<uint32_t> GetStackLines();
+  // Reports the calls of this interpreter to `profiler`; nullptr disables
+  // profiling.
+  void SetProfiler(Profiler *profiler) { profiler_ = profiler; }
+  // Reports every statement this interpreter runs to `profiler`; nullptr
+  // disables line profiling.
+  void SetLineProfiler(LineProfiler *profiler) { line_profiler_ = profiler; }
+  // Records the user function and builtin calls of this interpreter in
+  // `tracer`; nullptr disables tracing.
+  void SetTracer(Tracer *tracer) { tracer_ = tracer; }
+  // Counts the loop iterations and calls of this interpreter against
+  // `budget`; nullptr runs without limits.
+  void SetBudget(ExecutionBudget *budget) {
+    budget_ = budget;
+    budget_countdown_ = budget_period_ = 1;
+  }
+  // Budget of the interpreter running on this thread, for the workers it
+  // starts; nullptr when there is none.
+  static ExecutionBudget *CurrentBudget();
+  static void Print(const Value &v, OutputSink &output);
+  // Call stack of the script running on this thread, for the stacktrace()
+  // builtin: the frame of the builtin itself is left out.
   static std::vector<std::string> GetStackTrace();
 
+  // Calls a builtin or user function value on behalf of a builtin such as
+  // sort. User functions run in the interpreter executing the script.
+  static Value CallFunction(const Value &func, const std::vector<Value> &args);
+
+  // Calls a function value with this interpreter as the current one of the
+  // calling thread. Worker threads of parallel builtins each use their own
+  // interpreter, so their call stacks and output stay separate.
+  Value Call(const Value &func, const std::vector<Value> &args);
+
+  // Output of the interpreter running on this thread, or `fallback`.
+  static OutputSink &CurrentOutput(OutputSink &fallback);
+
+  // Runs `generator` in the interpreter of this thread until it yields a
+  // value into `out` (true) or finishes (false).
+  static bool Resume(Generator &generator, Value &out);
+
+  // Records a task spawned by the interpreter of this thread, which is
+  // then responsible for joining it.
+  static void TrackTask(std::shared_ptr<Task> task);
+
+  // Waits for the spawned tasks that nobody awaited, writes their output
+  // in spawn order and rethrows the first of their errors.
+  void JoinTasks();
+
   void Run();
 
 private:
-  std::unique_ptr<AST::BlockNode> root_;
-  std::ostream &out_;
+  std::shared_ptr<AST::BlockNode> root_;
+  OutputSink &out_;
   std::shared_ptr<Scope> global_;
-  static Interpret *current_;
-  std::vector<std::string> stack_;
+  static thread_local Interpret *current_;
+
+  // A call in progress, from the call node to its return.
+  struct CallFrame {
+    const AST::CallNode *call;
+    // Name of the called function in the NameTable.
+    uint32_t function;
+    uint32_t line;
+  };
+  class CallFrameScope;
+
+  // Frames deeper than this are counted but not recorded.
+  static constexpr size_t kMaxFrames = 1024;
+  std::unique_ptr<CallFrame[]> frames_;
+  size_t depth_ = 0;
+  // Copy of the frames at the point where the error being propagated was
+  // raised, taken by the innermost call it leaves.
+  std::vector<CallFrame> error_frames_;
+  // Names of the captured frames without a NameTable id, in order; their
+  // call nodes may be gone by the time the names are asked for.
+  std::vector<std::string> error_unnamed_;
+  size_t error_depth_ = 0;
+  bool error_captured_ = false;
+  Profiler *profiler_ = nullptr;
+  LineProfiler *line_profiler_ = nullptr;
+  Tracer *tracer_ = nullptr;
+  ExecutionBudget *budget_ = nullptr;
+  // Steps left until the next check of budget_, and steps since the last.
+  uint64_t budget_countdown_ = 0;
+  uint64_t budget_period_ = 0;
+  std::vector<std::shared_ptr<Task>> spawned_;
+  // spawned_ is cleared of awaited tasks when it grows to this size.
+  size_t prune_spawned_at_ = 64;
+
+  // Counts a loop iteration or call against the budget, if there is one.
+  void Step() {
+    if (budget_ != nullptr && --budget_countdown_ == 0) {
+      CheckBudget();
+    }
+  }
+  void CheckBudget();
+
+  void CaptureErrorStack();
+  // `unnamed` replaces the names of frames without an id; without it they
+  // are read from the call nodes, which must still exist.
+  static std::vector<std::string>
+  FrameNames(const CallFrame *frames, size_t depth,
+             const std::vector<std::string> *unnamed = nullptr);
 
   Value Eval(AST::BaseNode *node);
   Value ProcessingCallNode(AST::CallNode *call);
@@ -42,21 +149,29 @@ private:
   Value ProcessingBlockNode(AST::BlockNode *block);
   Value ProcessingIfNode(AST::IfNode *if_node);
   Value ProcessingWhileNode(AST::WhileNode *while_node);
-  Value ProcessingNumber(AST::BinOperationNode *bin, double l, double r);
-  Value ProcessingString(AST::BinOperationNode *bin, std::string l,
-                         std::string r);
-  Value ProcessingNumberString(AST::BinOperationNode *bin, std::string l,
+  Value ProcessingForNode(AST::ForNode *for_node);
+  Value ProcessingNumber(AST::BinOperationNode *bin, const Value &l,
+                         const Value &r);
+  Value ProcessingString(AST::BinOperationNode *bin, std::string_view l,
+                         std::string_view r);
+  Value ProcessingNumberString(AST::BinOperationNode *bin, std::string_view l,
                                double r);
-  Value ProcessingListList(AST::BinOperationNode *bin, std::vector<Value> &l,
-                           std::vector<Value> &r);
-  Value ProcessingListNumber(AST::BinOperationNode *bin, std::vector<Value> &l,
+  Value ProcessingListList(AST::BinOperationNode *bin, const Value &l,
+                           const Value &r);
+  Value ProcessingListNumber(AST::BinOperationNode *bin, const Value &l,
                              double r);
+  Value ProcessingArray(AST::BinOperationNode *bin, const Value &l,
+                        const Value &r);
   Value ProcessingIndexNode(AST::IndexNode *index_node);
   Value ProcessingSliceNode(AST::SliceNode *slice_node);
   Value ParseAssignmentNode(AST::AssignmentNode *assignment_node);
+  Value ProcessingIndexAssignmentNode(
+      AST::IndexAssignmentNode *assignment_node);
   Value ProcessingFunctionNode(AST::FunctionNode *func);
   Value CallUserFunction(std::shared_ptr<Function> func,
                          const std::vector<Value> &args);
+  bool ResumeGenerator(Generator &generator, Value &out);
+  void PopToLoop(std::vector<Generator::Frame> &frames, bool keep_loop);
 };
 
 struct BreakException : std::exception {};
@@ -66,4 +181,28 @@ struct ReturnException : std::exception {
   ReturnException(Value value_) : value(value_) {}
 };
 
-bool interpret(std::istream &input, std::ostream &output);
+struct InterpretOptions {
+  // Directory for the on-disk program cache; empty disables it. Parsed
+  // programs are cached in memory regardless.
+  std::string cache_dir;
+  // Where read(), read_all() and read_lines() take their input from;
+  // nullptr means the process standard input, which every isolate without
+  // a source of its own shares.
+  InputSource *input = nullptr;
+  // Samples the script's call stack when set; see Profiler.
+  Profiler *profiler = nullptr;
+  // Counts and times every line of the script when set; see LineProfiler.
+  LineProfiler *line_profiler = nullptr;
+  // Records the phases and calls of the run when set; see Tracer.
+  Tracer *tracer = nullptr;
+  // Step, time and cancellation limits of the run; see ExecutionLimits.
+  ExecutionLimits limits;
+  // Set to the reason when the run was stopped by one of the limits, and
+  // to StopReason::NONE otherwise.
+  StopReason *stop_reason = nullptr;
+};
+
+bool interpret(std::istream &input, OutputSink &output,
+               const InterpretOptions &options = {});
+bool interpret(std::istream &input, std::ostream &output,
+               const InterpretOptions &options = {});
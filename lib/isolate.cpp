@@ -0,0 +1,98 @@
+#include "isolate.h"
+
+#include <optional>
+
+std::shared_ptr<const Program> Program::Compile(const std::string &source,
+                                                const std::string &cache_dir,
+                                                Tracer *tracer) {
+  return std::shared_ptr<const Program>(
+      new Program(ProgramCache::Global().Load(source, cache_dir, tracer)));
+}
+
+Isolate::Isolate(OutputSink &output, const IsolateOptions &options)
+    : output_(output), profiler_(options.profiler),
+      line_profiler_(options.line_profiler), tracer_(options.tracer),
+      limits_(options.limits) {
+  // Builtins live in a scope of their own below the globals, which tasks
+  // share instead of copying.
+  auto builtins = std::make_shared<Scope>();
+  AddSystemFunction(builtins, output_,
+                    options.input ? *options.input : InputSource::Stdin());
+  builtins->immutable = true;
+  global_ = std::make_shared<Scope>(std::move(builtins));
+}
+
+bool Isolate::Run(const Program &program) {
+  error_.clear();
+  stack_trace_.clear();
+  stack_lines_.clear();
+  stopped_ = StopReason::NONE;
+
+  Interpret interpreter(program.Root(), global_, output_);
+  interpreter.SetProfiler(profiler_);
+  interpreter.SetLineProfiler(line_profiler_);
+  interpreter.SetTracer(tracer_);
+  std::optional<ExecutionBudget> budget;
+  if (limits_.Limited()) {
+    interpreter.SetBudget(&budget.emplace(limits_));
+  }
+  try {
+    TraceScope traced(tracer_, Tracer::Category::PHASE, "execute");
+    interpreter.Run();
+  } catch (const std::exception &e) {
+    if (auto stopped = dynamic_cast<const ExecutionStopped *>(&e)) {
+      stopped_ = stopped->Reason();
+    }
+    error_ = e.what();
+    stack_trace_ = interpreter.GetStack();
+    stack_lines_ = interpreter.GetStackLines();
+    output_ << error_ << "\n";
+    output_.Flush();
+    return false;
+  }
+  output_.Flush();
+  return true;
+}
+
+bool Isolate::Run(const std::string &source, const std::string &cache_dir) {
+  stopped_ = StopReason::NONE;
+  std::shared_ptr<const Program> program;
+  try {
+    program = Program::Compile(source, cache_dir, tracer_);
+  } catch (const std::exception &e) {
+    error_ = e.what();
+    stack_trace_.clear();
+    stack_lines_.clear();
+    output_ << error_ << "\n";
+    output_.Flush();
+    return false;
+  }
+  return Run(*program);
+}
+
+void Isolate::Set(const std::string &name, const Value &value) {
+  global_->Define(name, value);
+}
+
+Value Isolate::Get(const std::string &name) const {
+  return global_->LookUp(name);
+}
+
+bool interpret(std::istream &input, OutputSink &output,
+               const InterpretOptions &options) {
+  std::string code(std::istreambuf_iterator<char>(input), {});
+  Isolate isolate(output, IsolateOptions{options.input, options.profiler,
+                                          options.line_profiler,
+                                          options.tracer, options.limits});
+  bool ok = isolate.Run(code, options.cache_dir);
+  if (options.stop_reason != nullptr) {
+    *options.stop_reason = isolate.Stopped();
+  }
+  return ok;
+}
+
+bool interpret(std::istream &input, std::ostream &output,
+               const InterpretOptions &options) {
+  StreamSink sink(output);
+  return interpret(input, sink, options);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "interpreter.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Parsed program. Nothing modifies it after compilation, so one Program can
+// run in any number of isolates at the same time.
+class Program {
+public:
+  // Parses `source`, reusing the program cache (see ProgramCache). Throws
+  // on syntax errors.
+  static std::shared_ptr<const Program> Compile(const std::string &source,
+                                                const std::string &cache_dir = "",
+                                                Tracer *tracer = nullptr);
+
+  const std::shared_ptr<AST::BlockNode> &Root() const { return root_; }
+
+private:
+  explicit Program(std::shared_ptr<AST::BlockNode> root)
+      : root_(std::move(root)) {}
+
+  std::shared_ptr<AST::BlockNode> root_;
+};
+
+struct IsolateOptions {
+  // Where read(), read_all() and read_lines() take their input from;
+  // nullptr means the process standard input, which every isolate without
+  // a source of its own shares.
+  InputSource *input = nullptr;
+  // Receives the calls of every run when set; see Profiler.
+  Profiler *profiler = nullptr;
+  // Receives the statements of every run when set; see LineProfiler.
+  LineProfiler *line_profiler = nullptr;
+  // Records compilation, execution and every call when set; see Tracer.
+  Tracer *tracer = nullptr;
+  // Applied to every run; see ExecutionLimits.
+  ExecutionLimits limits;
+};
+
+// Independent interpreter instance: its own global scope and builtins,
+// random generator, output sink and call stack. Values are never shared
+// between isolates, and the only state they have in common (program cache,
+// thread pool) is thread-safe, so different isolates can run on different
+// threads at once. A single isolate must be used by one thread at a time.
+class Isolate {
+public:
+  explicit Isolate(OutputSink &output, const IsolateOptions &options = {});
+
+  // Runs a program in this isolate's global scope; variables defined by
+  // earlier runs stay visible. On failure the error is written to the
+  // output, kept in Error() and StackTrace(), and false is returned.
+  bool Run(const Program &program);
+  bool Run(const std::string &source, const std::string &cache_dir = "");
+
+  // Global variables, for passing data in and out of scripts.
+  void Set(const std::string &name, const Value &value);
+  Value Get(const std::string &name) const;
+
+  const std::string &Error() const { return error_; }
+  // Which limit stopped the last run, or StopReason::NONE when it finished
+  // or failed on its own.
+  StopReason Stopped() const { return stopped_; }
+  // Call stack at the point where the last failed run stopped.
+  const std::vector<std::string> &StackTrace() const { return stack_trace_; }
+  // Line of each call in StackTrace().
+  const std::vector<uint32_t> &StackTraceLines() const { return stack_lines_; }
+
+private:
+  OutputSink &output_;
+  Profiler *profiler_;
+  LineProfiler *line_profiler_;
+  Tracer *tracer_;
+  ExecutionLimits limits_;
+  std::shared_ptr<Scope> global_;
+  std::string error_;
+  StopReason stopped_ = StopReason::NONE;
+  std::vector<std::string> stack_trace_;
+  std::vector<uint32_t> stack_lines_;
+};
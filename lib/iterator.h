@@ -0,0 +1,15 @@
+#pragma once
+
+class Value;
+
+// Lazily produced sequence. `for` and consuming builtins pull elements one
+// at a time, so the whole sequence never has to exist as a list.
+class Iterator {
+public:
+  virtual ~Iterator() = default;
+
+  // Stores the next element in out; returns false once exhausted. Parallel
+  // builtins and spawned tasks share iterators, so it may be called from
+  // several threads at once, and each element goes to exactly one caller.
+  virtual bool Next(Value &out) = 0;
+};
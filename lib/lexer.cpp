@@ -9,15 +9,25 @@ std::vector<Token> Lexer::GetTokens() {
 }
 
 void Lexer::UpdateSymbol() {
-  if (code_.get(symbol_)) {
-    if (symbol_ == '\n') {
-      ++line_;
-    }
+  if (symbol_ == '\n') {
+    ++line_;
+    column_ = 1;
   } else {
+    ++column_;
+  }
+  if (!code_.get(symbol_)) {
     symbol_ = '\0';
   }
 }
 
+SourceLocation Lexer::Location() const {
+  return {static_cast<uint32_t>(line_), static_cast<uint32_t>(column_)};
+}
+
+Token Lexer::MakeToken(TokenType type, std::string value) const {
+  return Token(type, std::move(value), {token_begin_, Location()});
+}
+
 void Lexer::SkipWhitespace() {
   while (isspace(symbol_)) {
     UpdateSymbol();
@@ -28,13 +38,15 @@ Token Lexer::ReadNumber() {
   SkipWhitespace();
 
   std::string number = "";
-  while (isdigit(symbol_) || symbol_ == '-' || symbol_ == 'e' ||
-         symbol_ == 'E' || symbol_ == '.' || symbol_ == '+') {
+  while (isdigit(symbol_) || symbol_ == 'e' || symbol_ == 'E' ||
+         symbol_ == '.' ||
+         ((symbol_ == '-' || symbol_ == '+') && !number.empty() &&
+          (number.back() == 'e' || number.back() == 'E'))) {
     number.push_back(symbol_);
     UpdateSymbol();
   }
 
-  return Token(TokenType::NUMBER, number);
+  return MakeToken(TokenType::NUMBER, number);
 }
 
 Token Lexer::ReadString() {
@@ -46,11 +58,11 @@ Token Lexer::ReadString() {
     UpdateSymbol();
   }
 
-  if (keywords.find(str) != keywords.end()) {
-    return Token(keywords[str], str);
+  if (auto it = keywords.find(str); it != keywords.end()) {
+    return MakeToken(it->second, str);
   }
 
-  return Token(TokenType::IDENTIFIER, str);
+  return MakeToken(TokenType::IDENTIFIER, str);
 }
 
 Token Lexer::ReadStringValue() {
@@ -60,15 +72,16 @@ Token Lexer::ReadStringValue() {
     UpdateSymbol();
   }
   UpdateSymbol();
-  return Token(TokenType::STRING, str);
+  return MakeToken(TokenType::STRING, str);
 }
 
 Token Lexer::NextToken() {
   SkipWhitespace();
+  token_begin_ = Location();
 
   if (symbol_ == '\0') {
     UpdateSymbol();
-    return Token(TokenType::EOFF, "\0");
+    return MakeToken(TokenType::EOFF, "\0");
   }
 
   if (symbol_ == '\"') {
@@ -96,13 +109,13 @@ Token Lexer::NextToken() {
     return NextToken();
   }
 
-  if (keywords.find(word) != keywords.end()) {
+  if (auto it = keywords.find(word); it != keywords.end()) {
     UpdateSymbol();
-    return Token(keywords[word], word);
+    return MakeToken(it->second, word);
   }
   word.pop_back();
-  if (keywords.find(word) != keywords.end()) {
-    return Token(keywords[word], word);
+  if (auto it = keywords.find(word); it != keywords.end()) {
+    return MakeToken(it->second, word);
   }
 
   throw std::runtime_error("Unknown symbol '" + std::to_string(word.front()) +
@@ -6,25 +6,34 @@
 
 class Lexer {
 public:
-  Lexer(std::istream &code) : code_(code), line_(1) { UpdateSymbol(); }
+  Lexer(std::istream &code) : code_(code), line_(1), column_(0) {
+    UpdateSymbol();
+  }
   
   std::vector<Token> GetTokens();
 
 private:
   std::istream &code_;
+  // Position of symbol_.
   size_t line_;
+  size_t column_;
+  // Where the token being read starts.
+  SourceLocation token_begin_;
   std::vector<Token> tokens_;
-  char symbol_;
+  char symbol_ = '\0';
 
   void UpdateSymbol();
   void SkipWhitespace();
+  SourceLocation Location() const;
+  Token MakeToken(TokenType type, std::string value) const;
   Token ReadNumber();
   Token ReadString();
   Token ReadStringValue();
   Token NextToken();
 };
 
-static std::map<std::string, TokenType> keywords{
+// Read-only, so lexers on different threads can share it.
+inline const std::map<std::string, TokenType> keywords{
     {"+", TokenType::PLUS},
     {"-", TokenType::MINUS},
     {"*", TokenType::MULTIPLY},
@@ -57,6 +66,7 @@ static std::map<std::string, TokenType> keywords{
     {"break", TokenType::BREAK},
     {"continue", TokenType::CONTINUE},
     {"return", TokenType::RETURN},
+    {"yield", TokenType::YIELD},
     {"nil", TokenType::NIL},
     {"true", TokenType::BOOL},
     {"false", TokenType::BOOL},
@@ -65,6 +75,8 @@ static std::map<std::string, TokenType> keywords{
     {")", TokenType::R_S_BRACKET},
     {"[", TokenType::L_BRACKET},
     {"]", TokenType::R_BRACKET},
+    {"{", TokenType::L_C_BRACKET},
+    {"}", TokenType::R_C_BRACKET},
     {":", TokenType::COLON},
     {",", TokenType::COMMA},
     {"\0", TokenType::EOFF}};
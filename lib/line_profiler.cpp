@@ -0,0 +1,133 @@
+#include "line_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define ITMOSCRIPT_HAS_RDTSC 1
+#endif
+
+LineProfiler::LineProfiler()
+    : start_cycles_(Now()), start_time_(std::chrono::steady_clock::now()) {}
+
+uint64_t LineProfiler::Now() {
+#ifdef ITMOSCRIPT_HAS_RDTSC
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void LineProfiler::Enter(uint32_t line) {
+  if (line >= lines_.size()) {
+    lines_.resize(line + 1);
+    active_.resize(line + 1);
+  }
+  ++lines_[line].hits;
+  ++active_[line];
+  frames_.push_back({line, Now(), 0});
+}
+
+void LineProfiler::Leave() {
+  if (frames_.empty()) {
+    return;
+  }
+  Frame frame = frames_.back();
+  frames_.pop_back();
+  uint64_t elapsed = Now() - frame.start;
+
+  LineStats &stats = lines_[frame.line];
+  stats.self_cycles += elapsed - std::min(elapsed, frame.children);
+  if (--active_[frame.line] == 0) {
+    stats.total_cycles += elapsed;
+  }
+  if (!frames_.empty()) {
+    frames_.back().children += elapsed;
+  }
+}
+
+std::vector<LineProfiler::LineStats> LineProfiler::Lines() const {
+  std::vector<LineStats> lines;
+  for (size_t line = 0; line < lines_.size(); ++line) {
+    if (lines_[line].hits != 0) {
+      lines.push_back(lines_[line]);
+      lines.back().line = static_cast<uint32_t>(line);
+    }
+  }
+  return lines;
+}
+
+double LineProfiler::CyclesPerSecond() const {
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time_)
+                       .count();
+  if (seconds <= 0) {
+    return 1e9;
+  }
+  return std::max(static_cast<double>(Now() - start_cycles_) / seconds, 1.0);
+}
+
+void LineProfiler::WriteListing(std::ostream &out, std::string_view source,
+                                size_t hot) const {
+  std::vector<LineStats> lines = Lines();
+  uint64_t all_cycles = 0;
+  for (const LineStats &stats : lines) {
+    all_cycles += stats.self_cycles;
+  }
+
+  std::vector<LineStats> hottest = lines;
+  std::sort(hottest.begin(), hottest.end(),
+            [](const LineStats &a, const LineStats &b) {
+              return a.self_cycles > b.self_cycles;
+            });
+  hottest.resize(std::min(hot, hottest.size()));
+  std::vector<bool> is_hot(lines_.size());
+  for (const LineStats &stats : hottest) {
+    if (stats.self_cycles != 0) {
+      is_hot[stats.line] = true;
+    }
+  }
+
+  double ms_per_cycle = 1000 / CyclesPerSecond();
+  double percent_per_cycle = all_cycles ? 100.0 / all_cycles : 0;
+
+  char prefix[128];
+  std::snprintf(prefix, sizeof(prefix), "  %5s %10s %10s %7s %10s  %s\n",
+                "line", "hits", "self ms", "self %", "total ms", "source");
+  out << prefix;
+
+  uint32_t number = 1;
+  size_t begin = 0;
+  while (begin < source.size()) {
+    size_t end = source.find('\n', begin);
+    if (end == std::string_view::npos) {
+      end = source.size();
+    }
+    std::string_view text = source.substr(begin, end - begin);
+    if (!text.empty() && text.back() == '\r') {
+      text.remove_suffix(1);
+    }
+
+    if (number < lines_.size() && lines_[number].hits != 0) {
+      const LineStats &stats = lines_[number];
+      std::snprintf(prefix, sizeof(prefix),
+                    "%c %5u %10llu %10.3f %6.1f%% %10.3f  | ",
+                    is_hot[number] ? '>' : ' ', number,
+                    static_cast<unsigned long long>(stats.hits),
+                    stats.self_cycles * ms_per_cycle,
+                    stats.self_cycles * percent_per_cycle,
+                    stats.total_cycles * ms_per_cycle);
+    } else {
+      std::snprintf(prefix, sizeof(prefix), "  %5u %10s %10s %7s %10s  | ",
+                    number, "", "", "", "");
+    }
+    out << prefix << text << '\n';
+
+    begin = end + 1;
+    ++number;
+  }
+}
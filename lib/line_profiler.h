@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Counts how often each line of a script runs and the cycles spent on it.
+// The interpreter reports every statement it executes through Enter and
+// Leave, so unlike Profiler this measures every execution instead of
+// sampling, and a long top-level loop shows which of its lines are slow.
+//
+// A statement's time is charged to the line it starts on. Self time
+// excludes the statements nested in it (loop and function bodies); total
+// time includes them and counts a line once while it is active, so
+// recursion is not counted twice. Like Profiler, it follows one
+// interpreter at a time.
+class LineProfiler {
+public:
+  struct LineStats {
+    uint32_t line = 0;
+    uint64_t hits = 0;
+    uint64_t self_cycles = 0;
+    uint64_t total_cycles = 0;
+  };
+
+  LineProfiler();
+
+  LineProfiler(const LineProfiler &) = delete;
+  LineProfiler &operator=(const LineProfiler &) = delete;
+
+  // Called by the interpreter around every statement.
+  void Enter(uint32_t line);
+  void Leave();
+
+  // Lines that ran, in source order.
+  std::vector<LineStats> Lines() const;
+
+  // Rate of the cycle counter, measured since construction.
+  double CyclesPerSecond() const;
+
+  // `source` with the counts and times of every line in front of it. The
+  // `hot` lines with the most self time are marked with '>'.
+  void WriteListing(std::ostream &out, std::string_view source,
+                    size_t hot) const;
+
+  // Time stamp counter on x86, steady_clock nanoseconds elsewhere.
+  static uint64_t Now();
+
+private:
+  struct Frame {
+    uint32_t line;
+    uint64_t start;
+    // Cycles spent in nested statements.
+    uint64_t children;
+  };
+
+  // Indexed by line number.
+  std::vector<LineStats> lines_;
+  // Number of active frames per line.
+  std::vector<uint32_t> active_;
+  std::vector<Frame> frames_;
+
+  uint64_t start_cycles_;
+  std::chrono::steady_clock::time_point start_time_;
+};
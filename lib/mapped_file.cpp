@@ -0,0 +1,58 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ITMOSCRIPT_HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef ITMOSCRIPT_HAS_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Can not open file " + path);
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Can not open file " + path);
+  }
+
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ != 0) {
+    void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Can not map file " + path);
+    }
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(addr);
+    mapped_ = true;
+  }
+  ::close(fd);
+#else
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin) {
+    throw std::runtime_error("Can not open file " + path);
+  }
+  fallback_.assign(std::istreambuf_iterator<char>(fin),
+                   std::istreambuf_iterator<char>());
+  data_ = fallback_.data();
+  size_ = fallback_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef ITMOSCRIPT_HAS_MMAP
+  if (mapped_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
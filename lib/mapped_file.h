@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole file. On POSIX systems the file is mapped into
+// memory, so opening a large file costs nothing until its pages are touched.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *Data() const { return data_; }
+  size_t Size() const { return size_; }
+  std::string_view View() const { return std::string_view(data_, size_); }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::string fallback_;
+};
@@ -0,0 +1,271 @@
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+std::atomic<bool> MemoryStats::enabled_ = false;
+std::atomic<size_t> MemoryStats::recorded_blocks_ = 0;
+thread_local MemoryStats::Context MemoryStats::context_;
+
+namespace {
+
+struct Block {
+  size_t size;
+  uint32_t site;
+  AllocKind kind;
+};
+
+struct SiteCounters {
+  std::array<MemoryStats::Counters, kAllocKinds> kinds;
+  MemoryStats::Counters total;
+};
+
+// Everything is only touched under `mutex`. The state is created on first
+// use and never destroyed, since blocks may be freed during static
+// destruction.
+struct State {
+  std::mutex mutex;
+  std::unordered_map<void *, Block> blocks;
+  std::unordered_map<uint32_t, SiteCounters> sites;
+  std::array<MemoryStats::Counters, kAllocKinds> kinds;
+  MemoryStats::Counters total;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> name_ids;
+};
+
+// Set while this thread updates the state. Allocations made by the
+// bookkeeping itself are not recorded, which also keeps operator new from
+// taking the lock twice.
+thread_local bool busy = false;
+
+class Busy {
+public:
+  Busy() { busy = true; }
+  ~Busy() { busy = false; }
+};
+
+State &GetState() {
+  static State *state = [] {
+    Busy guard;
+    return new State;
+  }();
+  return *state;
+}
+
+void Add(MemoryStats::Counters &counters, size_t size) {
+  ++counters.allocations;
+  counters.bytes += size;
+  ++counters.live_allocations;
+  counters.live_bytes += size;
+  counters.peak_bytes = std::max(counters.peak_bytes, counters.live_bytes);
+}
+
+void Remove(MemoryStats::Counters &counters, size_t size) {
+  --counters.live_allocations;
+  counters.live_bytes -= size;
+}
+
+} // namespace
+
+const char *AllocKindName(AllocKind kind) {
+  switch (kind) {
+  case AllocKind::STRING:
+    return "string";
+  case AllocKind::LIST:
+    return "list";
+  case AllocKind::DICT:
+    return "dict";
+  case AllocKind::FUNCTION:
+    return "function";
+  case AllocKind::SCOPE:
+    return "scope";
+  case AllocKind::OTHER:
+    return "other";
+  }
+  return "other";
+}
+
+void MemoryStats::Enable() {
+  GetState();
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void MemoryStats::Disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+void MemoryStats::Reset() {
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  Busy guard;
+  state.blocks.clear();
+  state.sites.clear();
+  state.kinds = {};
+  state.total = {};
+  recorded_blocks_.store(0, std::memory_order_relaxed);
+}
+
+uint32_t MemoryStats::NamedSite(std::string_view name) {
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  Busy guard;
+  auto [it, inserted] = state.name_ids.try_emplace(
+      std::string(name), static_cast<uint32_t>(state.names.size()));
+  if (inserted) {
+    state.names.emplace_back(name);
+  }
+  return it->second | kNamedSite;
+}
+
+std::string MemoryStats::SiteName(uint32_t site) {
+  if (site & kNamedSite) {
+    State &state = GetState();
+    std::lock_guard lock(state.mutex);
+    Busy guard;
+    return state.names[site & ~kNamedSite];
+  }
+  if (site == 0) {
+    return "<native>";
+  }
+  return "line " + std::to_string(site);
+}
+
+MemoryStats::Counters MemoryStats::Total() {
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  return state.total;
+}
+
+MemoryStats::Counters MemoryStats::OfKind(AllocKind kind) {
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  return state.kinds[static_cast<size_t>(kind)];
+}
+
+std::vector<MemoryStats::SiteStats> MemoryStats::Sites() {
+  std::vector<std::pair<uint32_t, SiteCounters>> copy;
+  {
+    State &state = GetState();
+    std::lock_guard lock(state.mutex);
+    Busy guard;
+    copy.assign(state.sites.begin(), state.sites.end());
+  }
+
+  std::vector<SiteStats> sites;
+  for (const auto &[site, counters] : copy) {
+    sites.push_back({SiteName(site), counters.kinds, counters.total});
+  }
+  std::sort(sites.begin(), sites.end(),
+            [](const SiteStats &a, const SiteStats &b) {
+              return a.total.bytes > b.total.bytes ||
+                     (a.total.bytes == b.total.bytes && a.site < b.site);
+            });
+  return sites;
+}
+
+uint64_t MemoryStats::PeakRss() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+void MemoryStats::WriteReport(std::ostream &out, size_t limit) {
+  char line[160];
+  auto row = [&](const char *name, const Counters &c) {
+    std::snprintf(line, sizeof(line), "%12llu %14llu %12llu %14llu %14llu  ",
+                  static_cast<unsigned long long>(c.allocations),
+                  static_cast<unsigned long long>(c.bytes),
+                  static_cast<unsigned long long>(c.live_allocations),
+                  static_cast<unsigned long long>(c.live_bytes),
+                  static_cast<unsigned long long>(c.peak_bytes));
+    out << line << name << '\n';
+  };
+  std::snprintf(line, sizeof(line), "%12s %14s %12s %14s %14s  %s\n",
+                "allocs", "bytes", "live allocs", "live bytes", "peak bytes",
+                "");
+  std::string header(line);
+
+  out << header;
+  for (size_t kind = 0; kind < kAllocKinds; ++kind) {
+    row(AllocKindName(static_cast<AllocKind>(kind)),
+        OfKind(static_cast<AllocKind>(kind)));
+  }
+  row("total", Total());
+
+  std::vector<SiteStats> sites = Sites();
+  out << '\n' << header;
+  for (size_t i = 0; i < sites.size() && i < limit; ++i) {
+    for (size_t kind = 0; kind < kAllocKinds; ++kind) {
+      if (sites[i].kinds[kind].allocations != 0) {
+        std::string name = sites[i].site + " " +
+                           AllocKindName(static_cast<AllocKind>(kind));
+        row(name.c_str(), sites[i].kinds[kind]);
+      }
+    }
+  }
+  out << "peak RSS " << PeakRss() << " bytes\n";
+}
+
+void MemoryStats::RecordAllocation(void *block, size_t size) {
+  if (busy || !Enabled()) {
+    return;
+  }
+  Context context = context_;
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  Busy guard;
+
+  auto [it, inserted] =
+      state.blocks.try_emplace(block, Block{size, context.site, context.kind});
+  if (!inserted) {
+    // The block was freed while nothing was watching; forget it.
+    it->second = {size, context.site, context.kind};
+  } else {
+    recorded_blocks_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SiteCounters &site = state.sites[context.site];
+  size_t kind = static_cast<size_t>(context.kind);
+  Add(state.total, size);
+  Add(state.kinds[kind], size);
+  Add(site.kinds[kind], size);
+  Add(site.total, size);
+}
+
+void MemoryStats::RecordFree(void *block) {
+  if (busy) {
+    return;
+  }
+  State &state = GetState();
+  std::lock_guard lock(state.mutex);
+  Busy guard;
+
+  auto it = state.blocks.find(block);
+  if (it == state.blocks.end()) {
+    return;
+  }
+  Block recorded = it->second;
+  state.blocks.erase(it);
+  recorded_blocks_.fetch_sub(1, std::memory_order_relaxed);
+
+  SiteCounters &site = state.sites[recorded.site];
+  size_t kind = static_cast<size_t>(recorded.kind);
+  Remove(state.total, recorded.size);
+  Remove(state.kinds[kind], recorded.size);
+  Remove(site.kinds[kind], recorded.size);
+  Remove(site.total, recorded.size);
+}
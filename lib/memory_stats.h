@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What an allocation was made for. The interpreter sets it around the code
+// that creates values of a kind; everything else is OTHER.
+enum struct AllocKind { STRING, LIST, DICT, FUNCTION, SCOPE, OTHER };
+
+inline constexpr size_t kAllocKinds = 6;
+
+const char *AllocKindName(AllocKind kind);
+
+// Allocation accounting for scripts. While enabled, every operator new of
+// the process is recorded with the kind and the site (script line or
+// builtin) the allocating thread is working on, and every operator delete
+// of a recorded block is subtracted again, so both cumulative and live
+// counts are exact. The replaced operators are in the
+// itmoscript_memory_stats target; a program that does not link it keeps
+// its own allocator and records nothing.
+//
+// Recording takes a lock per allocation, so this is a diagnostic mode.
+// While disabled, new and delete only check one atomic flag. Blocks
+// allocated before Enable are not counted when they are freed.
+class MemoryStats {
+public:
+  struct Counters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t live_allocations = 0;
+    uint64_t live_bytes = 0;
+    // Highest live_bytes seen.
+    uint64_t peak_bytes = 0;
+  };
+
+  struct SiteStats {
+    std::string site;
+    std::array<Counters, kAllocKinds> kinds;
+    Counters total;
+  };
+
+  static void Enable();
+  static void Disable();
+  static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // Forgets every count and recorded block.
+  static void Reset();
+
+  // Sites are small ids so that entering one is cheap: script lines map to
+  // themselves, named sites (builtins) are interned.
+  static uint32_t LineSite(uint32_t line) { return line & ~kNamedSite; }
+  static uint32_t NamedSite(std::string_view name);
+  static std::string SiteName(uint32_t site);
+
+  static Counters Total();
+  static Counters OfKind(AllocKind kind);
+  // Every site that allocated, ordered by bytes allocated.
+  static std::vector<SiteStats> Sites();
+
+  // Peak resident set size of the process in bytes, 0 where unknown.
+  static uint64_t PeakRss();
+
+  // Totals per kind, then the `limit` sites that allocated the most split
+  // by kind, and the peak RSS.
+  static void WriteReport(std::ostream &out, size_t limit);
+
+  // Called by operator new and delete.
+  static void RecordAllocation(void *block, size_t size);
+  static void RecordFree(void *block);
+  static bool Watching() {
+    return enabled_.load(std::memory_order_relaxed) ||
+           recorded_blocks_.load(std::memory_order_relaxed) != 0;
+  }
+
+private:
+  friend class AllocationScope;
+
+  static constexpr uint32_t kNamedSite = 0x80000000;
+
+  struct Context {
+    AllocKind kind = AllocKind::OTHER;
+    uint32_t site = 0;
+  };
+
+  static std::atomic<bool> enabled_;
+  static std::atomic<size_t> recorded_blocks_;
+  static thread_local Context context_;
+};
+
+// Attributes the allocations of this thread to a kind, and optionally a
+// site, for a scope. Does nothing while MemoryStats is disabled.
+class AllocationScope {
+public:
+  explicit AllocationScope(AllocKind kind) : active_(MemoryStats::Enabled()) {
+    if (active_) {
+      previous_ = MemoryStats::context_;
+      MemoryStats::context_.kind = kind;
+    }
+  }
+  AllocationScope(AllocKind kind, uint32_t site)
+      : active_(MemoryStats::Enabled()) {
+    if (active_) {
+      previous_ = MemoryStats::context_;
+      MemoryStats::context_ = {kind, site};
+    }
+  }
+  ~AllocationScope() {
+    if (active_) {
+      MemoryStats::context_ = previous_;
+    }
+  }
+
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope &operator=(const AllocationScope &) = delete;
+
+private:
+  bool active_;
+  MemoryStats::Context previous_;
+};
@@ -0,0 +1,78 @@
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Gives the new_handler a chance to free memory after a failed attempt,
+// as the standard operator new does; throws if there is none.
+void HandleFailure() {
+  std::new_handler handler = std::get_new_handler();
+  if (handler == nullptr) {
+    throw std::bad_alloc();
+  }
+  handler();
+}
+
+void *Allocate(std::size_t size) {
+  void *block;
+  while ((block = std::malloc(size == 0 ? 1 : size)) == nullptr) {
+    HandleFailure();
+  }
+  if (MemoryStats::Watching()) {
+    MemoryStats::RecordAllocation(block, size);
+  }
+  return block;
+}
+
+void *AllocateAligned(std::size_t size, std::align_val_t alignment) {
+  auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a size that is a multiple of the alignment.
+  std::size_t rounded =
+      (std::max<std::size_t>(size, 1) + align - 1) & ~(align - 1);
+  void *block;
+  while ((block = std::aligned_alloc(align, rounded)) == nullptr) {
+    HandleFailure();
+  }
+  if (MemoryStats::Watching()) {
+    MemoryStats::RecordAllocation(block, size);
+  }
+  return block;
+}
+
+void Free(void *block) {
+  if (block != nullptr && MemoryStats::Watching()) {
+    MemoryStats::RecordFree(block);
+  }
+  std::free(block);
+}
+
+} // namespace
+
+// Replacements of the global allocation functions. Every form that takes
+// memory from or gives it back to the heap is defined here, so that a
+// block is always recorded and released by the same code; the nothrow
+// forms of the standard library call these.
+void *operator new(std::size_t size) { return Allocate(size); }
+void *operator new[](std::size_t size) { return Allocate(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+
+void operator delete(void *block) noexcept { Free(block); }
+void operator delete[](void *block) noexcept { Free(block); }
+void operator delete(void *block, std::size_t) noexcept { Free(block); }
+void operator delete[](void *block, std::size_t) noexcept { Free(block); }
+void operator delete(void *block, std::align_val_t) noexcept { Free(block); }
+void operator delete[](void *block, std::align_val_t) noexcept { Free(block); }
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept {
+  Free(block);
+}
+void operator delete[](void *block, std::size_t, std::align_val_t) noexcept {
+  Free(block);
+}
@@ -0,0 +1,50 @@
+#include "name_table.h"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+struct NameHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view name) const {
+    return std::hash<std::string_view>{}(name);
+  }
+};
+
+struct Table {
+  std::mutex mutex;
+  // A deque keeps the names in place, so the views in `ids` stay valid.
+  std::deque<std::string> names;
+  std::unordered_map<std::string_view, uint32_t, NameHash, std::equal_to<>>
+      ids;
+};
+
+Table &GetTable() {
+  static Table table;
+  return table;
+}
+
+} // namespace
+
+uint32_t NameTable::Intern(std::string_view name) {
+  Table &table = GetTable();
+  std::lock_guard lock(table.mutex);
+  if (auto it = table.ids.find(name); it != table.ids.end()) {
+    return it->second;
+  }
+  if (table.names.size() == kMaxNames) {
+    return kUnnamed;
+  }
+  uint32_t id = static_cast<uint32_t>(table.names.size());
+  table.ids.emplace(table.names.emplace_back(name), id);
+  return id;
+}
+
+std::string NameTable::Name(uint32_t id) {
+  Table &table = GetTable();
+  std::lock_guard lock(table.mutex);
+  return id < table.names.size() ? table.names[id] : std::string();
+}
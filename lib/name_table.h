@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Process-wide ids of function names, so that call frames can refer to a
+// name with a number and stack traces turn them back into text only when
+// they are asked for. Names are interned when call nodes are built; ids
+// stay valid for the life of the process and names are never removed.
+//
+// Every program compiled in the process adds to the table, so it is capped
+// at kMaxNames. Names interned after that get kUnnamed, and their frames
+// read the name from the call node instead.
+class NameTable {
+public:
+  static constexpr uint32_t kMaxNames = 1 << 16;
+  static constexpr uint32_t kUnnamed = UINT32_MAX;
+
+  static uint32_t Intern(std::string_view name);
+  static std::string Name(uint32_t id);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+
+// Value of a float64 array: `size` doubles stored contiguously. Arrays are
+// immutable like lists, so a slice points into the buffer of the array it
+// was taken from and keeps it alive.
+struct NumberArray {
+  std::shared_ptr<const double> data;
+  size_t size = 0;
+
+  std::span<const double> View() const { return {data.get(), size}; }
+
+  NumberArray Slice(size_t start, size_t length) const {
+    return {std::shared_ptr<const double>(data, data.get() + start), length};
+  }
+
+  // Array of `size` uninitialized elements; the caller fills them through
+  // `out` before the array is used.
+  static NumberArray Allocate(size_t size, double *&out) {
+    std::shared_ptr<double[]> buffer =
+        std::make_shared_for_overwrite<double[]>(size);
+    out = buffer.get();
+    return {std::shared_ptr<const double>(buffer, buffer.get()), size};
+  }
+};
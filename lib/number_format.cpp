@@ -0,0 +1,92 @@
+#include "number_format.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+// Below 2^53 every integral double is exact, so fixed notation is both
+// shortest-round-trip and free of a surprising exponent ("1e+06").
+constexpr double kMaxFixedIntegral = 9007199254740992.0;
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+// `text` without surrounding whitespace and a leading '+'.
+std::string_view TrimNumber(std::string_view text) {
+  while (!text.empty() && IsSpace(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && IsSpace(text.back())) {
+    text.remove_suffix(1);
+  }
+  if (text.size() > 1 && text.front() == '+' && text[1] != '-') {
+    text.remove_prefix(1);
+  }
+  return text;
+}
+
+} // namespace
+
+size_t FormatNumber(double value, char *buffer) {
+  char *end = buffer + kMaxNumberLength;
+  std::to_chars_result result;
+  if (std::isfinite(value) && std::abs(value) < kMaxFixedIntegral &&
+      value == std::trunc(value)) {
+    result = std::to_chars(buffer, end, value, std::chars_format::fixed);
+  } else {
+    result = std::to_chars(buffer, end, value);
+  }
+  return static_cast<size_t>(result.ptr - buffer);
+}
+
+size_t FormatNumber(int64_t value, char *buffer) {
+  auto result = std::to_chars(buffer, buffer + kMaxNumberLength, value);
+  return static_cast<size_t>(result.ptr - buffer);
+}
+
+std::string NumberToString(int64_t value) {
+  char buffer[kMaxNumberLength];
+  return std::string(buffer, FormatNumber(value, buffer));
+}
+
+std::string NumberToString(double value) {
+  char buffer[kMaxNumberLength];
+  return std::string(buffer, FormatNumber(value, buffer));
+}
+
+void AppendNumber(std::string &out, double value) {
+  char buffer[kMaxNumberLength];
+  out.append(buffer, FormatNumber(value, buffer));
+}
+
+bool ParseInteger(std::string_view text, int64_t &value) {
+  text = TrimNumber(text);
+  int64_t result;
+  auto [ptr, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), result);
+  if (text.empty() || ec != std::errc() ||
+      ptr != text.data() + text.size()) {
+    return false;
+  }
+  value = result;
+  return true;
+}
+
+bool ParseNumber(std::string_view text, double &value) {
+  text = TrimNumber(text);
+  if (text.empty()) {
+    return false;
+  }
+
+  double result;
+  auto [ptr, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), result);
+  if (ec != std::errc() || ptr != text.data() + text.size()) {
+    return false;
+  }
+  value = result;
+  return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Single place where numbers are converted to and from text. Formatting
+// produces the shortest string that reads back as the same double; integral
+// values are always written without an exponent. Nothing here throws.
+
+inline constexpr size_t kMaxNumberLength = 32;
+
+// Writes value into buffer (at least kMaxNumberLength bytes) and returns the
+// number of characters written.
+size_t FormatNumber(double value, char *buffer);
+size_t FormatNumber(int64_t value, char *buffer);
+
+std::string NumberToString(double value);
+std::string NumberToString(int64_t value);
+void AppendNumber(std::string &out, double value);
+
+// Parses the whole text (surrounding whitespace and a leading '+' allowed).
+// Returns false if the text is not a number.
+bool ParseNumber(std::string_view text, double &value);
+
+// Like ParseNumber, for text that is an integer (no fraction or exponent)
+// within the range of int64_t.
+bool ParseInteger(std::string_view text, int64_t &value);
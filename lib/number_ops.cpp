@@ -0,0 +1,162 @@
+#include "number_ops.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// 2^63: doubles at or above it are larger than every int64_t.
+constexpr double kInt64Bound = 9223372036854775808.0;
+
+std::partial_ordering CompareIntDouble(int64_t i, double d) {
+  if (std::isnan(d)) {
+    return std::partial_ordering::unordered;
+  }
+  if (d >= kInt64Bound) {
+    return std::partial_ordering::less;
+  }
+  if (d < -kInt64Bound) {
+    return std::partial_ordering::greater;
+  }
+  double whole = std::trunc(d);
+  int64_t di = static_cast<int64_t>(whole);
+  if (i != di) {
+    return i <=> di;
+  }
+  return whole <=> d;
+}
+
+// l^r by squaring; false if some step overflows.
+bool IntegerPow(int64_t l, int64_t r, int64_t &out) {
+  int64_t result = 1;
+  while (r > 0) {
+    if ((r & 1) && __builtin_mul_overflow(result, l, &result)) {
+      return false;
+    }
+    r >>= 1;
+    if (r > 0 && __builtin_mul_overflow(l, l, &l)) {
+      return false;
+    }
+  }
+  out = result;
+  return true;
+}
+
+Value IntegerArithmetic(TokenType op, int64_t l, int64_t r) {
+  int64_t result;
+  switch (op) {
+  case TokenType::PLUS:
+    if (!__builtin_add_overflow(l, r, &result)) {
+      return result;
+    }
+    break;
+  case TokenType::MINUS:
+    if (!__builtin_sub_overflow(l, r, &result)) {
+      return result;
+    }
+    break;
+  case TokenType::MULTIPLY:
+    if (!__builtin_mul_overflow(l, r, &result)) {
+      return result;
+    }
+    break;
+  case TokenType::DIVIDE:
+    if (r == 0) {
+      throw std::runtime_error("Division by 0");
+    }
+    if (r != -1 && l % r == 0) {
+      return l / r;
+    }
+    if (r == -1 && l != INT64_MIN) {
+      return -l;
+    }
+    break;
+  case TokenType::MOD:
+    if (r == -1) {
+      return int64_t(0);
+    }
+    if (r != 0) {
+      return l % r;
+    }
+    break;
+  case TokenType::POW:
+    if (r >= 0 && IntegerPow(l, r, result)) {
+      return result;
+    }
+    break;
+  default:
+    break;
+  }
+  return NumberArithmetic(op, double(l), double(r));
+}
+
+} // namespace
+
+Value NumberArithmetic(TokenType op, const Value &l, const Value &r) {
+  auto li = std::get_if<int64_t>(&l);
+  auto ri = std::get_if<int64_t>(&r);
+  if (li && ri) {
+    return IntegerArithmetic(op, *li, *ri);
+  }
+
+  double ld = l.GetNumber();
+  double rd = r.GetNumber();
+  switch (op) {
+  case TokenType::PLUS:
+    return ld + rd;
+  case TokenType::MINUS:
+    return ld - rd;
+  case TokenType::MULTIPLY:
+    return ld * rd;
+  case TokenType::DIVIDE:
+    if (rd == 0) {
+      throw std::runtime_error("Division by 0");
+    }
+    return ld / rd;
+  case TokenType::MOD:
+    return std::fmod(ld, rd);
+  case TokenType::POW:
+    return std::pow(ld, rd);
+  default:
+    throw std::runtime_error("Unknown operator");
+  }
+}
+
+Value NegateNumber(const Value &v) {
+  // -0 only exists as a double.
+  if (auto i = std::get_if<int64_t>(&v)) {
+    if (*i != INT64_MIN && *i != 0) {
+      return -*i;
+    }
+  }
+  return -v.GetNumber();
+}
+
+std::partial_ordering CompareNumbers(const Value &l, const Value &r) {
+  auto li = std::get_if<int64_t>(&l);
+  auto ri = std::get_if<int64_t>(&r);
+  if (li && ri) {
+    return *li <=> *ri;
+  }
+  if (li) {
+    return CompareIntDouble(*li, r.GetNumber());
+  }
+  if (ri) {
+    return 0 <=> CompareIntDouble(*ri, l.GetNumber());
+  }
+  return l.GetNumber() <=> r.GetNumber();
+}
+
+bool GetInteger(const Value &v, int64_t &out) {
+  if (auto i = std::get_if<int64_t>(&v)) {
+    out = *i;
+    return true;
+  }
+  auto d = std::get_if<double>(&v);
+  if (d == nullptr || *d != std::trunc(*d) || *d >= kInt64Bound ||
+      *d < -kInt64Bound) {
+    return false;
+  }
+  out = static_cast<int64_t>(*d);
+  return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "token_type.h"
+#include "value.h"
+#include <compare>
+#include <cstdint>
+
+// Arithmetic and comparisons on numbers. A number value is a double or an
+// exact int64_t, and scripts can not tell which: operations on integers give
+// an integer whenever the result is a whole number that fits into int64_t,
+// and fall back to double arithmetic otherwise. Integers above 2^53 (ids,
+// timestamps in nanoseconds) stay exact, and loop counters and indices never
+// go through floating point.
+
+// `l op r` for PLUS, MINUS, MULTIPLY, DIVIDE, MOD and POW. Throws on
+// division by zero.
+Value NumberArithmetic(TokenType op, const Value &l, const Value &r);
+
+Value NegateNumber(const Value &v);
+
+// Exact order of two numbers, even between an integer and a double that
+// rounds to it; unordered if either is NaN.
+std::partial_ordering CompareNumbers(const Value &l, const Value &r);
+
+// The whole number a number value holds, if it fits into int64_t. Used for
+// indices and dict keys, so 2 and 2.0 are the same index and the same key.
+bool GetInteger(const Value &v, int64_t &out);
@@ -0,0 +1,136 @@
+#include "output_sink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#define ITMOSCRIPT_HAS_WRITE 1
+#else
+#include <cstdio>
+#endif
+
+void StreamSink::Write(std::string_view data) {
+  out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+void StreamSink::Flush() { out_.flush(); }
+
+FdSink::FdSink(int fd, FlushPolicy policy, size_t buffer_size,
+               size_t flush_size)
+    : fd_(fd), policy_(policy), buffer_(buffer_size == 0 ? 1 : buffer_size),
+      used_(0), flush_size_(flush_size == 0 ? buffer_.size()
+                                            : std::min(flush_size,
+                                                       buffer_.size())) {}
+
+FdSink::~FdSink() {
+  try {
+    Flush();
+  } catch (const std::exception &) {
+  }
+}
+
+void FdSink::Write(std::string_view data) {
+  if (data.size() > buffer_.size() - used_) {
+    Flush();
+    if (data.size() >= buffer_.size()) {
+      WriteAll(data.data(), data.size());
+      return;
+    }
+  }
+
+  std::memcpy(buffer_.data() + used_, data.data(), data.size());
+  used_ += data.size();
+
+  switch (policy_) {
+  case FlushPolicy::NEWLINE:
+    if (data.find('\n') != std::string_view::npos) {
+      Flush();
+    }
+    break;
+  case FlushPolicy::SIZE:
+    if (used_ >= flush_size_) {
+      Flush();
+    }
+    break;
+  case FlushPolicy::NONE:
+    break;
+  }
+}
+
+void FdSink::Flush() {
+  if (used_ == 0) {
+    return;
+  }
+  size_t size = used_;
+  used_ = 0;
+  WriteAll(buffer_.data(), size);
+}
+
+void FdSink::WriteAll(const char *data, size_t size) {
+#ifdef ITMOSCRIPT_HAS_WRITE
+  while (size > 0) {
+    ssize_t written = ::write(fd_, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Can not write output");
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+#else
+  std::FILE *file = fd_ == 2 ? stderr : stdout;
+  if (std::fwrite(data, 1, size, file) != size) {
+    throw std::runtime_error("Can not write output");
+  }
+  std::fflush(file);
+#endif
+}
+
+FileSink::FileSink(const std::string &path, bool append, size_t buffer_size)
+    : fd_(-1) {
+#ifdef ITMOSCRIPT_HAS_WRITE
+  int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+  fd_ = ::open(path.c_str(), flags, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Can not open file " + path);
+  }
+  sink_ = std::make_unique<FdSink>(fd_, FlushPolicy::NONE, buffer_size);
+#else
+  stream_ = std::make_unique<std::ofstream>(
+      path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+  if (!*stream_) {
+    throw std::runtime_error("Can not open file " + path);
+  }
+#endif
+}
+
+FileSink::~FileSink() {
+  sink_.reset();
+#ifdef ITMOSCRIPT_HAS_WRITE
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+#endif
+}
+
+void FileSink::Write(std::string_view data) {
+  if (sink_) {
+    sink_->Write(data);
+  } else {
+    stream_->write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+}
+
+void FileSink::Flush() {
+  if (sink_) {
+    sink_->Flush();
+  } else {
+    stream_->flush();
+  }
+}
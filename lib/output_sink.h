@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum struct FlushPolicy {
+  NONE,    // only when the buffer is full or Flush() is called
+  NEWLINE, // after every write that contains '\n'
+  SIZE,    // once the buffered data reaches the flush size
+};
+
+// Destination of everything a script prints.
+class OutputSink {
+public:
+  virtual ~OutputSink() = default;
+
+  virtual void Write(std::string_view data) = 0;
+  virtual void Flush() {}
+
+  OutputSink &operator<<(std::string_view data) {
+    Write(data);
+    return *this;
+  }
+};
+
+// Forwards output to a std::ostream, e.g. std::ostringstream in tests.
+class StreamSink : public OutputSink {
+public:
+  explicit StreamSink(std::ostream &out) : out_(out) {}
+
+  void Write(std::string_view data) override;
+  void Flush() override;
+
+private:
+  std::ostream &out_;
+};
+
+// Collects output in memory.
+class StringSink : public OutputSink {
+public:
+  void Write(std::string_view data) override { buffer_.append(data); }
+
+  const std::string &Str() const { return buffer_; }
+  std::string Take() { return std::move(buffer_); }
+
+private:
+  std::string buffer_;
+};
+
+// Writes straight to a file descriptor through one reusable buffer, so
+// memory use does not depend on how much a script prints.
+class FdSink : public OutputSink {
+public:
+  static constexpr size_t kDefaultBufferSize = 1 << 16;
+
+  // flush_size is only used by FlushPolicy::SIZE; 0 means the buffer size.
+  FdSink(int fd, FlushPolicy policy = FlushPolicy::SIZE,
+         size_t buffer_size = kDefaultBufferSize, size_t flush_size = 0);
+  ~FdSink() override;
+
+  FdSink(const FdSink &) = delete;
+  FdSink &operator=(const FdSink &) = delete;
+
+  void Write(std::string_view data) override;
+  void Flush() override;
+
+private:
+  int fd_;
+  FlushPolicy policy_;
+  std::vector<char> buffer_;
+  size_t used_;
+  size_t flush_size_;
+
+  void WriteAll(const char *data, size_t size);
+};
+
+// Buffered writer to a file that it opens itself (truncating or appending).
+class FileSink : public OutputSink {
+public:
+  static constexpr size_t kDefaultBufferSize = 1 << 20;
+
+  FileSink(const std::string &path, bool append,
+           size_t buffer_size = kDefaultBufferSize);
+  ~FileSink() override;
+
+  FileSink(const FileSink &) = delete;
+  FileSink &operator=(const FileSink &) = delete;
+
+  void Write(std::string_view data) override;
+  void Flush() override;
+
+private:
+  int fd_;
+  std::unique_ptr<FdSink> sink_;
+  std::unique_ptr<std::ofstream> stream_;
+};
@@ -3,7 +3,8 @@
 std::unique_ptr<AST::BlockNode> Parser::ParseCode() {
   std::unique_ptr<AST::BlockNode> root = std::make_unique<AST::BlockNode>();
   while (pos_ < tokens_.size() - 1) {
-    root->AddNode(ParseStatement());
+    size_t first = pos_;
+    root->AddNode(Spanned(ParseStatement(), first));
   }
 
   return root;
@@ -80,7 +81,8 @@ std::unique_ptr<AST::BaseNode> Parser::ParsePrimary() {
         if (tokens_[pos_].GetType() == TokenType::COMMA) {
           ++pos_;
         }
-        args.emplace_back(ParsePrimary());
+        size_t first = pos_;
+        args.emplace_back(Spanned(ParsePrimary(), first));
       }
       Require({TokenType::R_S_BRACKET});
       return std::make_unique<AST::CallNode>(token.GetValue(),
@@ -121,6 +123,10 @@ std::unique_ptr<AST::BaseNode> Parser::ParsePrimary() {
     }
   }
 
+  if (token.GetType() == TokenType::L_C_BRACKET) {
+    return ParseDict();
+  }
+
   if (token.GetType() == TokenType::FUNCTION) {
     return ParseFunction();
   }
@@ -154,32 +160,38 @@ Parser::ParseIndexAndSlice(std::unique_ptr<AST::BaseNode> var) {
 }
 
 std::unique_ptr<AST::BaseNode> Parser::ParseUnary() {
+  size_t first = pos_;
   Token token = tokens_[pos_];
   if (token.GetType() == TokenType::MINUS ||
       token.GetType() == TokenType::PLUS) {
     ++pos_;
     std::unique_ptr<AST::BaseNode> node = ParseUnary();
-    return std::make_unique<AST::UnaryOperationNode>(token, std::move(node));
+    return Spanned(
+        std::make_unique<AST::UnaryOperationNode>(token, std::move(node)),
+        first);
   }
 
   if (token.GetType() == TokenType::NOT) {
     ++pos_;
     std::unique_ptr<AST::BaseNode> node = ParseUnary();
-    return std::make_unique<AST::UnaryOperationNode>(token, std::move(node));
+    return Spanned(
+        std::make_unique<AST::UnaryOperationNode>(token, std::move(node)),
+        first);
   }
   
-  return ParsePrimary();
+  return Spanned(ParsePrimary(), first);
 }
 
 int Parser::GetPriority(TokenType type) {
-  if(priority.find(type) != priority.end()){
-    return priority[type];
+  if (auto it = priority.find(type); it != priority.end()) {
+    return it->second;
   }
 
   return 0;
 }
 
 std::unique_ptr<AST::BaseNode> Parser::ParseBin(int max_priority) {
+  size_t first = pos_;
   std::unique_ptr<AST::BaseNode> left = ParseUnary();
 
   while (pos_ < tokens_.size()) {
@@ -194,8 +206,9 @@ std::unique_ptr<AST::BaseNode> Parser::ParseBin(int max_priority) {
 
     std::unique_ptr<AST::BaseNode> right = ParseBin(priority + 1);
 
-    left = std::make_unique<AST::BinOperationNode>(std::move(left), token,
-                                              std::move(right));
+    left = Spanned(std::make_unique<AST::BinOperationNode>(
+                       std::move(left), token, std::move(right)),
+                   first);
   }
 
   return left;
@@ -212,6 +225,8 @@ std::unique_ptr<AST::BaseNode> Parser::ParseStatement() {
     return ParseWhile();
   case TokenType::RETURN:
     return ParseReturn();
+  case TokenType::YIELD:
+    return ParseYield();
   case TokenType::BREAK:
     return ParseBreak();
   case TokenType::CONTINUE:
@@ -221,6 +236,8 @@ std::unique_ptr<AST::BaseNode> Parser::ParseStatement() {
   case TokenType::IDENTIFIER:
     if (NextTokenIsOperation()) {
       return ParseAssignment();
+    } else if (IndexAssignmentFollows()) {
+      return ParseIndexAssignment();
     } else {
       std::unique_ptr<AST::BaseNode> expr = ParseBin();
       return std::move(expr);
@@ -258,6 +275,82 @@ std::unique_ptr<AST::BaseNode> Parser::ParseAssignment() {
                                           std::move(value));
 }
 
+// Whether the identifier at pos_ starts `name[...]...[...] op= value`.
+// Index expressions may contain brackets of their own, so the brackets are
+// matched instead of looking for the first ']'.
+bool Parser::IndexAssignmentFollows() {
+  size_t i = pos_ + 1;
+  if (i >= tokens_.size() || tokens_[i].GetType() != TokenType::L_BRACKET) {
+    return false;
+  }
+  while (i < tokens_.size() && tokens_[i].GetType() == TokenType::L_BRACKET) {
+    size_t depth = 0;
+    do {
+      TokenType type = tokens_[i].GetType();
+      if (type == TokenType::L_BRACKET) {
+        ++depth;
+      } else if (type == TokenType::R_BRACKET) {
+        --depth;
+      } else if (type == TokenType::EOFF) {
+        return false;
+      }
+      ++i;
+    } while (depth > 0 && i < tokens_.size());
+  }
+  if (i >= tokens_.size()) {
+    return false;
+  }
+  switch (tokens_[i].GetType()) {
+  case TokenType::ASSIGN:
+  case TokenType::PLUS_A:
+  case TokenType::MINUS_A:
+  case TokenType::MULTIPLY_A:
+  case TokenType::DIVIDE_A:
+  case TokenType::MOD_A:
+  case TokenType::POW_A:
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::unique_ptr<AST::BaseNode> Parser::ParseIndexAssignment() {
+  Token variable = Require({TokenType::IDENTIFIER});
+  std::vector<std::unique_ptr<AST::BaseNode>> indices;
+  while (Accept({TokenType::L_BRACKET})) {
+    indices.push_back(ParseBin());
+    Require({TokenType::R_BRACKET});
+  }
+  Token operation =
+  Require({TokenType::ASSIGN, TokenType::DIVIDE_A, TokenType::MINUS_A,
+               TokenType::MOD_A, TokenType::MULTIPLY_A, TokenType::PLUS_A,
+               TokenType::POW_A});
+  std::unique_ptr<AST::BaseNode> value = ParseBin();
+
+  return std::make_unique<AST::IndexAssignmentNode>(
+      operation, variable, std::move(indices), std::move(value));
+}
+
+std::unique_ptr<AST::DictNode> Parser::ParseDict() {
+  Require({TokenType::L_C_BRACKET});
+  std::vector<std::pair<std::unique_ptr<AST::BaseNode>,
+                        std::unique_ptr<AST::BaseNode>>>
+      entries;
+  while (pos_ < tokens_.size() &&
+         tokens_[pos_].GetType() != TokenType::R_C_BRACKET) {
+    if (tokens_[pos_].GetType() == TokenType::COMMA) {
+      ++pos_;
+      continue;
+    }
+    std::unique_ptr<AST::BaseNode> key = ParseBin();
+    Require({TokenType::COLON});
+    entries.emplace_back(std::move(key), ParseBin());
+  }
+  Require({TokenType::R_C_BRACKET});
+
+  return std::make_unique<AST::DictNode>(std::move(entries));
+}
+
 std::unique_ptr<AST::ReturnNode> Parser::ParseReturn() {
   Require({TokenType::RETURN});
   std::unique_ptr<AST::BaseNode> res;
@@ -270,6 +363,15 @@ std::unique_ptr<AST::ReturnNode> Parser::ParseReturn() {
   return std::make_unique<AST::ReturnNode>(std::move(res));
 }
 
+std::unique_ptr<AST::YieldNode> Parser::ParseYield() {
+  Require({TokenType::YIELD});
+  if (function_depth_ == 0) {
+    throw std::runtime_error("yield outside of a function at " +
+                             std::to_string(pos_));
+  }
+  return std::make_unique<AST::YieldNode>(ParseBin());
+}
+
 std::unique_ptr<AST::BreakNode> Parser::ParseBreak() {
   Require({TokenType::BREAK});
   return std::make_unique<AST::BreakNode>();
@@ -287,7 +389,8 @@ Parser::ParseCodeUntil(std::vector<TokenType>&&  end_token_types) {
   while ((pos_ < tokens_.size() - 1) &&
          std::find(end_token_types.begin(), end_token_types.end(),
                    tokens_[pos_].GetType()) == end_token_types.end()) {
-    block_node->AddNode(ParseStatement());
+    size_t first = pos_;
+    block_node->AddNode(Spanned(ParseStatement(), first));
   }
 
   return block_node;
@@ -367,7 +470,9 @@ std::unique_ptr<AST::FunctionNode> Parser::ParseFunction() {
   }
   Require({TokenType::R_S_BRACKET});
 
+  ++function_depth_;
   std::unique_ptr<AST::BlockNode> then = ParseCodeUntil({TokenType::END});
+  --function_depth_;
   Require({TokenType::END});
   Require({TokenType::FUNCTION});
 
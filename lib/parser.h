@@ -1,7 +1,9 @@
 #pragma once
 
 #include "ast.h"
+#include <algorithm>
 #include <map>
+#include <stack>
 
 class Parser {
 public:
@@ -14,6 +16,9 @@ private:
   size_t pos_;
   std::map<std::string, std::string> scope_;
   std::stack<TokenType> expected_;
+  // Number of function literals being parsed; yield is only valid inside
+  // one.
+  size_t function_depth_ = 0;
 
   Token Match(std::vector<TokenType>&& expected_types);
   Token Require(std::vector<TokenType>&& expected_types);
@@ -24,9 +29,13 @@ private:
   std::unique_ptr<AST::BaseNode> ParseBin(int max_priority = 0);
   std::unique_ptr<AST::BaseNode> ParseStatement();
   bool NextTokenIsOperation();
+  bool IndexAssignmentFollows();
 
   std::unique_ptr<AST::BaseNode> ParseAssignment();
+  std::unique_ptr<AST::BaseNode> ParseIndexAssignment();
+  std::unique_ptr<AST::DictNode> ParseDict();
   std::unique_ptr<AST::ReturnNode> ParseReturn();
+  std::unique_ptr<AST::YieldNode> ParseYield();
   std::unique_ptr<AST::BreakNode> ParseBreak();
   std::unique_ptr<AST::ContinueNode> ParseContinue();
   std::unique_ptr<AST::BlockNode>
@@ -40,9 +49,22 @@ private:
   ParseIndexAndSlice(std::unique_ptr<AST::BaseNode> var);
 
   bool Accept(std::vector<TokenType>&& valid_types);
+
+  // Gives `node` the span from the token at `first` to the last consumed
+  // one.
+  template <typename Node>
+  std::unique_ptr<Node> Spanned(std::unique_ptr<Node> node, size_t first) {
+    if (node != nullptr && pos_ > first) {
+      node->span = {tokens_[first].GetSpan().begin,
+                    tokens_[pos_ - 1].GetSpan().end};
+    }
+    return node;
+  }
 };
 
-static std::map<TokenType, int> priority{
+// Binary operator precedence. Read-only, so parsers on different threads
+// can share it.
+inline const std::map<TokenType, int> priority{
   {TokenType::OR, 1},         {TokenType::AND, 2},
   {TokenType::EQ, 3},         {TokenType::GREATER, 3},
   {TokenType::GREATER_EQ, 3}, {TokenType::LESS, 3},
@@ -0,0 +1,178 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// A sample is dropped when the stack keeps changing under the reader.
+constexpr int kSampleAttempts = 16;
+
+double Milliseconds(std::chrono::nanoseconds time) {
+  return std::chrono::duration<double, std::milli>(time).count();
+}
+
+} // namespace
+
+Profiler::Profiler(std::chrono::microseconds interval)
+    : interval_(std::max(interval, std::chrono::microseconds(1))) {
+  ids_.emplace("<script>", kScriptId);
+  names_.push_back("<script>");
+}
+
+Profiler::~Profiler() { Stop(); }
+
+void Profiler::Start() {
+  if (sampler_.joinable()) {
+    return;
+  }
+  stopping_ = false;
+  sampler_ = std::thread([this] { SamplerLoop(); });
+}
+
+void Profiler::Stop() {
+  if (!sampler_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  sampler_.join();
+}
+
+void Profiler::Enter(std::string_view name) {
+  uint32_t id;
+  if (auto it = ids_.find(name); it != ids_.end()) {
+    id = it->second;
+  } else {
+    id = uint32_t(names_.size());
+    ids_.emplace(name, id);
+    names_.emplace_back(name);
+  }
+
+  size_t depth = depth_.load(std::memory_order_relaxed);
+  uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (depth < kMaxDepth) {
+    frames_[depth].store(id, std::memory_order_relaxed);
+  }
+  depth_.store(depth + 1, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void Profiler::Leave() {
+  size_t depth = depth_.load(std::memory_order_relaxed);
+  if (depth == 0) {
+    return;
+  }
+  uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  depth_.store(depth - 1, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void Profiler::Sample(std::chrono::nanoseconds elapsed) {
+  for (int attempt = 0; attempt < kSampleAttempts; ++attempt) {
+    uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before % 2 != 0) {
+      continue;
+    }
+    size_t depth =
+        std::min(depth_.load(std::memory_order_relaxed), kMaxDepth);
+    scratch_.assign(1, kScriptId);
+    for (size_t i = 0; i < depth; ++i) {
+      scratch_.push_back(frames_[i].load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != before) {
+      continue;
+    }
+
+    auto it = stacks_.find(scratch_);
+    if (it == stacks_.end()) {
+      it = stacks_.emplace(scratch_, StackCount{}).first;
+    }
+    ++it->second.samples;
+    it->second.time += elapsed;
+    ++samples_;
+    return;
+  }
+}
+
+void Profiler::SamplerLoop() {
+  auto last = std::chrono::steady_clock::now();
+  std::unique_lock lock(mutex_);
+  while (!wake_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    auto now = std::chrono::steady_clock::now();
+    Sample(now - last);
+    last = now;
+  }
+}
+
+std::vector<Profiler::FunctionStats> Profiler::Functions() const {
+  std::vector<FunctionStats> stats(names_.size());
+  std::vector<bool> seen(names_.size());
+  for (const auto &[stack, count] : stacks_) {
+    FunctionStats &leaf = stats[stack.back()];
+    leaf.self_samples += count.samples;
+    leaf.self_time += count.time;
+    // Recursive functions count once per sample towards their total.
+    std::fill(seen.begin(), seen.end(), false);
+    for (uint32_t id : stack) {
+      if (!seen[id]) {
+        seen[id] = true;
+        stats[id].total_samples += count.samples;
+        stats[id].total_time += count.time;
+      }
+    }
+  }
+  for (size_t id = 0; id < stats.size(); ++id) {
+    stats[id].name = names_[id];
+  }
+
+  std::erase_if(stats,
+                [](const FunctionStats &s) { return s.total_samples == 0; });
+  std::stable_sort(stats.begin(), stats.end(),
+                   [](const FunctionStats &a, const FunctionStats &b) {
+                     return a.self_time > b.self_time;
+                   });
+  return stats;
+}
+
+void Profiler::WriteFolded(std::ostream &out) const {
+  for (const auto &[stack, count] : stacks_) {
+    for (size_t i = 0; i < stack.size(); ++i) {
+      if (i != 0) {
+        out << ';';
+      }
+      out << names_[stack[i]];
+    }
+    out << ' ' << count.samples << '\n';
+  }
+}
+
+void Profiler::WriteTop(std::ostream &out, size_t limit) const {
+  std::vector<FunctionStats> stats = Functions();
+  std::chrono::nanoseconds all{0};
+  for (const auto &[stack, count] : stacks_) {
+    all += count.time;
+  }
+  double all_ms = std::max(Milliseconds(all), 1e-9);
+
+  char line[160];
+  std::snprintf(line, sizeof(line), "%10s %7s %10s %7s  %s\n", "self ms",
+                "self %", "total ms", "total %", "function");
+  out << line;
+  for (size_t i = 0; i < stats.size() && i < limit; ++i) {
+    double self = Milliseconds(stats[i].self_time);
+    double total = Milliseconds(stats[i].total_time);
+    std::snprintf(line, sizeof(line), "%10.1f %6.1f%% %10.1f %6.1f%%  ", self,
+                  100 * self / all_ms, total, 100 * total / all_ms);
+    out << line << stats[i].name << '\n';
+  }
+  out << samples_ << " samples over " << Milliseconds(all) << " ms\n";
+}
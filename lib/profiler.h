@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Sampling profiler for ITMOScript functions. The interpreter reports every
+// call and return through Enter and Leave, which only write a function id
+// into a fixed array guarded by a sequence counter. A separate thread copies
+// that array once per interval and counts the stacks it sees, so the cost
+// on the script's thread does not depend on the sampling rate.
+//
+// A profiler follows the call stack of one interpreter at a time. Worker
+// threads of parallel builtins and spawned tasks are not sampled; their
+// time shows up in the builtin that waits for them.
+class Profiler {
+public:
+  struct FunctionStats {
+    std::string name;
+    uint64_t self_samples = 0;
+    uint64_t total_samples = 0;
+    std::chrono::nanoseconds self_time{0};
+    std::chrono::nanoseconds total_time{0};
+  };
+
+  explicit Profiler(
+      std::chrono::microseconds interval = std::chrono::microseconds(1000));
+  ~Profiler();
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  // Starts and stops the sampling thread. Results are read after Stop.
+  void Start();
+  void Stop();
+
+  // Called by the interpreter on the thread it runs on.
+  void Enter(std::string_view name);
+  void Leave();
+
+  // Records the current stack once, weighted by `elapsed`; the sampling
+  // thread calls this every interval.
+  void Sample(std::chrono::nanoseconds elapsed);
+
+  uint64_t Samples() const { return samples_; }
+
+  // Every function seen in a sample, the script's top level as "<script>",
+  // ordered by self time.
+  std::vector<FunctionStats> Functions() const;
+
+  // One line per distinct stack, outermost frame first, with its sample
+  // count: "<script>;main;parse 42". This is the input format of
+  // flamegraph.pl and speedscope.
+  void WriteFolded(std::ostream &out) const;
+
+  // Table of the `limit` functions with the most self time.
+  void WriteTop(std::ostream &out, size_t limit) const;
+
+private:
+  // Deeper frames are counted but not recorded; their samples go to the
+  // innermost recorded frame.
+  static constexpr size_t kMaxDepth = 256;
+  // Id of the script's top level, always the outermost frame.
+  static constexpr uint32_t kScriptId = 0;
+
+  struct StackCount {
+    uint64_t samples = 0;
+    std::chrono::nanoseconds time{0};
+  };
+
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+
+  void SamplerLoop();
+
+  std::chrono::microseconds interval_;
+
+  // Written only by the interpreter's thread. `sequence_` is odd while a
+  // write is in progress.
+  std::atomic<uint64_t> sequence_ = 0;
+  std::atomic<size_t> depth_ = 0;
+  std::array<std::atomic<uint32_t>, kMaxDepth> frames_{};
+
+  // Also only used by the interpreter's thread, except for reports.
+  std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>> ids_;
+  std::vector<std::string> names_;
+
+  // Written only by the sampling thread.
+  std::map<std::vector<uint32_t>, StackCount> stacks_;
+  std::vector<uint32_t> scratch_;
+  uint64_t samples_ = 0;
+
+  std::thread sampler_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+};
@@ -0,0 +1,203 @@
+#include "program_cache.h"
+
+#include "ast_serializer.h"
+#include "mapped_file.h"
+#include "parser.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+constexpr std::string_view kCacheMagic = "ISC\x01";
+
+// Magic, version, hash and size of the source, then the source itself: a
+// file is used only for the exact text it was written for, whatever the
+// hash of another script is.
+std::string EncodeHeader(std::string_view source) {
+  std::string header(kCacheMagic);
+  header.reserve(header.size() + kInterpreterVersion.size() + 17 +
+                 source.size());
+  header += kInterpreterVersion;
+  header.push_back('\0');
+
+  uint64_t hash = HashSource(source);
+  uint64_t size = source.size();
+  for (int i = 0; i < 8; ++i) {
+    header.push_back(static_cast<char>((hash >> (8 * i)) & 0xFF));
+  }
+  for (int i = 0; i < 8; ++i) {
+    header.push_back(static_cast<char>((size >> (8 * i)) & 0xFF));
+  }
+  header += source;
+  return header;
+}
+
+std::unique_ptr<AST::BlockNode> ParseSource(const std::string &source,
+                                            Tracer *tracer) {
+  std::vector<Token> tokens;
+  {
+    TraceScope traced(tracer, Tracer::Category::PHASE, "lex");
+    std::istringstream input(source);
+    tokens = Lexer(input).GetTokens();
+  }
+  TraceScope traced(tracer, Tracer::Category::PHASE, "parse");
+  Parser parser(std::move(tokens));
+  return parser.ParseCode();
+}
+
+std::unique_ptr<AST::BlockNode> ReadCacheFile(const std::string &path,
+                                              std::string_view source) {
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    return nullptr;
+  }
+
+  try {
+    MappedFile file(path);
+    std::string header = EncodeHeader(source);
+    std::string_view image = file.View();
+    if (!image.starts_with(header)) {
+      return nullptr;
+    }
+    return DeserializeProgram(image.substr(header.size()));
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+}
+
+void WriteCacheFile(const std::string &dir, const std::string &path,
+                    std::string_view source, const AST::BlockNode &root) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    return;
+  }
+
+  // Write under a unique name and rename, so concurrent runs of the same
+  // script never observe a half-written file.
+  std::string tmp = path + ".tmp" + std::to_string(std::random_device{}());
+  {
+    std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+    if (!fout) {
+      return;
+    }
+    std::string header = EncodeHeader(source);
+    std::string body = SerializeProgram(root);
+    fout.write(header.data(), header.size());
+    fout.write(body.data(), body.size());
+    if (!fout) {
+      fout.close();
+      std::filesystem::remove(tmp, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+} // namespace
+
+uint64_t HashSource(std::string_view source) {
+  // FNV-1a over the interpreter version and the source text.
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&hash](std::string_view data) {
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 1099511628211ull;
+    }
+  };
+  mix(kInterpreterVersion);
+  mix(source);
+  return hash;
+}
+
+std::string ProgramCache::CacheFileName(std::string_view source) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.isc",
+                static_cast<unsigned long long>(HashSource(source)));
+  return name;
+}
+
+ProgramCache &ProgramCache::Global() {
+  static ProgramCache cache(32);
+  return cache;
+}
+
+std::shared_ptr<AST::BlockNode>
+ProgramCache::Load(const std::string &source, const std::string &cache_dir,
+                   Tracer *tracer) {
+  TraceScope traced(tracer, Tracer::Category::PHASE, "compile");
+  uint64_t hash = HashSource(source);
+  if (auto root = Find(hash, source)) {
+    return root;
+  }
+
+  std::string path;
+  std::shared_ptr<AST::BlockNode> root;
+  if (!cache_dir.empty()) {
+    path = (std::filesystem::path(cache_dir) / CacheFileName(source)).string();
+    TraceScope traced(tracer, Tracer::Category::PHASE, "read cache");
+    root = ReadCacheFile(path, source);
+  }
+
+  if (root == nullptr) {
+    root = ParseSource(source, tracer);
+    if (!path.empty()) {
+      TraceScope traced(tracer, Tracer::Category::PHASE, "write cache");
+      WriteCacheFile(cache_dir, path, source, *root);
+    }
+  }
+
+  Insert(hash, source, root);
+  return root;
+}
+
+void ProgramCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+}
+
+size_t ProgramCache::Size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::shared_ptr<AST::BlockNode>
+ProgramCache::Find(uint64_t hash, const std::string &source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(hash);
+  if (it == index_.end() || it->second->source != source) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->root;
+}
+
+void ProgramCache::Insert(uint64_t hash, const std::string &source,
+                          std::shared_ptr<AST::BlockNode> root) {
+  if (capacity_ == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(hash);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  entries_.push_front(Entry{hash, source, std::move(root)});
+  index_[hash] = entries_.begin();
+
+  while (entries_.size() > capacity_) {
+    index_.erase(entries_.back().hash);
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ast.h"
+#include "tracer.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Bumped whenever the AST or its binary encoding changes, so stale cache
+// files written by another build are never loaded.
+inline constexpr std::string_view kInterpreterVersion = "itmoscript-6";
+
+uint64_t HashSource(std::string_view source);
+
+// Parsed programs keyed by the hash of their source text. Recently used
+// programs stay in memory (LRU); when a cache directory is given, programs
+// are also stored on disk and loaded back by mapping the file, which skips
+// lexing and parsing on the next run of the same script.
+class ProgramCache {
+public:
+  explicit ProgramCache(size_t capacity) : capacity_(capacity) {}
+
+  // Lexing, parsing and cache file reads and writes are recorded in
+  // `tracer` when it is set.
+  std::shared_ptr<AST::BlockNode> Load(const std::string &source,
+                                       const std::string &cache_dir = "",
+                                       Tracer *tracer = nullptr);
+
+  void Clear();
+  size_t Size();
+
+  static ProgramCache &Global();
+  static std::string CacheFileName(std::string_view source);
+
+private:
+  struct Entry {
+    uint64_t hash;
+    std::string source;
+    std::shared_ptr<AST::BlockNode> root;
+  };
+
+  size_t capacity_;
+  std::mutex mutex_;
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+
+  std::shared_ptr<AST::BlockNode> Find(uint64_t hash,
+                                       const std::string &source);
+  void Insert(uint64_t hash, const std::string &source,
+              std::shared_ptr<AST::BlockNode> root);
+};
@@ -1,17 +1,159 @@
 #include "scope.h"
 
-Value Scope::LookUp(const std::string& var) {
-    for (const auto& [key, val] : vars) {
-        if (key == var) return val;
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+
+thread_local uint64_t freezes = 0;
+
+void AddClosure(std::vector<std::shared_ptr<Scope>> &closures,
+                const Value &value) {
+    auto fn = std::get_if<std::shared_ptr<Function>>(&value);
+    if (fn == nullptr || (*fn)->closure == nullptr) return;
+    if (std::find(closures.begin(), closures.end(), (*fn)->closure) ==
+        closures.end()) {
+        closures.push_back((*fn)->closure);
+    }
+}
+
+}  // namespace
+
+Value *Scope::FindHere(const std::string& var) {
+    auto it = vars.find(var);
+    if (it != vars.end()) return &it->second;
+    for (const Layer *layer = frozen.get(); layer != nullptr;
+         layer = layer->below.get()) {
+        auto found = layer->vars.find(var);
+        if (found == layer->vars.end()) continue;
+        // Frozen values are already shared, so callers sharing them again
+        // do not write to the layer.
+        Value *value = const_cast<Value *>(&found->second);
+        // Threads reading the scope in parallel must not insert into
+        // `vars`; ShareAll copied such functions up front.
+        if (shared_readers == 0) {
+            if (auto copy = CopyOf(*value)) {
+                return &vars.emplace(var, Value(std::move(copy))).first->second;
+            }
+        }
+        return value;
+    }
+    return nullptr;
+}
+
+Scope *Scope::Owner(const std::string& var) {
+    Scope *previous = this;
+    for (Scope *scope = this; scope != nullptr; scope = scope->parent.get()) {
+        if (scope->FindHere(var) != nullptr) {
+            return scope->immutable ? previous : scope;
+        }
+        previous = scope;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Function> Scope::CopyOf(const Value& value) const {
+    if (copies == nullptr) return nullptr;
+    auto fn = std::get_if<std::shared_ptr<Function>>(&value);
+    if (fn == nullptr) return nullptr;
+    auto it = copies->find((*fn)->closure.get());
+    if (it == copies->end()) return nullptr;
+    auto copy = std::make_shared<Function>(**fn);
+    copy->closure = it->second.second;
+    return copy;
+}
+
+Value *Scope::Find(const std::string& var) {
+    for (Scope *scope = this; scope != nullptr; scope = scope->parent.get()) {
+        if (Value *value = scope->FindHere(var)) return value;
     }
-    if (parent) return parent->LookUp(var);
     throw std::runtime_error("No variable " + var);
 }
 
+Value *Scope::FindForWrite(const std::string& var) {
+    Scope *owner = Owner(var);
+    if (owner == nullptr) throw std::runtime_error("No variable " + var);
+    if (owner->shared_readers > 0) {
+        throw std::runtime_error("Can not assign to " + var +
+                                 " while it is shared between threads");
+    }
+    // A frozen or builtin value is copied into `vars` before it is changed.
+    return &owner->vars.try_emplace(var, *Find(var)).first->second;
+}
+
+Value Scope::LookUp(const std::string& var) {
+    return *Find(var);
+}
+
 void Scope::Assign(const std::string& var, const Value& value) {
-    if (vars.count(var) || !parent) {
-        vars[var] = value;
+    Scope *owner = Owner(var);
+    (owner != nullptr ? owner : this)->Define(var, value);
+}
+
+void Scope::Define(const std::string& var, const Value& value) {
+    if (shared_readers > 0) {
+        throw std::runtime_error("Can not assign to " + var +
+                                 " while it is shared between threads");
+    }
+    if (immutable) {
+        throw std::runtime_error("Can not assign to builtin " + var);
+    }
+    vars[var] = value;
+}
+
+void Scope::ShareAll() {
+    for (auto &[name, value] : vars) {
+        value.Share();
+    }
+    if (copies == nullptr) return;
+    std::unordered_set<std::string_view> seen;
+    for (const auto &[name, value] : vars) seen.insert(name);
+    for (const Layer *layer = frozen.get(); layer != nullptr;
+         layer = layer->below.get()) {
+        for (const auto &[name, value] : layer->vars) {
+            if (!seen.insert(name).second) continue;
+            if (auto copy = CopyOf(value)) {
+                vars.emplace(name, Value(std::move(copy)));
+            }
+        }
+    }
+}
+
+std::shared_ptr<const Scope::Layer> Scope::Freeze() {
+    if (vars.empty()) return frozen;
+
+    auto layer = std::make_shared<Layer>();
+    layer->below = frozen;
+    if (shared_readers > 0) {
+        // Other threads are reading `vars`, which SharedScopes has already
+        // shared; the copy is for the snapshot alone.
+        layer->vars = vars;
     } else {
-        parent->Assign(var, value);
+        for (auto &[name, value] : vars) {
+            value.Share();
+        }
+        layer->vars = std::move(vars);
+        vars.clear();
+        ++freezes;
+        // Layers not much larger than the new one are merged into it, so a
+        // scope frozen over and over keeps a logarithmic number of layers.
+        while (layer->below != nullptr &&
+               layer->below->vars.size() <= 2 * layer->vars.size()) {
+            layer->vars.insert(layer->below->vars.begin(),
+                               layer->below->vars.end());
+            layer->below = layer->below->below;
+        }
     }
+
+    if (layer->below != nullptr) layer->closures = layer->below->closures;
+    for (const auto &[name, value] : layer->vars) {
+        AddClosure(layer->closures, value);
+    }
+    if (shared_readers == 0) frozen = layer;
+    return layer;
+}
+
+uint64_t Scope::Freezes() {
+    return freezes;
 }
@@ -1,19 +1,81 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "value.h"
 #include "function.h"
 
 struct Scope {
+  // Variables frozen by Freeze(), shared read-only by the scope and the
+  // copies spawned tasks made of it. Their values are shared (see
+  // Value::Share), so reading them does not modify them.
+  struct Layer {
+    std::map<std::string, Value> vars;
+    // Older variables; those in `vars` hide the ones of the same name.
+    std::shared_ptr<const Layer> below;
+    // Closures of the functions in this layer and below, which a copy of
+    // the scope has to copy too.
+    std::vector<std::shared_ptr<Scope>> closures;
+  };
+
+  // Scopes of a spawner mapped to their copies in the snapshot of a task.
+  // The originals are kept so their addresses are not reused.
+  using CopyMap =
+      std::unordered_map<const Scope *, std::pair<std::shared_ptr<Scope>,
+                                                  std::shared_ptr<Scope>>>;
+
+  // Variables assigned since the scope was last frozen.
   std::map<std::string, Value> vars;
+  std::shared_ptr<const Layer> frozen;
   std::shared_ptr<Scope> parent;
   std::map<std::string, Function> functions;
+  // Number of parallel sections reading this scope from several threads.
+  // Its variables can not be assigned while it is positive.
+  std::atomic<int> shared_readers = 0;
+  // Set on the builtins of an isolate once they are added. Snapshots share
+  // the scope instead of copying it, and assigning to a builtin's name
+  // defines the name in the scope below.
+  bool immutable = false;
+  // For a copy made by a snapshot: the copies that functions read from
+  // `frozen` are pointed at.
+  std::shared_ptr<const CopyMap> copies;
 
   Value LookUp(const std::string &var);
+  // Storage of a visible variable; throws if there is none.
+  Value *Find(const std::string &var);
+  // Like Find, for modifying the variable in place. Throws if its scope is
+  // shared between threads.
+  Value *FindForWrite(const std::string &var);
+  // Assigns to the innermost visible variable named `var`, or creates it
+  // in this scope.
   void Assign(const std::string &var, const Value &value);
+  // Defines `var` in this scope, hiding outer variables of the same name.
+  void Define(const std::string &var, const Value &value);
+  // Moves large values into shared buffers (see Value::Share), after which
+  // reading the variables no longer modifies them.
+  void ShareAll();
+  // Layers holding every variable of the scope, for a snapshot. Moves
+  // `vars` into a new layer unless other threads are reading them.
+  std::shared_ptr<const Layer> Freeze();
+  // Number of times Freeze() moved variables on this thread. Pointers
+  // returned by FindForWrite stay valid while it does not change.
+  static uint64_t Freezes();
 
   Scope(std::shared_ptr<Scope> parentScope) : parent(std::move(parentScope)) {}
 
   Scope() = default;
+
+private:
+  // Storage of `var` in this scope alone, or nullptr.
+  Value *FindHere(const std::string &var);
+  // Scope that assigning to the visible variable `var` writes to, or
+  // nullptr if there is none.
+  Scope *Owner(const std::string &var);
+  // `value` pointed at the copy of its closure, if it is a function of
+  // the spawner; nullptr otherwise.
+  std::shared_ptr<Function> CopyOf(const Value &value) const;
 };
@@ -0,0 +1,35 @@
+#include "simd.h"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<SimdLevel> &CurrentLevel() {
+  static std::atomic<SimdLevel> level = DetectSimdLevel();
+  return level;
+}
+
+} // namespace
+
+SimdLevel DetectSimdLevel() {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SimdLevel::SSE2;
+  }
+#endif
+  return SimdLevel::SCALAR;
+}
+
+SimdLevel GetSimdLevel() {
+  return CurrentLevel().load(std::memory_order_relaxed);
+}
+
+void SetSimdLevel(SimdLevel level) {
+  SimdLevel supported = DetectSimdLevel();
+  CurrentLevel().store(level < supported ? level : supported,
+                       std::memory_order_relaxed);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#define ITMOSCRIPT_HAS_X86_SIMD 1
+#endif
+
+// Instruction sets the vector kernels can use. On x86 they process 16 (SSE2)
+// or 32 (AVX2) bytes per step; the widest level the CPU supports is picked
+// at startup and a scalar version is used everywhere else.
+enum struct SimdLevel { SCALAR, SSE2, AVX2 };
+
+// Widest level supported by this CPU.
+SimdLevel DetectSimdLevel();
+
+SimdLevel GetSimdLevel();
+
+// Restricts the kernels to `level` (clamped to DetectSimdLevel()). Meant for
+// tests and benchmarks that compare implementations.
+void SetSimdLevel(SimdLevel level);
@@ -1,11 +1,348 @@
 #include "standart_library_func.h"
+#include "array_kernels.h"
+#include "dict.h"
+#include "mapped_file.h"
+#include "memory_stats.h"
+#include "number_format.h"
+#include "number_ops.h"
+#include "string_kernels.h"
+#include "thread_pool.h"
+#include "value_sort.h"
+
+namespace {
+
+// The input source hands every line to exactly one reader, so the iterator
+// can be pulled from several threads.
+class LineIterator : public Iterator {
+public:
+  LineIterator(InputSource &input) : input_(input) {}
+
+  bool Next(Value &out) override {
+    std::string line;
+    if (!input_.ReadLine(line)) {
+      return false;
+    }
+    out = std::move(line);
+    return true;
+  }
+
+private:
+  InputSource &input_;
+};
+
+// Hands out the lines of a mapped file as slices of the mapping. Like
+// LineIterator, each line goes to exactly one caller of Next().
+class MappedLineIterator : public Iterator {
+public:
+  MappedLineIterator(std::shared_ptr<MappedFile> file)
+      : file_(std::move(file)), pos_(0) {}
+
+  bool Next(Value &out) override {
+    std::string_view data = file_->View();
+    size_t begin;
+    size_t end;
+    {
+      std::lock_guard lock(mutex_);
+      if (pos_ >= data.size()) {
+        return false;
+      }
+      begin = pos_;
+      end = data.find('\n', pos_);
+      if (end == std::string_view::npos) {
+        end = data.size();
+      }
+      pos_ = end + 1;
+    }
+    out = StringSlice{file_, data.substr(begin, end - begin), data.size()};
+    return true;
+  }
+
+private:
+  std::shared_ptr<MappedFile> file_;
+  std::mutex mutex_;
+  size_t pos_;
+};
+
+// Calls f(element) for every element of a list, or of an iterator pulled
+// one element at a time; f returns false to stop early.
+template <class F> void ForEachElement(const Value &iterable, F f) {
+  if (iterable.IsList()) {
+    for (const Value &el : iterable.GetListView()) {
+      if (!f(el)) {
+        return;
+      }
+    }
+    return;
+  }
+  if (auto it = std::get_if<std::shared_ptr<Iterator>>(&iterable)) {
+    Value el;
+    while ((*it)->Next(el)) {
+      if (!f(el)) {
+        return;
+      }
+    }
+    return;
+  }
+  if (auto array = std::get_if<NumberArray>(&iterable)) {
+    for (double el : array->View()) {
+      if (!f(Value(el))) {
+        return;
+      }
+    }
+    return;
+  }
+  if (auto dict = std::get_if<Dict>(&iterable)) {
+    size_t position = 0;
+    while (const Value *key = dict->table->NextKey(position)) {
+      if (!f(*key)) {
+        return;
+      }
+    }
+    return;
+  }
+  throw std::runtime_error("Argument must be a list or an iterator");
+}
+
+// Table of the dict passed as the first of `count` arguments of `name`.
+const DictTable &DictArg(const std::vector<Value> &args, size_t count,
+                         const std::string &name) {
+  if (args.size() != count) {
+    throw std::runtime_error(name + " needs " +
+                             (count == 1 ? "one argument" : "two arguments"));
+  }
+  auto dict = std::get_if<Dict>(&args[0]);
+  if (dict == nullptr) {
+    throw std::runtime_error("Argument must be a dict");
+  }
+  return *dict->table;
+}
 
-void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
+void WriteFile(const std::vector<Value> &args, bool append) {
+  if (args.size() != 2 || !args[0].IsString()) {
+    throw std::runtime_error("Expected a file name and a value");
+  }
+
+  FileSink file(std::string(args[0].GetStringView()), append);
+  Interpret::Print(args[1], file);
+  file.Flush();
+}
+
+struct RandomSource {
+  std::mutex mutex;
+  std::mt19937 gen{std::random_device{}()};
+};
+
+// Scopes a parallel builtin's function can read: the chain it was defined
+// in, up to the builtins. Their values are shared up front, so reading them
+// from worker threads does not modify them, and assigning to them fails
+// until the parallel section ends. Iterators stay shared, so workers pulling
+// from the same one split its elements between them.
+class SharedScopes {
+public:
+  explicit SharedScopes(const Value &func) {
+    if (auto fn = std::get_if<std::shared_ptr<Function>>(&func)) {
+      Add((*fn)->closure.get());
+    }
+  }
+
+  ~SharedScopes() {
+    for (Scope *scope : scopes_) {
+      --scope->shared_readers;
+    }
+  }
+
+private:
+  void Add(Scope *scope) {
+    // Builtins are never written, so they need no sharing.
+    for (; scope != nullptr && !scope->immutable;
+         scope = scope->parent.get()) {
+      if (scope->shared_readers++ == 0) {
+        scope->ShareAll();
+      }
+      scopes_.push_back(scope);
+    }
+  }
+
+  std::vector<Scope *> scopes_;
+};
+
+// Runs body(worker, i) for every i in [0, n) on the thread pool. Each chunk
+// gets its own interpreter whose output is buffered, and the buffers are
+// written out in input order afterwards, so output does not depend on
+// scheduling.
+void ForEachParallel(
+    size_t n, const Value &func, OutputSink &output,
+    const std::function<void(Interpret &, size_t)> &body) {
+  SharedScopes shared(func);
+  std::shared_ptr<Scope> closure;
+  if (auto fn = std::get_if<std::shared_ptr<Function>>(&func)) {
+    closure = (*fn)->closure;
+  }
+
+  // Workers count their steps against the budget of the calling script.
+  ExecutionBudget *budget = Interpret::CurrentBudget();
+  std::mutex mutex;
+  std::vector<std::pair<size_t, std::string>> printed;
+  auto flush = [&] {
+    std::sort(printed.begin(), printed.end(),
+              [](auto &a, auto &b) { return a.first < b.first; });
+    OutputSink &out = Interpret::CurrentOutput(output);
+    for (auto &[begin, text] : printed) {
+      out.Write(text);
+    }
+  };
+
+  try {
+    ThreadPool::Global().ParallelFor(n, [&](size_t begin, size_t end) {
+      StringSink sink;
+      Interpret worker(nullptr, closure, sink);
+      worker.SetBudget(budget);
+      try {
+        for (size_t i = begin; i < end; ++i) {
+          body(worker, i);
+        }
+        worker.JoinTasks();
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        printed.emplace_back(begin, sink.Take());
+        throw;
+      }
+      if (!sink.Str().empty()) {
+        std::lock_guard lock(mutex);
+        printed.emplace_back(begin, sink.Take());
+      }
+    });
+  } catch (...) {
+    flush();
+    throw;
+  }
+  flush();
+}
+
+// Result of an awaited task. Its output goes to the awaiting script first,
+// also when the task failed.
+Value AwaitTask(const Value &handle, OutputSink &output) {
+  auto task = std::get_if<std::shared_ptr<Task>>(&handle);
+  if (task == nullptr) {
+    throw std::runtime_error("Argument must be a task");
+  }
+  (*task)->Join();
+  Interpret::CurrentOutput(output).Write((*task)->TakeOutput());
+  return (*task)->Result();
+}
+
+// Number argument of a math builtin as a double.
+double NumberArg(const Value &v) {
+  if (!v.IsNumber()) {
+    throw std::runtime_error("Argument must be a number");
+  }
+  return v.GetNumber();
+}
+
+// Elements of a float64 array, or of a list of numbers copied into
+// `storage`.
+std::span<const double> NumbersOf(const Value &v,
+                                  std::vector<double> &storage) {
+  if (auto array = std::get_if<NumberArray>(&v)) {
+    return array->View();
+  }
+  if (!v.IsList()) {
+    throw std::runtime_error("Argument must be an array or a list");
+  }
+  std::span<const Value> list = v.GetListView();
+  storage.resize(list.size());
+  if (v.ListKind() == ElementKind::NUMBER) {
+    for (size_t i = 0; i < list.size(); ++i) {
+      storage[i] = list[i].GetNumber();
+    }
+    return storage;
+  }
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (!list[i].IsNumber()) {
+      throw std::runtime_error("Argument must be a list of numbers");
+    }
+    storage[i] = list[i].GetNumber();
+  }
+  return storage;
+}
+
+// min(values) and max(values) of an array or a list of numbers.
+std::function<Value(const std::vector<Value> &)>
+MakeExtremum(const char *name, double (*pick)(std::span<const double>)) {
+  return [name, pick](const std::vector<Value> &args) -> Value {
+    if (args.size() != 1) {
+      throw std::runtime_error(std::string(name) + " needs one argument");
+    }
+    std::vector<double> storage;
+    std::span<const double> values = NumbersOf(args[0], storage);
+    if (values.empty()) {
+      throw std::runtime_error(std::string(name) + " of an empty array");
+    }
+    return pick(values);
+  };
+}
+
+// Counters as a dict for mem_stats().
+Dict CountersDict(const MemoryStats::Counters &c) {
+  Dict dict;
+  DictTable &table = DictTable::Writable(dict);
+  table.Set(std::string("allocations"), int64_t(c.allocations));
+  table.Set(std::string("bytes"), int64_t(c.bytes));
+  table.Set(std::string("live_allocations"), int64_t(c.live_allocations));
+  table.Set(std::string("live_bytes"), int64_t(c.live_bytes));
+  table.Set(std::string("peak_bytes"), int64_t(c.peak_bytes));
+  return dict;
+}
+
+Value CheckFunctionArgs(const std::vector<Value> &args, const char *name) {
+  if (args.size() < 2) {
+    throw std::runtime_error(std::string(name) + " needs a list and a function");
+  }
+  if (!args[0].IsList()) {
+    throw std::runtime_error("Argument must be a list");
+  }
+  return args[0];
+}
+
+// sort(list) and sort(list, key). A key function is called once per
+// element and the elements are ordered by the results.
+std::function<Value(const std::vector<Value> &)> MakeSort(bool stable) {
+  return [stable](const std::vector<Value> &args) -> Value {
+    if (args.size() != 1 && args.size() != 2) {
+      throw std::runtime_error("sort needs one or two arguments");
+    }
+
+    if (!args[0].IsList()) {
+      throw std::runtime_error("Argument must be a list");
+    }
+    std::vector<Value> v = args[0].CopyList();
+
+    if (args.size() == 1) {
+      ElementKind kind = args[0].ListKind();
+      SortValues(v, nullptr, stable, kind);
+      return Value::MakeList(std::move(v), kind);
+    }
+
+    std::vector<Value> keys;
+    keys.reserve(v.size());
+    for (const Value &el : v) {
+      keys.push_back(Interpret::CallFunction(args[1], {el}));
+    }
+    SortValues(v, &keys, stable);
+    return Value::MakeList(std::move(v), args[0].ListKind());
+  };
+}
+
+} // namespace
+
+void AddSystemFunction(std::shared_ptr<Scope> global, OutputSink &output,
+                       InputSource &input) {
   global->Assign("print",
                  std::function<Value(const std::vector<Value> &)>{
                      [&output](const std::vector<Value> &args) -> Value {
+                       OutputSink &out = Interpret::CurrentOutput(output);
                        for (const auto &v : args) {
-                         Interpret::Print(v, output);
+                         Interpret::Print(v, out);
                        }
                        return nullptr;
                      }});
@@ -13,10 +350,11 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
   global->Assign("println",
                  std::function<Value(const std::vector<Value> &)>{
                      [&output](const std::vector<Value> &args) -> Value {
+                       OutputSink &out = Interpret::CurrentOutput(output);
                        for (const auto &v : args) {
-                         Interpret::Print(v, output);
+                         Interpret::Print(v, out);
                        }
-                       output << std::endl;
+                       out.Write("\n");
                        return nullptr;
                      }});
 
@@ -27,9 +365,14 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                          throw std::runtime_error("No argument for abs");
                        }
 
+                       auto i = std::get_if<int64_t>(&args[0]);
+                       if (i != nullptr && *i != INT64_MIN) {
+                         return std::abs(*i);
+                       }
+
                        double res;
                        try {
-                         res = std::abs(std::get<double>(args[0]));
+                         res = std::abs(NumberArg(args[0]));
                        } catch (const std::exception &e) {
                          throw std::runtime_error("Argument must be a number");
                        }
@@ -44,9 +387,13 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                          throw std::runtime_error("No argument for ceil");
                        }
 
+                       if (std::holds_alternative<int64_t>(args[0])) {
+                         return args[0];
+                       }
+
                        double res;
                        try {
-                         res = std::ceil(std::get<double>(args[0]));
+                         res = std::ceil(NumberArg(args[0]));
                        } catch (const std::exception &e) {
                          throw std::runtime_error("Argument must be a number");
                        }
@@ -61,9 +408,13 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                        throw std::runtime_error("No argument for floor");
                      }
 
+                     if (std::holds_alternative<int64_t>(args[0])) {
+                       return args[0];
+                     }
+
                      double res;
                      try {
-                       res = std::floor(std::get<double>(args[0]));
+                       res = std::floor(NumberArg(args[0]));
                      } catch (const std::exception &e) {
                        throw std::runtime_error("Argument must be a number");
                      }
@@ -78,9 +429,13 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                        throw std::runtime_error("No argument for round");
                      }
 
+                     if (std::holds_alternative<int64_t>(args[0])) {
+                       return args[0];
+                     }
+
                      double res;
                      try {
-                       res = std::round(std::get<double>(args[0]));
+                       res = std::round(NumberArg(args[0]));
                      } catch (const std::exception &e) {
                        throw std::runtime_error("Argument must be a number");
                      }
@@ -97,7 +452,7 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
 
                        double res;
                        try {
-                         res = std::sqrt(std::get<double>(args[0]));
+                         res = std::sqrt(NumberArg(args[0]));
                        } catch (const std::exception &e) {
                          throw std::runtime_error("Argument must be a number");
                        }
@@ -105,20 +460,22 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                        return Value(res);
                      }});
 
+  // Every global scope (one per isolate) gets its own generator.
+  auto random = std::make_shared<RandomSource>();
   global->Assign("rnd",
                  std::function<Value(const std::vector<Value> &)>{
-                     [&output](const std::vector<Value> &args) -> Value {
+                     [random](const std::vector<Value> &args) -> Value {
                        if (args.size() != 1) {
                          throw std::runtime_error("No argument for rnd");
                        }
 
                        double res;
                        try {
-                         res = std::get<double>(args[0]);
-                         static std::mt19937 gen(std::random_device{}());
+                         res = NumberArg(args[0]);
                          std::uniform_int_distribution<> dist(0, res - 1);
-                         int result = dist(gen);
-                         return Value(static_cast<double>(result));
+                         std::lock_guard lock(random->mutex);
+                         int result = dist(random->gen);
+                         return Value(static_cast<int64_t>(result));
 
                        } catch (const std::exception &e) {
                          throw std::runtime_error("Argument must be a number");
@@ -133,11 +490,15 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                              "parse_num needs one argument");
                        }
 
+                       if (!args[0].IsString()) {
+                         return Value(nullptr);
+                       }
+                       int64_t integer;
+                       if (ParseInteger(args[0].GetStringView(), integer)) {
+                         return Value(integer);
+                       }
                        double res;
-                       try {
-                         res = std::stod(std::get<std::string>(args[0]));
-
-                       } catch (const std::exception &e) {
+                       if (!ParseNumber(args[0].GetStringView(), res)) {
                          return Value(nullptr);
                        }
 
@@ -149,18 +510,18 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                      [&output](const std::vector<Value> &args) -> Value {
                        if (args.size() != 1) {
                          throw std::runtime_error(
-                             "parse_num needs one argument");
+                             "to_string needs one argument");
                        }
 
-                       std::string res;
-                       try {
-                         res = std::to_string(std::get<double>(args[0]));
-
-                       } catch (const std::exception &e) {
+                       if (auto i = std::get_if<int64_t>(&args[0])) {
+                         return Value(NumberToString(*i));
+                       }
+                       auto d = std::get_if<double>(&args[0]);
+                       if (d == nullptr) {
                          throw std::runtime_error("Argument must be a number");
                        }
 
-                       return Value(res);
+                       return Value(NumberToString(*d));
                      }});
 
   global->Assign(
@@ -171,31 +532,28 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
               throw std::runtime_error("len needs one argument");
             }
 
-            double res;
+            int64_t res;
 
-            if (std::holds_alternative<std::string>(args[0])) {
-              try {
-                res = (std::get<std::string>(args[0])).length();
-
-              } catch (const std::exception &e) {
-                throw std::runtime_error("Argument must be a string or a list");
-              }
+            if (args[0].IsString()) {
+              res = args[0].GetStringView().length();
 
               return Value(res);
             }
 
-            if (std::holds_alternative<std::vector<Value>>(args[0])) {
-              try {
-                res = (std::get<std::vector<Value>>(args[0])).size();
-
-              } catch (const std::exception &e) {
-                throw std::runtime_error(
-                    "Argument must be a string or a list");
-              }
+            if (args[0].IsList()) {
+              res = args[0].GetListView().size();
 
               return Value(res);
             }
 
+            if (auto array = std::get_if<NumberArray>(&args[0])) {
+              return Value(int64_t(array->size));
+            }
+
+            if (auto dict = std::get_if<Dict>(&args[0])) {
+              return Value(int64_t(dict->table->Size()));
+            }
+
             throw std::runtime_error("Argument must be a string or a list");
           }});
 
@@ -206,18 +564,11 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                        throw std::runtime_error("lower needs one argument");
                      }
 
-                     std::string s, res = "";
-                     try {
-                       s = (std::get<std::string>(args[0]));
-                       for (int i = 0; i < s.length(); ++i) {
-                         res += std::tolower(s[i]);
-                       }
-
-                     } catch (const std::exception &e) {
+                     if (!args[0].IsString()) {
                        throw std::runtime_error("Argument must be a string");
                      }
 
-                     return Value(res);
+                     return Value(ToLowerUtf8(args[0].GetStringView()));
                    }});
 
   global->Assign(
@@ -227,18 +578,11 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                        throw std::runtime_error("upper needs one argument");
                      }
 
-                     std::string s, res = "";
-                     try {
-                       s = (std::get<std::string>(args[0]));
-                       for (int i = 0; i < s.length(); ++i) {
-                         res += std::toupper(s[i]);
-                       }
-
-                     } catch (const std::exception &e) {
+                     if (!args[0].IsString()) {
                        throw std::runtime_error("Argument must be a string");
                      }
 
-                     return Value(res);
+                     return Value(ToUpperUtf8(args[0].GetStringView()));
                    }});
 
   global->Assign(
@@ -249,25 +593,39 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
               throw std::runtime_error("split needs two arguments");
             }
 
-            std::string s, delim;
+            if (!args[0].IsString() || !args[1].IsString()) {
+              throw std::runtime_error("Argument must be a string");
+            }
+
+            // Parts are slices of one shared copy of the source.
+            Value source = args[0];
+            source.Share();
+            std::string_view s = source.GetStringView();
+            std::string_view delim = args[1].GetStringView();
             std::vector<Value> parts;
-            try {
-              s = std::get<std::string>(args[0]);
-              delim = std::get<std::string>(args[1]);
-
-              size_t pos = 0, next;
-              while ((next = s.find(delim, pos)) != std::string::npos) {
-                parts.emplace_back(s.substr(pos, next - pos));
-                pos = next + delim.size();
-              }
 
-              parts.emplace_back(s.substr(pos));
+            // An empty delimiter splits the string into characters.
+            if (delim.empty()) {
+              for (size_t pos = 0; pos < s.size();) {
+                size_t len = Utf8SequenceLength(s.substr(pos));
+                if (len == 0) {
+                  throw std::runtime_error("String is not valid UTF-8");
+                }
+                parts.push_back(source.Slice(pos, len, true));
+                pos += len;
+              }
+              return Value::MakeList(std::move(parts), ElementKind::STRING);
+            }
 
-            } catch (const std::exception &e) {
-              throw std::runtime_error("Argument must be a string");
+            size_t pos = 0, next;
+            while ((next = FindSubstring(s, delim, pos)) != std::string::npos) {
+              parts.push_back(source.Slice(pos, next - pos, true));
+              pos = next + delim.size();
             }
 
-            return Value(std::move(parts));
+            parts.push_back(source.Slice(pos, s.size() - pos, true));
+
+            return Value::MakeList(std::move(parts), ElementKind::STRING);
           }});
 
   global->Assign("join",
@@ -277,23 +635,46 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                          throw std::runtime_error("join needs two arguments");
                        }
 
-                       std::string res = "", delim;
-                       std::vector<Value> v;
-                       try {
-                         v = std::get<std::vector<Value>>(args[0]);
-                         delim = std::get<std::string>(args[1]);
+                       if (!args[1].IsString()) {
+                         throw std::runtime_error("Argument must be a string");
+                       }
 
-                         for (int i = 0; i < v.size(); ++i) {
-                           res += std::get<std::string>(v[i]);
-                           if (i != v.size() - 1) {
+                       std::string res = "";
+                       std::string_view delim = args[1].GetStringView();
+
+                       // Lists known to hold only strings are joined into a
+                       // buffer of the final size, without type checks.
+                       if (args[0].IsList() &&
+                           args[0].ListKind() == ElementKind::STRING) {
+                         std::span<const Value> parts = args[0].GetListView();
+                         size_t size = delim.size() * (parts.size() - 1);
+                         for (const Value &part : parts) {
+                           size += part.GetStringView().size();
+                         }
+                         res.reserve(size);
+                         for (size_t i = 0; i < parts.size(); ++i) {
+                           if (i != 0) {
                              res += delim;
                            }
+                           res += parts[i].GetStringView();
                          }
-
-                       } catch (const std::exception &e) {
-                         throw std::runtime_error("Argument must be a string");
+                         return Value(std::move(res));
                        }
 
+                       bool first = true;
+                       ForEachElement(args[0], [&](const Value &el) {
+                         if (!el.IsString()) {
+                           throw std::runtime_error(
+                               "Argument must be a string");
+                         }
+                         if (!first) {
+                           res += delim;
+                         }
+                         res += el.GetStringView();
+                         first = false;
+                         return true;
+                       });
+
                        return Value(res);
                      }});
 
@@ -305,24 +686,34 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                              "replace needs three arguments");
                        }
 
-                       std::string res = "", s, old, new_s;
-                       try {
-                         s = std::get<std::string>(args[0]);
-                         old = std::get<std::string>(args[1]);
-                         new_s = std::get<std::string>(args[2]);
-
-                         size_t pos = 0;
-                         while ((pos = s.find(old, pos)) != std::string::npos) {
-                           s.replace(pos, old.length(), new_s);
-                           pos += new_s.length();
-                         }
-
-                       } catch (const std::exception &e) {
+                       if (!args[0].IsString() || !args[1].IsString() ||
+                           !args[2].IsString()) {
                          throw std::runtime_error(
                              "Argument must be a string or a non-empty list");
                        }
 
-                       return Value(std::move(s));
+                       return Value(ReplaceAll(args[0].GetStringView(),
+                                               args[1].GetStringView(),
+                                               args[2].GetStringView()));
+                     }});
+
+  global->Assign("find",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&output](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 2) {
+                         throw std::runtime_error("find needs two arguments");
+                       }
+
+                       if (!args[0].IsString() || !args[1].IsString()) {
+                         throw std::runtime_error("Argument must be a string");
+                       }
+
+                       size_t pos = FindSubstring(args[0].GetStringView(),
+                                                  args[1].GetStringView());
+                       if (pos == std::string_view::npos) {
+                         return int64_t(-1);
+                       }
+                       return static_cast<int64_t>(pos);
                      }});
 
   global->Assign(
@@ -335,10 +726,25 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                      double first, last, step;
 
                      std::vector<Value> res;
+                     int64_t ifirst, ilast, istep;
+                     if (std::holds_alternative<int64_t>(args[0]) &&
+                         GetInteger(args[1], ilast) &&
+                         GetInteger(args[2], istep) && istep != 0) {
+                       ifirst = std::get<int64_t>(args[0]);
+                       for (int64_t i = ifirst; i < ilast;) {
+                         res.push_back(i);
+                         if (__builtin_add_overflow(i, istep, &i)) {
+                           break;
+                         }
+                       }
+                       return Value::MakeList(std::move(res),
+                                              ElementKind::NUMBER);
+                     }
+
                      try {
-                       first = std::get<double>(args[0]);
-                       last = std::get<double>(args[1]);
-                       step = std::get<double>(args[2]);
+                       first = NumberArg(args[0]);
+                       last = NumberArg(args[1]);
+                       step = NumberArg(args[2]);
 
                        if (step == 0) {
                          throw std::runtime_error("Step can not be 0");
@@ -353,9 +759,97 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                            "Range must be numeric");
                      }
 
-                     return Value(std::move(res));
+                     return Value::MakeList(std::move(res),
+                                            ElementKind::NUMBER);
                    }});
 
+  global->Assign("array",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.empty() || args.size() > 2 ||
+                           !args[0].IsNumber() ||
+                           (args.size() == 2 && !args[1].IsNumber())) {
+                         throw std::runtime_error(
+                             "array needs a size and an optional value");
+                       }
+                       int64_t size;
+                       if (!GetInteger(args[0], size) || size < 0) {
+                         throw std::runtime_error(
+                             "Size must be a non-negative integer");
+                       }
+                       double fill = args.size() == 2 ? args[1].GetNumber() : 0;
+                       double *out;
+                       NumberArray array =
+                           NumberArray::Allocate(static_cast<size_t>(size),
+                                                 out);
+                       std::fill(out, out + array.size, fill);
+                       return array;
+                     }});
+
+  global->Assign("to_array",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1) {
+                         throw std::runtime_error("to_array needs a list");
+                       }
+                       if (std::holds_alternative<NumberArray>(args[0])) {
+                         return args[0];
+                       }
+                       std::vector<double> storage;
+                       std::span<const double> values =
+                           NumbersOf(args[0], storage);
+                       double *out;
+                       NumberArray array =
+                           NumberArray::Allocate(values.size(), out);
+                       std::copy(values.begin(), values.end(), out);
+                       return array;
+                     }});
+
+  global->Assign("to_list",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1 ||
+                           !std::holds_alternative<NumberArray>(args[0])) {
+                         throw std::runtime_error("to_list needs an array");
+                       }
+                       std::span<const double> values =
+                           std::get<NumberArray>(args[0]).View();
+                       return Value::MakeList(
+                           std::vector<Value>(values.begin(), values.end()),
+                           ElementKind::NUMBER);
+                     }});
+
+  global->Assign("sum",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1) {
+                         throw std::runtime_error("sum needs one argument");
+                       }
+                       std::vector<double> storage;
+                       return ArraySum(NumbersOf(args[0], storage));
+                     }});
+
+  global->Assign("min", MakeExtremum("min", ArrayMin));
+  global->Assign("max", MakeExtremum("max", ArrayMax));
+
+  global->Assign("dot",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 2) {
+                         throw std::runtime_error("dot needs two arguments");
+                       }
+                       std::vector<double> l_storage, r_storage;
+                       std::span<const double> l =
+                           NumbersOf(args[0], l_storage);
+                       std::span<const double> r =
+                           NumbersOf(args[1], r_storage);
+                       if (l.size() != r.size()) {
+                         throw std::runtime_error(
+                             "Arrays must have the same size");
+                       }
+                       return ArrayDot(l, r);
+                     }});
+
   global->Assign("push",
                  std::function<Value(const std::vector<Value> &)>{
                      [&output](const std::vector<Value> &args) -> Value {
@@ -363,17 +857,24 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                          throw std::runtime_error("push needs two arguments");
                        }
 
-                       std::vector<Value> res;
-                       try {
-                         res = std::get<std::vector<Value>>(args[0]);
-                         res.push_back(args[1]);
-
-                       } catch (const std::exception &e) {
-                         throw std::runtime_error(
-                             "Argument must be a list");
+                       if (!args[0].IsList()) {
+                         throw std::runtime_error("Argument must be a list");
                        }
 
-                       return Value(std::move(res));
+                       std::span<const Value> v = args[0].GetListView();
+                       std::vector<Value> res;
+                       res.reserve(v.size() + 1);
+                       res.assign(v.begin(), v.end());
+                       res.push_back(args[1]);
+
+                       // An element of another kind turns the result into
+                       // a mixed list.
+                       ElementKind kind = v.empty() ? Value::KindOf(args[1])
+                                                    : args[0].ListKind();
+                       if (Value::KindOf(args[1]) != kind) {
+                         kind = ElementKind::MIXED;
+                       }
+                       return Value::MakeList(std::move(res), kind);
                      }});
 
   global->Assign("pop",
@@ -383,19 +884,11 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
                          throw std::runtime_error("pop needs one argument");
                        }
 
-                       std::vector<Value> v;
-                       Value res;
-                       try {
-                         v = std::get<std::vector<Value>>(args[0]);
-                         res = v[v.size() - 1];
-                         v.pop_back();
-
-                       } catch (const std::exception &e) {
-                         throw std::runtime_error(
-                             "Argument must be a list");
+                       if (!args[0].IsList() || args[0].GetListView().empty()) {
+                         throw std::runtime_error("Argument must be a list");
                        }
 
-                       return res;
+                       return args[0].GetListView().back();
                      }});
 
   global->Assign(
@@ -406,22 +899,17 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
               throw std::runtime_error("insert needs three arguments");
             }
 
-            std::vector<Value> v;
-            double index;
-            Value value;
-
-            try {
-              v = std::get<std::vector<Value>>(args[0]);
-              index = std::get<double>(args[1]);
-              value = args[2];
-              v.insert(v.begin() + index, value);
-
-            } catch (const std::exception &e) {
-              throw std::runtime_error(
-                  "Index must be integer");
+            int64_t index;
+            if (!args[0].IsList() || !GetInteger(args[1], index)) {
+              throw std::runtime_error("Index must be integer");
+            }
+            std::vector<Value> v = args[0].CopyList();
+            if (index < 0 || static_cast<uint64_t>(index) > v.size()) {
+              throw std::runtime_error("Index is out of range");
             }
+            v.insert(v.begin() + index, args[2]);
 
-            return Value(v);
+            return Value(std::move(v));
           }});
 
   global->Assign(
@@ -432,70 +920,316 @@ void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream &output) {
               throw std::runtime_error("remove needs two arguments");
             }
 
-            std::vector<Value> v;
-            double index;
-
-            try {
-              v = std::get<std::vector<Value>>(args[0]);
-              index = std::get<double>(args[1]);
-              v.erase(v.begin() + index);
-
-            } catch (const std::exception &e) {
-              throw std::runtime_error(
-                  "Index must be integer");
+            int64_t index;
+            if (!args[0].IsList() || !GetInteger(args[1], index)) {
+              throw std::runtime_error("Index must be integer");
             }
+            std::vector<Value> v = args[0].CopyList();
+            if (index < 0 || static_cast<uint64_t>(index) >= v.size()) {
+              throw std::runtime_error("Index is out of range");
+            }
+            v.erase(v.begin() + index);
 
-            return Value(v);
+            return Value(std::move(v));
           }});
 
+  global->Assign("keys",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       const DictTable &table = DictArg(args, 1, "keys");
+                       std::vector<Value> res;
+                       res.reserve(table.Size());
+                       table.ForEach([&](const Value &key, const Value &) {
+                         res.push_back(key);
+                       });
+                       return Value(std::move(res));
+                     }});
+
+  global->Assign("values",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       const DictTable &table = DictArg(args, 1, "values");
+                       std::vector<Value> res;
+                       res.reserve(table.Size());
+                       table.ForEach([&](const Value &, const Value &value) {
+                         res.push_back(value);
+                       });
+                       return Value(std::move(res));
+                     }});
+
+  global->Assign("has",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       const DictTable &table = DictArg(args, 2, "has");
+                       return table.Find(args[1]) != nullptr;
+                     }});
+
+  // Like push and remove, del returns a new dict and leaves its argument
+  // as it was.
+  global->Assign("del",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       DictArg(args, 2, "del");
+                       Value res = args[0];
+                       DictTable &table =
+                           DictTable::Writable(std::get<Dict>(res));
+                       if (!table.Erase(args[1])) {
+                         throw std::runtime_error("Key is not in the dict");
+                       }
+                       return res;
+                     }});
+
   global->Assign(
-      "sort",
-      std::function<Value(const std::vector<Value> &)>{
-          [&output](const std::vector<Value> &args) -> Value {
-            if (args.size() != 1) {
-              throw std::runtime_error("sort needs one argument");
-            }
+      "pmap", std::function<Value(const std::vector<Value> &)>{
+                  [&output](const std::vector<Value> &args) -> Value {
+                    Value list = CheckFunctionArgs(args, "pmap");
+                    std::span<const Value> items = list.GetListView();
+                    std::vector<Value> results(items.size());
+                    ForEachParallel(items.size(), args[1], output,
+                                    [&](Interpret &worker, size_t i) {
+                                      results[i] =
+                                          worker.Call(args[1], {items[i]});
+                                    });
+                    return Value(std::move(results));
+                  }});
 
-            std::vector<Value> v = std::get<std::vector<Value>>(args[0]);
+  global->Assign(
+      "pfilter", std::function<Value(const std::vector<Value> &)>{
+                     [&output](const std::vector<Value> &args) -> Value {
+                       Value list = CheckFunctionArgs(args, "pfilter");
+                       std::span<const Value> items = list.GetListView();
+                       std::vector<char> keep(items.size());
+                       ForEachParallel(
+                           items.size(), args[1], output,
+                           [&](Interpret &worker, size_t i) {
+                             Value res = worker.Call(args[1], {items[i]});
+                             if (!std::holds_alternative<bool>(res)) {
+                               throw std::runtime_error(
+                                   "pfilter function must return a bool");
+                             }
+                             keep[i] = std::get<bool>(res);
+                           });
+
+                       std::vector<Value> results;
+                       for (size_t i = 0; i < items.size(); ++i) {
+                         if (keep[i]) {
+                           results.push_back(items[i]);
+                         }
+                       }
+                       return Value(std::move(results));
+                     }});
 
-            try {
-              auto alt = v[0].index();
-              for (auto &el : v) {
-                if (el.index() != alt) {
-                  throw std::runtime_error(
-                      "All elements must be of one type");
-                }
-              }
+  // The reduction is a balanced tree whose shape depends only on the length
+  // of the list: every round combines neighbouring pairs in parallel. The
+  // result is the same on any number of threads.
+  global->Assign(
+      "preduce", std::function<Value(const std::vector<Value> &)>{
+                     [&output](const std::vector<Value> &args) -> Value {
+                       Value list = CheckFunctionArgs(args, "preduce");
+                       if (args.size() > 3) {
+                         throw std::runtime_error(
+                             "preduce needs a list, a function and an "
+                             "optional initial value");
+                       }
+                       std::vector<Value> level = list.CopyList();
+                       if (level.empty()) {
+                         if (args.size() == 3) {
+                           return args[2];
+                         }
+                         throw std::runtime_error(
+                             "preduce of an empty list needs an initial "
+                             "value");
+                       }
 
-              auto cmp = [&](const Value &a, const Value &b) {
-                switch (alt) {
-                case 0:
-                  return std::get<double>(a) < std::get<double>(b);
-                case 1:
-                  return std::get<std::string>(a) < std::get<std::string>(b);
-                case 2:
-                  return std::get<bool>(a) < std::get<bool>(b);
-                default:
-                  throw std::runtime_error(
-                      "Unlnown type for sort");
-                }
-              };
+                       while (level.size() > 1) {
+                         std::vector<Value> next((level.size() + 1) / 2);
+                         ForEachParallel(level.size() / 2, args[1], output,
+                                         [&](Interpret &worker, size_t i) {
+                                           next[i] = worker.Call(
+                                               args[1], {level[2 * i],
+                                                         level[2 * i + 1]});
+                                         });
+                         if (level.size() % 2 == 1) {
+                           next.back() = std::move(level.back());
+                         }
+                         level = std::move(next);
+                       }
 
-              std::sort(v.begin(), v.end(), cmp);
-              return Value(std::move(v));
-            } catch (std::exception &e) {
-              throw std::runtime_error(
-                  "All elements must be of one type");
-            }
-          }});
+                       if (args.size() == 3) {
+                         return Interpret::CallFunction(
+                             args[1], {args[2], level[0]});
+                       }
+                       return level[0];
+                     }});
+
+  global->Assign("spawn",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.empty()) {
+                         throw std::runtime_error("spawn needs a function");
+                       }
+                       return Task::Spawn(
+                           args[0],
+                           std::vector<Value>(args.begin() + 1, args.end()));
+                     }});
+
+  global->Assign("await",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&output](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1) {
+                         throw std::runtime_error("await needs a task");
+                       }
+                       return AwaitTask(args[0], output);
+                     }});
+
+  global->Assign("await_all",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&output](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1 || !args[0].IsList()) {
+                         throw std::runtime_error(
+                             "await_all needs a list of tasks");
+                       }
+                       std::vector<Value> results;
+                       for (const Value &task : args[0].GetListView()) {
+                         results.push_back(AwaitTask(task, output));
+                       }
+                       return Value::MakeList(std::move(results));
+                     }});
+
+  global->Assign("sort", MakeSort(false));
+  global->Assign("stable_sort", MakeSort(true));
+
+  global->Assign("read",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&input](const std::vector<Value> &args) -> Value {
+                       if (!args.empty()) {
+                         throw std::runtime_error("read takes no arguments");
+                       }
+                       std::string line;
+                       if (!input.ReadLine(line))
+                         return nullptr;
+                       return Value(std::move(line));
+                     }});
+
+  global->Assign("read_all",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&input](const std::vector<Value> &args) -> Value {
+                       if (!args.empty()) {
+                         throw std::runtime_error(
+                             "read_all takes no arguments");
+                       }
+                       return Value(input.ReadAll());
+                     }});
+
+  global->Assign("read_lines",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [&input](const std::vector<Value> &args) -> Value {
+                       if (!args.empty()) {
+                         throw std::runtime_error(
+                             "read_lines takes no arguments");
+                       }
+                       return Value(std::shared_ptr<Iterator>(
+                           std::make_shared<LineIterator>(input)));
+                     }});
+
+  global->Assign("open_mmap",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1 || !args[0].IsString()) {
+                         throw std::runtime_error(
+                             "open_mmap needs a file name");
+                       }
+
+                       auto file = std::make_shared<MappedFile>(
+                           std::string(args[0].GetStringView()));
+                       std::string_view view = file->View();
+                       return Value(StringSlice{std::move(file), view});
+                     }});
 
-  global->Assign("read", std::function<Value(const std::vector<Value> &)>{
-                             [](auto &args) -> Value {
-                               std::string line;
-                               if (!std::getline(std::cin, line))
-                                 return nullptr;
-                               return Value(line);
-                             }});
+  global->Assign("lines",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1 || !args[0].IsString()) {
+                         throw std::runtime_error("lines needs a file name");
+                       }
+
+                       auto file = std::make_shared<MappedFile>(
+                           std::string(args[0].GetStringView()));
+                       return Value(std::shared_ptr<Iterator>(
+                           std::make_shared<MappedLineIterator>(
+                               std::move(file))));
+                     }});
+
+  global->Assign("collect",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 1) {
+                         throw std::runtime_error("collect needs an iterator");
+                       }
+
+                       std::vector<Value> out;
+                       ForEachElement(args[0], [&out](const Value &el) {
+                         out.push_back(el);
+                         return true;
+                       });
+                       return Value::MakeList(std::move(out));
+                     }});
+
+  global->Assign("take",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       if (args.size() != 2 || !args[1].IsNumber()) {
+                         throw std::runtime_error(
+                             "take needs an iterator and a count");
+                       }
+
+                       double count = args[1].GetNumber();
+                       std::vector<Value> out;
+                       if (count >= 1) {
+                         ForEachElement(args[0], [&](const Value &el) {
+                           out.push_back(el);
+                           return out.size() < count;
+                         });
+                       }
+                       return Value::MakeList(std::move(out));
+                     }});
+
+  global->Assign("write_file",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       WriteFile(args, false);
+                       return nullptr;
+                     }});
+
+  global->Assign("append_file",
+                 std::function<Value(const std::vector<Value> &)>{
+                     [](const std::vector<Value> &args) -> Value {
+                       WriteFile(args, true);
+                       return nullptr;
+                     }});
+
+  // Allocation counts of the script; all zero unless the interpreter runs
+  // with allocation accounting (see MemoryStats).
+  global->Assign(
+      "mem_stats", std::function<Value(const std::vector<Value> &)>{
+                       [](const std::vector<Value> &args) -> Value {
+                         if (!args.empty()) {
+                           throw std::runtime_error(
+                               "mem_stats takes no arguments");
+                         }
+                         Dict res = CountersDict(MemoryStats::Total());
+                         DictTable &table = DictTable::Writable(res);
+                         for (size_t kind = 0; kind < kAllocKinds; ++kind) {
+                           AllocKind k = static_cast<AllocKind>(kind);
+                           table.Set(std::string(AllocKindName(k)),
+                                     CountersDict(MemoryStats::OfKind(k)));
+                         }
+                         table.Set(std::string("enabled"),
+                                   MemoryStats::Enabled());
+                         table.Set(std::string("peak_rss"),
+                                   int64_t(MemoryStats::PeakRss()));
+                         return res;
+                       }});
 
   global->Assign("stacktrace",
                  std::function<Value(const std::vector<Value> &)>{
@@ -16,4 +16,5 @@ struct Scope;
 
 class Interpret;
 
-void AddSystemFunction(std::shared_ptr<Scope> global, std::ostream& output);
+void AddSystemFunction(std::shared_ptr<Scope> global, OutputSink& output,
+                       InputSource& input);
@@ -0,0 +1,442 @@
+#include "string_kernels.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+enum struct CaseMapping { LOWER, UPPER };
+
+char *Append(char *out, std::string_view part) {
+  if (!part.empty()) {
+    std::memcpy(out, part.data(), part.size());
+  }
+  return out + part.size();
+}
+
+// Length of the well-formed UTF-8 sequence at `p`, or 0. The bounds of the
+// second byte exclude overlong forms, surrogates and code points above
+// U+10FFFF.
+inline size_t SequenceLength(const char *p, size_t size) {
+  auto byte = [p](size_t i) { return static_cast<unsigned char>(p[i]); };
+  unsigned char lead = byte(0);
+  if (lead < 0x80) {
+    return 1;
+  }
+
+  size_t len;
+  unsigned char low = 0x80, high = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    len = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    len = 3;
+    if (lead == 0xE0) {
+      low = 0xA0;
+    } else if (lead == 0xED) {
+      high = 0x9F;
+    }
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    len = 4;
+    if (lead == 0xF0) {
+      low = 0x90;
+    } else if (lead == 0xF4) {
+      high = 0x8F;
+    }
+  } else {
+    return 0;
+  }
+
+  if (size < len || byte(1) < low || byte(1) > high) {
+    return 0;
+  }
+  for (size_t i = 2; i < len; ++i) {
+    if (byte(i) < 0x80 || byte(i) > 0xBF) {
+      return 0;
+    }
+  }
+  return len;
+}
+
+// Copies the UTF-8 sequence at `src` to `dst`, mapping the case of ASCII,
+// two-byte Latin-1 (U+00C0..U+00FE) and Cyrillic (U+0400..U+045F) letters.
+// Returns the length of the sequence, or 0 if it is malformed.
+inline size_t MapCodePoint(const char *src, char *dst, size_t size,
+                           CaseMapping mapping) {
+  unsigned char b0 = src[0];
+  if (b0 < 0x80) {
+    bool letter = mapping == CaseMapping::LOWER ? (b0 >= 'A' && b0 <= 'Z')
+                                                : (b0 >= 'a' && b0 <= 'z');
+    dst[0] = letter ? b0 ^ 0x20 : b0;
+    return 1;
+  }
+
+  size_t len = SequenceLength(src, size);
+  if (len == 0) {
+    return 0;
+  }
+  std::memcpy(dst, src, len);
+  if (len != 2) {
+    return len;
+  }
+
+  unsigned char b1 = src[1];
+  if (mapping == CaseMapping::LOWER) {
+    if (b0 == 0xC3 && b1 <= 0x9E && b1 != 0x97) {
+      dst[1] = b1 + 0x20;
+    } else if (b0 == 0xD0 && b1 <= 0x8F) {
+      dst[0] = 0xD1;
+      dst[1] = b1 + 0x10;
+    } else if (b0 == 0xD0 && b1 <= 0x9F) {
+      dst[1] = b1 + 0x20;
+    } else if (b0 == 0xD0 && b1 <= 0xAF) {
+      dst[0] = 0xD1;
+      dst[1] = b1 - 0x20;
+    }
+  } else {
+    if (b0 == 0xC3 && b1 >= 0xA0 && b1 <= 0xBE && b1 != 0xB7) {
+      dst[1] = b1 - 0x20;
+    } else if (b0 == 0xD0 && b1 >= 0xB0) {
+      dst[1] = b1 - 0x20;
+    } else if (b0 == 0xD1 && b1 <= 0x8F) {
+      dst[0] = 0xD0;
+      dst[1] = b1 + 0x20;
+    } else if (b0 == 0xD1 && b1 <= 0x9F) {
+      dst[0] = 0xD0;
+      dst[1] = b1 - 0x10;
+    }
+  }
+  return len;
+}
+
+// Scalar kernels, also used for the tails of the vector ones. Validation
+// and case mapping return the number of bytes consumed; stopping short of
+// `size` means the input is malformed.
+
+inline size_t ValidateScalar(const char *s, size_t size, size_t i = 0) {
+  while (i < size) {
+    size_t len = SequenceLength(s + i, size - i);
+    if (len == 0) {
+      break;
+    }
+    i += len;
+  }
+  return i;
+}
+
+inline size_t MapCaseScalar(const char *src, char *dst, size_t size,
+                            CaseMapping mapping, size_t i = 0) {
+  while (i < size) {
+    size_t len = MapCodePoint(src + i, dst + i, size - i, mapping);
+    if (len == 0) {
+      break;
+    }
+    i += len;
+  }
+  return i;
+}
+
+size_t FindScalar(std::string_view haystack, std::string_view needle,
+                  size_t pos) {
+  return haystack.find(needle, pos);
+}
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+
+// A block without bytes above 0x7F is handled as a whole; in any other
+// block the kernels step through code points until they pass its end and
+// then resume with whole blocks from there.
+
+// Candidate positions are those where both the first and the last byte of
+// the needle match; only they are compared in full.
+__attribute__((target("sse2"))) size_t
+FindSse2(std::string_view haystack, std::string_view needle, size_t pos) {
+  const char *h = haystack.data();
+  const char *n = needle.data();
+  size_t k = needle.size();
+  const __m128i first = _mm_set1_epi8(n[0]);
+  const __m128i last = _mm_set1_epi8(n[k - 1]);
+
+  size_t i = pos;
+  for (; i + k - 1 + 16 <= haystack.size(); i += 16) {
+    __m128i block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+    __m128i block_last =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i + k - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      size_t offset = __builtin_ctz(mask);
+      if (k <= 2 || std::memcmp(h + i + offset + 1, n + 1, k - 2) == 0) {
+        return i + offset;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return FindScalar(haystack, needle, i);
+}
+
+__attribute__((target("avx2"))) size_t
+FindAvx2(std::string_view haystack, std::string_view needle, size_t pos) {
+  const char *h = haystack.data();
+  const char *n = needle.data();
+  size_t k = needle.size();
+  const __m256i first = _mm256_set1_epi8(n[0]);
+  const __m256i last = _mm256_set1_epi8(n[k - 1]);
+
+  size_t i = pos;
+  for (; i + k - 1 + 32 <= haystack.size(); i += 32) {
+    __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i));
+    __m256i block_last =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i + k - 1));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      size_t offset = __builtin_ctz(mask);
+      if (k <= 2 || std::memcmp(h + i + offset + 1, n + 1, k - 2) == 0) {
+        return i + offset;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return FindScalar(haystack, needle, i);
+}
+
+__attribute__((target("sse2"))) size_t ValidateSse2(const char *s,
+                                                    size_t size) {
+  size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+    if (_mm_movemask_epi8(x) == 0) {
+      i += 16;
+      continue;
+    }
+    for (size_t end = i + 16; i < end;) {
+      size_t len = SequenceLength(s + i, size - i);
+      if (len == 0) {
+        return i;
+      }
+      i += len;
+    }
+  }
+  return ValidateScalar(s, size, i);
+}
+
+__attribute__((target("avx2"))) size_t ValidateAvx2(const char *s,
+                                                    size_t size) {
+  size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    if (_mm256_movemask_epi8(x) == 0) {
+      i += 32;
+      continue;
+    }
+    for (size_t end = i + 32; i < end;) {
+      size_t len = SequenceLength(s + i, size - i);
+      if (len == 0) {
+        return i;
+      }
+      i += len;
+    }
+  }
+  return ValidateScalar(s, size, i);
+}
+
+// Bytes with the high bit set compare as negative, so they never fall into
+// the letter range and only ASCII letters get their 0x20 bit flipped.
+__attribute__((target("sse2"))) size_t MapCaseSse2(const char *src, char *dst,
+                                                   size_t size,
+                                                   CaseMapping mapping) {
+  const __m128i below = _mm_set1_epi8(mapping == CaseMapping::LOWER ? 'A' - 1
+                                                                    : 'a' - 1);
+  const __m128i above = _mm_set1_epi8(mapping == CaseMapping::LOWER ? 'Z' + 1
+                                                                    : 'z' + 1);
+  const __m128i flip = _mm_set1_epi8(0x20);
+
+  size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    if (_mm_movemask_epi8(x) == 0) {
+      __m128i letter =
+          _mm_and_si128(_mm_cmpgt_epi8(x, below), _mm_cmplt_epi8(x, above));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                       _mm_xor_si128(x, _mm_and_si128(letter, flip)));
+      i += 16;
+      continue;
+    }
+    for (size_t end = i + 16; i < end;) {
+      size_t len = MapCodePoint(src + i, dst + i, size - i, mapping);
+      if (len == 0) {
+        return i;
+      }
+      i += len;
+    }
+  }
+  return MapCaseScalar(src, dst, size, mapping, i);
+}
+
+__attribute__((target("avx2"))) size_t MapCaseAvx2(const char *src, char *dst,
+                                                   size_t size,
+                                                   CaseMapping mapping) {
+  const __m256i below = _mm256_set1_epi8(
+      mapping == CaseMapping::LOWER ? 'A' - 1 : 'a' - 1);
+  const __m256i above = _mm256_set1_epi8(
+      mapping == CaseMapping::LOWER ? 'Z' + 1 : 'z' + 1);
+  const __m256i flip = _mm256_set1_epi8(0x20);
+
+  size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    if (_mm256_movemask_epi8(x) == 0) {
+      __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(x, below),
+                                        _mm256_cmpgt_epi8(above, x));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                          _mm256_xor_si256(x, _mm256_and_si256(letter, flip)));
+      i += 32;
+      continue;
+    }
+    for (size_t end = i + 32; i < end;) {
+      size_t len = MapCodePoint(src + i, dst + i, size - i, mapping);
+      if (len == 0) {
+        return i;
+      }
+      i += len;
+    }
+  }
+  return MapCaseScalar(src, dst, size, mapping, i);
+}
+
+#endif
+
+size_t Validate(const char *s, size_t size) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return ValidateAvx2(s, size);
+  case SimdLevel::SSE2:
+    return ValidateSse2(s, size);
+  default:
+    break;
+  }
+#endif
+  return ValidateScalar(s, size);
+}
+
+size_t MapCaseRun(const char *src, char *dst, size_t size,
+                  CaseMapping mapping) {
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return MapCaseAvx2(src, dst, size, mapping);
+  case SimdLevel::SSE2:
+    return MapCaseSse2(src, dst, size, mapping);
+  default:
+    break;
+  }
+#endif
+  return MapCaseScalar(src, dst, size, mapping);
+}
+
+std::string MapCase(std::string_view s, CaseMapping mapping) {
+  size_t done = 0;
+  std::string res;
+  res.resize_and_overwrite(s.size(), [&](char *dst, size_t) {
+    done = MapCaseRun(s.data(), dst, s.size(), mapping);
+    return s.size();
+  });
+
+  if (done != s.size()) {
+    throw std::runtime_error("String is not valid UTF-8");
+  }
+  return res;
+}
+
+} // namespace
+
+size_t FindSubstring(std::string_view haystack, std::string_view needle,
+                     size_t pos) {
+  if (pos > haystack.size()) {
+    return std::string_view::npos;
+  }
+  if (needle.empty()) {
+    return pos;
+  }
+  if (needle.size() > haystack.size() - pos) {
+    return std::string_view::npos;
+  }
+  // libc's memchr is already vectorized.
+  if (needle.size() == 1) {
+    const void *found = std::memchr(haystack.data() + pos, needle[0],
+                                    haystack.size() - pos);
+    return found ? static_cast<const char *>(found) - haystack.data()
+                 : std::string_view::npos;
+  }
+
+#ifdef ITMOSCRIPT_HAS_X86_SIMD
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX2:
+    return FindAvx2(haystack, needle, pos);
+  case SimdLevel::SSE2:
+    return FindSse2(haystack, needle, pos);
+  default:
+    break;
+  }
+#endif
+  return FindScalar(haystack, needle, pos);
+}
+
+size_t Utf8SequenceLength(std::string_view s) {
+  return s.empty() ? 0 : SequenceLength(s.data(), s.size());
+}
+
+bool IsValidUtf8(std::string_view s) {
+  return Validate(s.data(), s.size()) == s.size();
+}
+
+std::string ToLowerUtf8(std::string_view s) {
+  return MapCase(s, CaseMapping::LOWER);
+}
+
+std::string ToUpperUtf8(std::string_view s) {
+  return MapCase(s, CaseMapping::UPPER);
+}
+
+std::string ReplaceAll(std::string_view s, std::string_view from,
+                       std::string_view to) {
+  size_t first = from.empty() ? std::string_view::npos : FindSubstring(s, from);
+  if (first == std::string_view::npos) {
+    return std::string(s);
+  }
+
+  // A result that is not longer than the source fits into a buffer of the
+  // source's size; otherwise the matches are counted first.
+  size_t size = s.size();
+  if (to.size() > from.size()) {
+    size_t count = 0;
+    for (size_t pos = first; pos != std::string_view::npos;
+         pos = FindSubstring(s, from, pos + from.size())) {
+      ++count;
+    }
+    size += count * (to.size() - from.size());
+  }
+
+  std::string res;
+  res.resize_and_overwrite(size, [&](char *dst, size_t) {
+    char *out = dst;
+    size_t prev = 0;
+    for (size_t pos = first; pos != std::string_view::npos;
+         pos = FindSubstring(s, from, prev)) {
+      out = Append(out, s.substr(prev, pos - prev));
+      out = Append(out, to);
+      prev = pos + from.size();
+    }
+    out = Append(out, s.substr(prev));
+    return static_cast<size_t>(out - dst);
+  });
+  return res;
+}
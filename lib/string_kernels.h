@@ -0,0 +1,31 @@
+#pragma once
+
+#include "simd.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Byte-level kernels behind the string builtins, vectorized at the level
+// chosen in simd.h.
+
+// Position of the first occurrence of `needle` in `haystack` at or after
+// `pos`, or std::string_view::npos.
+size_t FindSubstring(std::string_view haystack, std::string_view needle,
+                     size_t pos = 0);
+
+bool IsValidUtf8(std::string_view s);
+
+// Length of the well-formed UTF-8 sequence at the start of `s`, or 0 if
+// there is none.
+size_t Utf8SequenceLength(std::string_view s);
+
+// Case mapping of ASCII, Latin-1 and Cyrillic letters. Every mapping keeps
+// the encoded length, other characters are copied as is. Throws on
+// malformed UTF-8.
+std::string ToLowerUtf8(std::string_view s);
+std::string ToUpperUtf8(std::string_view s);
+
+// `s` with every non-overlapping occurrence of `from` replaced by `to`,
+// written in one pass into a buffer of the final size.
+std::string ReplaceAll(std::string_view s, std::string_view from,
+                       std::string_view to);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// String whose characters live in a buffer owned by someone else, e.g. a
+// memory-mapped file. The owner is kept alive through the shared pointer,
+// so handing out a slice never copies the characters. Strings are
+// immutable in ITMOScript: every operation that changes text produces a new
+// std::string, which is when a slice gets materialized.
+struct StringSlice {
+  std::shared_ptr<const void> owner;
+  std::string_view view;
+  // Bytes the owner keeps alive, which slices of this slice are measured
+  // against; the view itself unless it is a part of the owner's buffer.
+  size_t owner_size = view.size();
+};
@@ -0,0 +1,174 @@
+#include "task.h"
+
+#include "interpreter.h"
+#include "thread_pool.h"
+#include <utility>
+
+namespace {
+
+// Copies the closure chain of a spawned function. The copies share the
+// frozen variables of the originals (see Scope::Freeze), so a snapshot
+// takes time in the number of scopes rather than variables, and the
+// builtins are not copied at all. Functions found in the copies are
+// pointed at the copies of their closures when they are read, so nothing
+// the task can reach by name is shared with the thread that spawned it.
+// Values are not copied, and iterators among them stay shared: tasks
+// pulling from one split its elements (see Iterator::Next).
+class ScopeSnapshot {
+public:
+  Value Copy(const Value &value) {
+    auto fn = std::get_if<std::shared_ptr<Function>>(&value);
+    if (fn == nullptr || (*fn)->closure == nullptr) {
+      return value;
+    }
+    auto copy = std::make_shared<Function>(**fn);
+    copy->closure = Copy((*fn)->closure);
+    return Value(std::move(copy));
+  }
+
+  std::shared_ptr<Scope> Copy(const std::shared_ptr<Scope> &scope) {
+    if (scope == nullptr || scope->immutable) {
+      return scope;
+    }
+    if (auto it = copies_->find(scope.get()); it != copies_->end()) {
+      return it->second.second;
+    }
+
+    auto copy = std::make_shared<Scope>();
+    copies_->emplace(scope.get(), std::pair(scope, copy));
+    copy->frozen = scope->Freeze();
+    copy->parent = Copy(scope->parent);
+    copy->copies = copies_;
+    if (copy->frozen == nullptr) {
+      return copy;
+    }
+    for (const std::shared_ptr<Scope> &closure : copy->frozen->closures) {
+      // A scope that is itself a copy holds functions of its own spawner,
+      // whose closures it has copies of.
+      std::shared_ptr<Scope> own = closure;
+      if (scope->copies != nullptr) {
+        if (auto it = scope->copies->find(closure.get());
+            it != scope->copies->end()) {
+          own = it->second.second;
+        }
+      }
+      std::shared_ptr<Scope> closure_copy = Copy(own);
+      if (own != closure) {
+        copies_->emplace(closure.get(), std::pair(closure, closure_copy));
+      }
+    }
+    return copy;
+  }
+
+private:
+  std::shared_ptr<Scope::CopyMap> copies_ =
+      std::make_shared<Scope::CopyMap>();
+};
+
+} // namespace
+
+std::shared_ptr<Task> Task::Spawn(const Value &func,
+                                  const std::vector<Value> &args) {
+  if (!std::holds_alternative<std::shared_ptr<Function>>(func) &&
+      !std::holds_alternative<
+          std::function<Value(const std::vector<Value> &)>>(func)) {
+    throw std::runtime_error("Argument must be a function");
+  }
+
+  ScopeSnapshot snapshot;
+  Value task_func = snapshot.Copy(func);
+  std::vector<Value> task_args;
+  task_args.reserve(args.size());
+  for (Value arg : args) {
+    arg.Share();
+    task_args.push_back(snapshot.Copy(arg));
+  }
+
+  auto task = std::make_shared<Task>();
+  Interpret::TrackTask(task);
+  // The spawner joins its tasks before it returns, so its budget outlives
+  // them.
+  ThreadPool::Global().Submit(
+      [task, task_func = std::move(task_func), task_args = std::move(task_args),
+       budget = Interpret::CurrentBudget()] {
+        task->Run(task_func, task_args, budget);
+      });
+  return task;
+}
+
+void Task::Run(const Value &func, const std::vector<Value> &args,
+               ExecutionBudget *budget) {
+  std::shared_ptr<Scope> closure;
+  if (auto fn = std::get_if<std::shared_ptr<Function>>(&func)) {
+    closure = (*fn)->closure;
+  }
+
+  StringSink sink;
+  Interpret worker(nullptr, closure, sink);
+  worker.SetBudget(budget);
+  Value result;
+  std::exception_ptr error;
+  try {
+    result = worker.Call(func, args);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  try {
+    worker.JoinTasks();
+  } catch (...) {
+    if (!error) {
+      error = std::current_exception();
+    }
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    result_ = std::move(result);
+    error_ = error;
+    output_ = sink.Take();
+    done_ = true;
+  }
+  finished_.notify_all();
+}
+
+void Task::Join() {
+  while (!Done()) {
+    if (ThreadPool::Global().RunPendingTask()) {
+      continue;
+    }
+    // Nothing is queued, so this task is running on another thread.
+    std::unique_lock lock(mutex_);
+    finished_.wait(lock, [this] { return done_; });
+  }
+}
+
+Value Task::Result() {
+  Join();
+  std::lock_guard lock(mutex_);
+  observed_ = true;
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  return result_;
+}
+
+std::exception_ptr Task::UnobservedError() {
+  Join();
+  std::lock_guard lock(mutex_);
+  return observed_ ? nullptr : error_;
+}
+
+std::string Task::TakeOutput() {
+  std::lock_guard lock(mutex_);
+  return std::exchange(output_, {});
+}
+
+bool Task::Done() {
+  std::lock_guard lock(mutex_);
+  return done_;
+}
+
+bool Task::Observed() {
+  std::lock_guard lock(mutex_);
+  return observed_;
+}
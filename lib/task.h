@@ -0,0 +1,59 @@
+#pragma once
+
+#include "value.h"
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ExecutionBudget;
+
+// A function call running on the thread pool, started by spawn(). The task
+// gets its own interpreter, so its call stack and innermost scope are its
+// own. It sees a snapshot of the variables visible to the function when it
+// was spawned: assignments in the task stay in the task, and later
+// assignments by the spawner are not seen by it. Results come back only
+// through await.
+//
+// Output printed by a task is buffered and written to the output of
+// whoever awaits it, at the point of the await. Tasks nobody awaits are
+// waited for when the spawning script (or task) ends and their output is
+// written then, in spawn order.
+class Task {
+public:
+  static std::shared_ptr<Task> Spawn(const Value &func,
+                                     const std::vector<Value> &args);
+
+  // Waits for the task, running other queued tasks on this thread
+  // meanwhile. Does not throw.
+  void Join();
+
+  // Joins and returns the result of the call, or rethrows its error.
+  Value Result();
+
+  // Joins and returns the error of a task whose Result() was never asked
+  // for, or nullptr.
+  std::exception_ptr UnobservedError();
+
+  // Output printed by the task; empty after the first call.
+  std::string TakeOutput();
+
+  bool Done();
+
+  // Whether Result() was called, after which the task can be forgotten.
+  bool Observed();
+
+private:
+  void Run(const Value &func, const std::vector<Value> &args,
+           ExecutionBudget *budget);
+
+  std::mutex mutex_;
+  std::condition_variable finished_;
+  bool done_ = false;
+  bool observed_ = false;
+  Value result_;
+  std::exception_ptr error_;
+  std::string output_;
+};
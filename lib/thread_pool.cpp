@@ -0,0 +1,228 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Each chunk is this fraction of what is left of a participant's range:
+// large chunks while there is plenty of work, single items near the end.
+constexpr size_t kChunkDivisor = 8;
+
+thread_local bool inside_worker = false;
+// Index of the calling thread's task queue: 0 outside the pool.
+thread_local size_t own_queue = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) : queues_(threads + 1) {
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this, i] { WorkerLoop(i + 1); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+ThreadPool &ThreadPool::Global() {
+  static ThreadPool pool([] {
+    if (const char *env = std::getenv("ITMOSCRIPT_THREADS"); env && *env) {
+      size_t threads = std::strtoul(env, nullptr, 10);
+      return threads > 0 ? threads - 1 : 0;
+    }
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? size_t(cores - 1) : size_t(0);
+  }());
+  return pool;
+}
+
+void ThreadPool::ParallelFor(size_t n,
+                             const std::function<void(size_t, size_t)> &body) {
+  if (n == 0) {
+    return;
+  }
+
+  std::unique_lock run_lock(run_mutex_, std::defer_lock);
+  if (n == 1 || threads_.empty() || inside_worker || !run_lock.try_lock()) {
+    body(0, n);
+    return;
+  }
+
+  Job job;
+  job.body = &body;
+  job.slots = std::vector<Slot>(Size());
+  for (size_t i = 0; i < job.slots.size(); ++i) {
+    job.slots[i].begin = n * i / job.slots.size();
+    job.slots[i].end = n * (i + 1) / job.slots.size();
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    job_ = &job;
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  inside_worker = true;
+  Work(job, 0);
+  inside_worker = false;
+
+  // Workers busy with a task never join; their ranges were stolen above.
+  // Only the ones that did join have to be waited for.
+  {
+    std::unique_lock lock(mutex_);
+    job_ = nullptr;
+    done_.wait(lock, [this] { return active_ == 0; });
+  }
+
+  if (job.error) {
+    std::rethrow_exception(job.error);
+  }
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+  inside_worker = true;
+  own_queue = index;
+  uint64_t seen = 0;
+  while (true) {
+    Job *job = nullptr;
+    {
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [&] {
+        return stop_ || generation_ != seen || queued_ > 0;
+      });
+      if (stop_) {
+        return;
+      }
+      if (generation_ != seen) {
+        seen = generation_;
+        job = job_;
+        if (job != nullptr) {
+          ++active_;
+        }
+      }
+    }
+
+    if (job == nullptr) {
+      RunPendingTask();
+      continue;
+    }
+
+    Work(*job, index);
+
+    {
+      std::lock_guard lock(mutex_);
+      if (--active_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  TaskQueue &queue = queues_[own_queue];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard lock(mutex_);
+    ++queued_;
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::RunPendingTask() {
+  std::function<void()> task;
+  // A worker's own newest task is the one most likely to have its data in
+  // cache; everything else is taken oldest first.
+  if (own_queue != 0) {
+    TaskQueue &queue = queues_[own_queue];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+  }
+  for (size_t step = 0; !task && step < queues_.size(); ++step) {
+    TaskQueue &queue = queues_[(own_queue + step) % queues_.size()];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+  if (!task) {
+    return false;
+  }
+
+  --queued_;
+  task();
+  return true;
+}
+
+void ThreadPool::Work(Job &job, size_t self) {
+  while (!job.failed.load(std::memory_order_relaxed)) {
+    size_t begin, end;
+    if (!TakeChunk(job.slots[self], begin, end)) {
+      if (!Steal(job, self)) {
+        return;
+      }
+      continue;
+    }
+
+    try {
+      (*job.body)(begin, end);
+    } catch (...) {
+      std::lock_guard lock(job.error_mutex);
+      if (!job.error) {
+        job.error = std::current_exception();
+      }
+      job.failed = true;
+    }
+  }
+}
+
+bool ThreadPool::TakeChunk(Slot &slot, size_t &begin, size_t &end) {
+  std::lock_guard lock(slot.mutex);
+  if (slot.begin == slot.end) {
+    return false;
+  }
+  size_t size = std::max<size_t>(1, (slot.end - slot.begin) / kChunkDivisor);
+  begin = slot.begin;
+  end = begin + size;
+  slot.begin = end;
+  return true;
+}
+
+bool ThreadPool::Steal(Job &job, size_t self) {
+  for (size_t step = 1; step < job.slots.size(); ++step) {
+    Slot &victim = job.slots[(self + step) % job.slots.size()];
+    size_t begin, end;
+    {
+      std::lock_guard lock(victim.mutex);
+      if (victim.begin == victim.end) {
+        continue;
+      }
+      begin = victim.begin + (victim.end - victim.begin) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+
+    Slot &own = job.slots[self];
+    std::lock_guard lock(own.mutex);
+    own.begin = begin;
+    own.end = end;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel builtins. ParallelFor hands
+// every participant (the workers and the calling thread) an equal range of
+// indices. Each takes shrinking chunks from the front of its own range, and
+// a participant that runs out steals the back half of another one's range,
+// so uneven work evens out without a central queue.
+//
+// Independent tasks go through Submit. Every worker has its own queue and
+// runs the newest task in it first; idle workers, and threads waiting for a
+// task to finish, take the oldest task from another queue.
+class ThreadPool {
+public:
+  // Starts `threads` workers; the calling thread of ParallelFor is one more
+  // participant.
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Pool sized to the hardware, or to the ITMOSCRIPT_THREADS environment
+  // variable when it is set.
+  static ThreadPool &Global();
+
+  // Number of threads taking part in a ParallelFor.
+  size_t Size() const { return threads_.size() + 1; }
+
+  // Calls body(begin, end) for disjoint ranges that cover [0, n) and
+  // returns when all of them are done. The first exception thrown by
+  // `body` stops the remaining chunks and is rethrown here. Calls made from
+  // a worker, or while another ParallelFor is running, run the whole range
+  // on the calling thread instead.
+  void ParallelFor(size_t n, const std::function<void(size_t, size_t)> &body);
+
+  // Queues `task` to run on some thread of the pool. Tasks submitted from a
+  // worker go to that worker's queue, others to a queue shared by all
+  // threads outside the pool. `task` must not throw.
+  void Submit(std::function<void()> task);
+
+  // Runs one queued task on the calling thread. Returns false if there was
+  // none. Threads waiting for a task call this so that they help instead of
+  // blocking a core.
+  bool RunPendingTask();
+
+private:
+  struct Slot {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  struct Job {
+    const std::function<void(size_t, size_t)> *body;
+    std::vector<Slot> slots;
+    std::atomic<bool> failed = false;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+  };
+
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void WorkerLoop(size_t index);
+  void Work(Job &job, size_t self);
+  bool TakeChunk(Slot &slot, size_t &begin, size_t &end);
+  bool Steal(Job &job, size_t self);
+
+  std::vector<std::thread> threads_;
+  std::mutex run_mutex_;
+  // queues_[0] is shared by outside threads, queues_[i] belongs to worker i.
+  std::vector<TaskQueue> queues_;
+  std::atomic<size_t> queued_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  Job *job_ = nullptr;
+  uint64_t generation_ = 0;
+  // Workers inside Work() for the current job.
+  size_t active_ = 0;
+  bool stop_ = false;
+};
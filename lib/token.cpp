@@ -1,5 +1,7 @@
 #include "token.h"
 
-TokenType Token::GetType() { return type_; }
+TokenType Token::GetType() const { return type_; }
 
-std::string Token::GetValue() { return value_; }
+const std::string &Token::GetValue() const { return value_; }
+
+const SourceSpan &Token::GetSpan() const { return span_; }
@@ -1,17 +1,34 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include "token_type.h"
 
+// Position in the script text; lines and columns start at 1. Columns count
+// bytes.
+struct SourceLocation {
+  uint32_t line = 0;
+  uint32_t column = 0;
+};
+
+// Text from `begin` up to, not including, `end`. Nodes created by the
+// interpreter itself have an empty span with line 0.
+struct SourceSpan {
+  SourceLocation begin;
+  SourceLocation end;
+};
+
 class Token {
 public:
-  Token(TokenType type, std::string value)
-      : type_(type), value_(value) {}
+  Token(TokenType type, std::string value, SourceSpan span = {})
+      : type_(type), value_(value), span_(span) {}
 
-  TokenType GetType();
-  std::string GetValue();
+  TokenType GetType() const;
+  const std::string &GetValue() const;
+  const SourceSpan &GetSpan() const;
 
 private:
   TokenType type_;
   std::string value_;
+  SourceSpan span_;
 };
@@ -6,7 +6,8 @@ enum struct TokenType{
     EQ, N_EQ, LESS, GREATER, LESS_EQ, GREATER_EQ,
     AND, OR, NOT,
     ASSIGN, PLUS_A, MINUS_A, MULTIPLY_A, DIVIDE_A, MOD_A, POW_A,
-    R_S_BRACKET, L_S_BRACKET, R_BRACKET, L_BRACKET, COLON, COMMA,
-    IF, ELSE, END, THEN, WHILE, FOR, IN, BREAK, CONTINUE, FUNCTION, RETURN, EOFF,
+    R_S_BRACKET, L_S_BRACKET, R_BRACKET, L_BRACKET, R_C_BRACKET, L_C_BRACKET,
+    COLON, COMMA,
+    IF, ELSE, END, THEN, WHILE, FOR, IN, BREAK, CONTINUE, FUNCTION, RETURN, YIELD, EOFF,
     IDENTIFIER
 };
@@ -0,0 +1,217 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Events are formatted into a chunk of about this size before it is
+// written to the output.
+constexpr size_t kChunkSize = 64 * 1024;
+
+const char *CategoryName(Tracer::Category category) {
+  switch (category) {
+  case Tracer::Category::PHASE:
+    return "phase";
+  case Tracer::Category::FUNCTION:
+    return "function";
+  case Tracer::Category::BUILTIN:
+    return "builtin";
+  }
+  return "";
+}
+
+// Small id of the calling thread, the same for every tracer. Starts at 1.
+uint32_t ThreadId() {
+  static std::atomic<uint32_t> next = 1;
+  thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+void AppendEscaped(std::string &out, std::string_view text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+}
+
+} // namespace
+
+Tracer::Tracer(std::ostream &out, TraceOptions options)
+    : out_(out), options_(std::move(options)),
+      start_(std::chrono::steady_clock::now()) {
+  options_.sample_every = std::max<uint32_t>(options_.sample_every, 1);
+  size_t capacity = std::bit_ceil(std::max<size_t>(options_.buffer_events, 2));
+  mask_ = capacity - 1;
+  cells_ = std::make_unique<Cell[]>(capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  chunk_.reserve(kChunkSize + 256);
+}
+
+Tracer::~Tracer() { Stop(); }
+
+void Tracer::Start() {
+  if (started_) {
+    return;
+  }
+  started_ = true;
+  stopping_ = false;
+  out_ << "{\"traceEvents\":[\n";
+  writer_ = std::thread([this] { WriterLoop(); });
+}
+
+void Tracer::Stop() {
+  if (!started_) {
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+  started_ = false;
+
+  WriteEvents();
+  chunk_ += "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":";
+  chunk_ += std::to_string(Dropped());
+  chunk_ += "}}\n";
+  out_.write(chunk_.data(), chunk_.size());
+  out_.flush();
+  chunk_.clear();
+}
+
+bool Tracer::Wants(Category category, std::string_view name) {
+  if (category == Category::PHASE) {
+    return true;
+  }
+  if (!options_.filter.empty() &&
+      std::none_of(options_.filter.begin(), options_.filter.end(),
+                   [name](const std::string &part) {
+                     return name.find(part) != std::string_view::npos;
+                   })) {
+    return false;
+  }
+  if (options_.sample_every == 1) {
+    return true;
+  }
+  return calls_.fetch_add(1, std::memory_order_relaxed) %
+             options_.sample_every ==
+         0;
+}
+
+uint64_t Tracer::Now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start_)
+      .count();
+}
+
+bool Tracer::Begin(Category category, std::string_view name,
+                   uint64_t timestamp) {
+  return Push('B', category, name, timestamp);
+}
+
+bool Tracer::End(Category category, std::string_view name,
+                 uint64_t timestamp) {
+  return Push('E', category, name, timestamp);
+}
+
+bool Tracer::Push(char phase, Category category, std::string_view name,
+                  uint64_t timestamp) {
+  size_t position = tail_.load(std::memory_order_relaxed);
+  Cell *cell;
+  for (;;) {
+    cell = &cells_[position & mask_];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(sequence - position);
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+
+  Event &event = cell->event;
+  event.timestamp = timestamp;
+  event.thread = ThreadId();
+  event.phase = phase;
+  event.category = category;
+  event.name_size = static_cast<uint8_t>(std::min(name.size(), kMaxName));
+  std::memcpy(event.name, name.data(), event.name_size);
+  cell->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool Tracer::Pop(Event &event) {
+  Cell &cell = cells_[head_ & mask_];
+  if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) {
+    return false;
+  }
+  event = cell.event;
+  cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+  ++head_;
+  return true;
+}
+
+void Tracer::WriterLoop() {
+  std::unique_lock lock(mutex_);
+  while (!wake_.wait_for(lock, options_.flush_interval,
+                         [this] { return stopping_; })) {
+    lock.unlock();
+    WriteEvents();
+    lock.lock();
+  }
+}
+
+void Tracer::WriteEvents() {
+  Event event;
+  while (Pop(event)) {
+    WriteEvent(event);
+    if (chunk_.size() >= kChunkSize) {
+      out_.write(chunk_.data(), chunk_.size());
+      chunk_.clear();
+    }
+  }
+  if (!chunk_.empty()) {
+    out_.write(chunk_.data(), chunk_.size());
+    out_.flush();
+    chunk_.clear();
+  }
+}
+
+void Tracer::WriteEvent(const Event &event) {
+  if (written_ != 0) {
+    chunk_ += ",\n";
+  }
+  chunk_ += "{\"name\":\"";
+  AppendEscaped(chunk_, std::string_view(event.name, event.name_size));
+  chunk_ += "\",\"cat\":\"";
+  chunk_ += CategoryName(event.category);
+  // Microseconds, with the nanoseconds as the fraction.
+  char rest[96];
+  std::snprintf(rest, sizeof(rest),
+                "\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u}",
+                event.phase,
+                static_cast<unsigned long long>(event.timestamp / 1000),
+                static_cast<unsigned>(event.timestamp % 1000), event.thread);
+  chunk_ += rest;
+  ++written_;
+}
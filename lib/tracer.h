@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct TraceOptions {
+  // Records one in this many function and builtin calls. Phases are always
+  // recorded.
+  uint32_t sample_every = 1;
+  // Calls shorter than this are dropped. With a nonzero threshold a call's
+  // events are only written when it returns, so a call that never returns
+  // does not show up.
+  std::chrono::microseconds min_duration{0};
+  // Only calls whose name contains one of these strings are recorded;
+  // empty records every call.
+  std::vector<std::string> filter;
+  // Events the ring buffer holds between two flushes, rounded up to a power
+  // of two. Events that do not fit are dropped and counted.
+  size_t buffer_events = 1 << 16;
+  std::chrono::microseconds flush_interval{2000};
+};
+
+// Writes begin and end events of the compilation phases, user function
+// calls and builtin calls in the Chrome trace-event JSON format, which
+// chrome://tracing and Perfetto open. Threads that record events only copy
+// them into a lock-free ring buffer; a background thread formats them and
+// writes them out, so the cost of tracing a call does not depend on the
+// output.
+//
+// One tracer can be shared by several isolates running on different
+// threads; each thread gets its own track.
+class Tracer {
+public:
+  enum struct Category : uint8_t { PHASE, FUNCTION, BUILTIN };
+
+  explicit Tracer(std::ostream &out, TraceOptions options = {});
+  ~Tracer();
+
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+
+  // Starts and stops the writing thread. Stop writes out the remaining
+  // events and completes the JSON document.
+  void Start();
+  void Stop();
+
+  // Whether a call of `name` is recorded, after filtering and sampling.
+  // Counts towards the sampling period, so it is asked once per call.
+  bool Wants(Category category, std::string_view name);
+
+  // Nanoseconds since the tracer was created.
+  uint64_t Now() const;
+
+  // Queues an event with the given timestamp; false when the buffer is
+  // full and the event was dropped.
+  bool Begin(Category category, std::string_view name, uint64_t timestamp);
+  bool End(Category category, std::string_view name, uint64_t timestamp);
+
+  std::chrono::microseconds MinDuration() const {
+    return options_.min_duration;
+  }
+
+  // Events written so far and events dropped because the buffer was full.
+  uint64_t Written() const { return written_; }
+  uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  // Longer names are truncated.
+  static constexpr size_t kMaxName = 47;
+
+  struct Event {
+    uint64_t timestamp;
+    uint32_t thread;
+    char phase;
+    Category category;
+    uint8_t name_size;
+    char name[kMaxName];
+  };
+
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence;
+    Event event;
+  };
+
+  bool Push(char phase, Category category, std::string_view name,
+            uint64_t timestamp);
+  bool Pop(Event &event);
+  void WriterLoop();
+  void WriteEvents();
+  void WriteEvent(const Event &event);
+
+  std::ostream &out_;
+  TraceOptions options_;
+  std::chrono::steady_clock::time_point start_;
+
+  // Bounded multi-producer queue: a producer claims a cell by advancing
+  // tail_, and each cell's sequence tells whose turn it is to use it.
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> tail_ = 0;
+  alignas(64) size_t head_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::atomic<uint64_t> calls_ = 0;
+
+  // Used only by the writing thread, and by Stop after it has finished.
+  std::string chunk_;
+  uint64_t written_ = 0;
+
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  bool started_ = false;
+};
+
+// Records a phase or call as a pair of events for a scope, if there is a
+// tracer and it wants the call.
+class TraceScope {
+public:
+  TraceScope(Tracer *tracer, Tracer::Category category, std::string_view name)
+      : tracer_(tracer), category_(category), name_(name) {
+    if (tracer_ == nullptr) {
+      return;
+    }
+    if (!tracer_->Wants(category_, name_)) {
+      tracer_ = nullptr;
+      return;
+    }
+    if (category_ != Tracer::Category::PHASE) {
+      min_duration_ = uint64_t(tracer_->MinDuration().count()) * 1000;
+    }
+    begin_ = tracer_->Now();
+    if (min_duration_ == 0 && !tracer_->Begin(category_, name_, begin_)) {
+      tracer_ = nullptr;
+    }
+  }
+  ~TraceScope() {
+    if (tracer_ == nullptr) {
+      return;
+    }
+    uint64_t end = tracer_->Now();
+    if (min_duration_ != 0 && (end - begin_ < min_duration_ ||
+                               !tracer_->Begin(category_, name_, begin_))) {
+      return;
+    }
+    tracer_->End(category_, name_, end);
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  Tracer *tracer_;
+  Tracer::Category category_;
+  std::string_view name_;
+  // Nonzero when the begin event waits for the end of the call.
+  uint64_t min_duration_ = 0;
+  uint64_t begin_ = 0;
+};
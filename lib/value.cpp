@@ -0,0 +1,153 @@
+#include "value.h"
+
+#include <cstring>
+
+namespace {
+
+// Short strings fit into std::string's inline buffer; copying them is
+// cheaper than sharing.
+constexpr size_t kMinSharedStringSize = 16;
+constexpr size_t kMinSharedListSize = 8;
+
+// A slice that uses less than 1/kMaxPinRatio of the buffer it would keep
+// alive is copied out, so a small view never pins a large buffer, however
+// many slices of slices led to it.
+constexpr size_t kMaxPinRatio = 8;
+
+// Concatenations shorter than this produce a plain std::string. Longer ones
+// go into an AppendBuffer with room for kAppendGrowth times the result, so
+// a string grown piece by piece is reallocated only logarithmically often.
+constexpr size_t kMinAppendStringSize = 64;
+constexpr size_t kAppendGrowth = 2;
+
+ElementKind ScanKind(std::span<const Value> elems) {
+  if (elems.empty()) {
+    return ElementKind::MIXED;
+  }
+  ElementKind kind = Value::KindOf(elems.front());
+  for (const Value &el : elems.subspan(1)) {
+    if (kind == ElementKind::MIXED) {
+      break;
+    }
+    if (Value::KindOf(el) != kind) {
+      kind = ElementKind::MIXED;
+    }
+  }
+  return kind;
+}
+
+} // namespace
+
+Value Value::MakeList(std::vector<Value> &&elems, ElementKind kind) {
+  if (elems.size() < kMinSharedListSize) {
+    return Value(std::move(elems));
+  }
+  auto owner = std::make_shared<const std::vector<Value>>(std::move(elems));
+  size_t size = owner->size();
+  return ListSlice{std::move(owner), 0, size, kind};
+}
+
+ElementKind Value::ListKind() const {
+  if (auto l = std::get_if<ListSlice>(this)) {
+    return l->kind;
+  }
+  return ScanKind(GetListView());
+}
+
+void Value::Share() {
+  if (auto s = std::get_if<std::string>(this)) {
+    if (s->size() < kMinSharedStringSize) {
+      return;
+    }
+    auto owner = std::make_shared<const std::string>(std::move(*s));
+    std::string_view view = *owner;
+    *this = StringSlice{std::move(owner), view};
+    return;
+  }
+
+  if (auto l = std::get_if<std::vector<Value>>(this)) {
+    if (l->size() < kMinSharedListSize) {
+      return;
+    }
+    // The one pass over the elements a list ever gets: slices and copies
+    // of the shared buffer inherit its kind.
+    ElementKind kind = ScanKind(*l);
+    auto owner = std::make_shared<const std::vector<Value>>(std::move(*l));
+    size_t size = owner->size();
+    *this = ListSlice{std::move(owner), 0, size, kind};
+  }
+}
+
+Value Value::Concat(const Value &left, const Value &right) {
+  std::string_view l = left.GetStringView();
+  std::string_view r = right.GetStringView();
+  size_t size = l.size() + r.size();
+
+  if (auto s = std::get_if<AppendString>(&left)) {
+    AppendBuffer &buffer = *s->buffer;
+    size_t expected = s->size;
+    if (size <= buffer.capacity &&
+        buffer.used.compare_exchange_strong(expected, size)) {
+      std::memcpy(buffer.data.get() + s->size, r.data(), r.size());
+      return AppendString{s->buffer, size};
+    }
+  }
+
+  if (size < kMinAppendStringSize) {
+    std::string res;
+    res.reserve(size);
+    res.append(l);
+    res.append(r);
+    return res;
+  }
+
+  auto buffer = std::make_shared<AppendBuffer>(size * kAppendGrowth);
+  std::memcpy(buffer->data.get(), l.data(), l.size());
+  std::memcpy(buffer->data.get() + l.size(), r.data(), r.size());
+  buffer->used = size;
+  return AppendString{std::move(buffer), size};
+}
+
+Value Value::Slice(size_t start, size_t size, bool allow_pinning) {
+  if (IsString()) {
+    std::string_view whole = GetStringView();
+    std::string_view part = whole.substr(start, size);
+    size_t pinned = whole.size();
+    if (auto s = std::get_if<AppendString>(this)) {
+      pinned = s->buffer->capacity;
+    } else if (auto s = std::get_if<StringSlice>(this)) {
+      pinned = s->owner_size;
+    }
+    if (part.size() < kMinSharedStringSize ||
+        (!allow_pinning && part.size() * kMaxPinRatio < pinned)) {
+      return std::string(part);
+    }
+
+    if (auto s = std::get_if<AppendString>(this)) {
+      return StringSlice{s->buffer, part, pinned};
+    }
+    Share();
+    auto slice = std::get_if<StringSlice>(this);
+    return StringSlice{slice->owner, slice->view.substr(start, size),
+                       slice->owner_size};
+  }
+
+  if (IsList()) {
+    std::span<const Value> whole = GetListView();
+    std::span<const Value> part = whole.subspan(start, size);
+    size_t pinned = whole.size();
+    if (auto l = std::get_if<ListSlice>(this)) {
+      pinned = l->owner->size();
+    }
+    if (part.size() < kMinSharedListSize ||
+        (!allow_pinning && part.size() * kMaxPinRatio < pinned)) {
+      return std::vector<Value>(part.begin(), part.end());
+    }
+
+    Share();
+    auto slice = std::get_if<ListSlice>(this);
+    return ListSlice{slice->owner, slice->offset + start, size, slice->kind};
+  }
+
+  throw std::runtime_error("Only strings and lists can be sliced");
+}
@@ -1,17 +1,54 @@
 #pragma once
 
+#include "append_string.h"
 #include "function.h"
+#include "iterator.h"
+#include "number_array.h"
+#include "string_slice.h"
+#include <cstdint>
 #include <iostream>
+#include <span>
 #include <variant>
 
+class Value;
+class Task;
+class DictTable;
+
+// What every element of a list is known to be. Shared list buffers record
+// it once when they are created, so builtins can take a specialized loop
+// without checking each element. MIXED only means nothing more specific is
+// known.
+enum struct ElementKind { MIXED, NUMBER, STRING };
+
+// Part of a list that shares the parent's elements, see StringSlice.
+struct ListSlice {
+  std::shared_ptr<const std::vector<Value>> owner;
+  size_t offset;
+  size_t size;
+  ElementKind kind = ElementKind::MIXED;
+};
+
+// Dictionary from numbers and strings to values (see dict.h). Dicts behave
+// like values: copying one only shares the table, and the table is cloned
+// before a write if anything else still refers to it.
+struct Dict {
+  std::shared_ptr<DictTable> table;
+};
+
 class Value
     : public std::variant<double, std::string, bool, std::nullptr_t,
                           std::function<Value(const std::vector<Value> &)>,
-                          std::vector<Value>, std::shared_ptr<Function>> {
+                          std::vector<Value>, std::shared_ptr<Function>,
+                          std::shared_ptr<Iterator>, StringSlice,
+                          ListSlice, AppendString, std::shared_ptr<Task>,
+                          NumberArray, Dict, int64_t> {
                             
   using base = std::variant<double, std::string, bool, std::nullptr_t,
                             std::function<Value(const std::vector<Value> &)>,
-                            std::vector<Value>, std::shared_ptr<Function>>;
+                            std::vector<Value>, std::shared_ptr<Function>,
+                            std::shared_ptr<Iterator>, StringSlice,
+                            ListSlice, AppendString, std::shared_ptr<Task>,
+                            NumberArray, Dict, int64_t>;
 
 public:
   using base::base;
@@ -20,4 +57,101 @@ public:
   static Value MakeList(std::vector<Value> &&elems) {
     return Value(std::move(elems));
   }
+
+  // List of `elems`, all of which are known to be of `kind`. Large lists
+  // go straight into a shared buffer tagged with the kind, so it is never
+  // computed from the elements.
+  static Value MakeList(std::vector<Value> &&elems, ElementKind kind);
+
+  // NUMBER for numbers, STRING for strings, MIXED for everything else.
+  static ElementKind KindOf(const Value &v) {
+    if (v.IsNumber()) {
+      return ElementKind::NUMBER;
+    }
+    return v.IsString() ? ElementKind::STRING : ElementKind::MIXED;
+  }
+
+  // Kind shared by every element of a list value. Free for shared lists,
+  // which carry it; a std::vector is scanned. MIXED for empty lists and
+  // for values of other types.
+  ElementKind ListKind() const;
+
+  // True for both number representations: double, and int64_t for whole
+  // numbers kept exact (see number_ops.h).
+  bool IsNumber() const {
+    return std::holds_alternative<double>(*this) ||
+           std::holds_alternative<int64_t>(*this);
+  }
+
+  // A number as a double; 0 for values of other types.
+  double GetNumber() const {
+    if (auto d = std::get_if<double>(this)) {
+      return *d;
+    }
+    if (auto i = std::get_if<int64_t>(this)) {
+      return static_cast<double>(*i);
+    }
+    return 0;
+  }
+
+  // True for every string representation (std::string, StringSlice or
+  // AppendString).
+  bool IsString() const {
+    return std::holds_alternative<std::string>(*this) ||
+           std::holds_alternative<StringSlice>(*this) ||
+           std::holds_alternative<AppendString>(*this);
+  }
+
+  // Characters of a string value, valid while this Value is alive. Empty for
+  // values of other types.
+  std::string_view GetStringView() const {
+    if (auto s = std::get_if<std::string>(this)) {
+      return *s;
+    }
+    if (auto s = std::get_if<StringSlice>(this)) {
+      return s->view;
+    }
+    if (auto s = std::get_if<AppendString>(this)) {
+      return s->View();
+    }
+    return {};
+  }
+
+  // True for every list representation (std::vector or ListSlice).
+  bool IsList() const {
+    return std::holds_alternative<std::vector<Value>>(*this) ||
+           std::holds_alternative<ListSlice>(*this);
+  }
+
+  // Elements of a list value, valid while this Value is alive. Empty for
+  // values of other types.
+  std::span<const Value> GetListView() const {
+    if (auto l = std::get_if<std::vector<Value>>(this)) {
+      return *l;
+    }
+    if (auto l = std::get_if<ListSlice>(this)) {
+      return std::span<const Value>(l->owner->data() + l->offset, l->size);
+    }
+    return {};
+  }
+
+  // Copy of the elements of a list value that the caller may modify.
+  std::vector<Value> CopyList() const {
+    std::span<const Value> view = GetListView();
+    return std::vector<Value>(view.begin(), view.end());
+  }
+
+  // Strings and lists are immutable once created, so a large std::string or
+  // std::vector payload can be moved into a shared buffer. After that,
+  // copying this value or slicing it only bumps a reference count.
+  void Share();
+
+  // Concatenation of two string values. Large results are AppendStrings,
+  // and appending to the newest AppendString of a buffer does not copy it.
+  static Value Concat(const Value &left, const Value &right);
+
+  // Elements [start, start + size) of a string or list value. The result
+  // shares this value's buffer unless it is tiny or, when pinning is not
+  // allowed, uses only a small part of the buffer it would keep alive.
+  Value Slice(size_t start, size_t size, bool allow_pinning = false);
 };
@@ -0,0 +1,394 @@
+#include "value_sort.h"
+#include "number_ops.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Below this size std::sort beats the fixed cost of the radix passes.
+constexpr size_t kMinRadixSortSize = 512;
+
+// Lists this long are split into chunks sorted on separate threads and
+// then merged pairwise, also in parallel.
+constexpr size_t kMinParallelSortSize = 1 << 16;
+constexpr size_t kMinParallelChunkSize = 1 << 14;
+
+enum struct TypeRank { NIL, BOOL, NUMBER, STRING, LIST };
+
+TypeRank RankOf(const Value &v) {
+  if (std::holds_alternative<std::nullptr_t>(v)) {
+    return TypeRank::NIL;
+  }
+  if (std::holds_alternative<bool>(v)) {
+    return TypeRank::BOOL;
+  }
+  if (v.IsNumber()) {
+    return TypeRank::NUMBER;
+  }
+  if (v.IsString()) {
+    return TypeRank::STRING;
+  }
+  if (v.IsList()) {
+    return TypeRank::LIST;
+  }
+  throw std::runtime_error("Functions and iterators can not be sorted");
+}
+
+// Maps a number to an unsigned integer with the same order, so numbers can
+// be radix sorted. -0.0 equals 0.0, and every NaN sorts last.
+uint64_t OrderedBits(double d) {
+  constexpr uint64_t kSign = uint64_t(1) << 63;
+  if (std::isnan(d)) {
+    return UINT64_MAX;
+  }
+  if (d == 0) {
+    d = 0;
+  }
+  uint64_t bits = std::bit_cast<uint64_t>(d);
+  return (bits & kSign) ? ~bits : bits | kSign;
+}
+
+double NumberFromOrderedBits(uint64_t bits) {
+  constexpr uint64_t kSign = uint64_t(1) << 63;
+  return std::bit_cast<double>((bits & kSign) ? bits & ~kSign : ~bits);
+}
+
+// Same for integers: flipping the sign bit orders them as unsigned.
+uint64_t IntegerBits(int64_t i) {
+  return static_cast<uint64_t>(i) ^ (uint64_t(1) << 63);
+}
+
+int64_t IntegerFromBits(uint64_t bits) {
+  return static_cast<int64_t>(bits ^ (uint64_t(1) << 63));
+}
+
+// Integers up to 2^53 in magnitude convert to doubles exactly.
+constexpr int64_t kMaxExactInteger = int64_t(1) << 53;
+
+// Big-endian first eight bytes of a string, zero padded. Comparing these
+// orders strings like comparing their first eight bytes.
+uint64_t Prefix(std::string_view s) {
+  unsigned char bytes[8] = {};
+  std::memcpy(bytes, s.data(), std::min<size_t>(s.size(), 8));
+  uint64_t prefix = 0;
+  for (unsigned char b : bytes) {
+    prefix = prefix << 8 | b;
+  }
+  return prefix;
+}
+
+struct NumberRecord {
+  uint64_t key;
+  size_t index;
+};
+
+struct StringRecord {
+  uint64_t prefix;
+  std::string_view view;
+  size_t index;
+};
+
+struct ValueRecord {
+  const Value *value;
+  size_t index;
+};
+
+uint64_t RadixKey(uint64_t key) { return key; }
+uint64_t RadixKey(const NumberRecord &r) { return r.key; }
+
+// LSD radix sort on 8-bit digits. All histograms are built in one pass,
+// and passes over a digit that is the same for every key are skipped. The
+// result is stable.
+template <class Record> void RadixSort(std::vector<Record> &records) {
+  std::array<std::array<size_t, 256>, 8> counts = {};
+  for (const Record &r : records) {
+    uint64_t key = RadixKey(r);
+    for (int digit = 0; digit < 8; ++digit) {
+      ++counts[digit][(key >> (digit * 8)) & 0xFF];
+    }
+  }
+
+  std::vector<Record> buffer(records.size());
+  for (int digit = 0; digit < 8; ++digit) {
+    auto &count = counts[digit];
+    if (std::find(count.begin(), count.end(), records.size()) != count.end()) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (size_t &c : count) {
+      size_t next = offset + c;
+      c = offset;
+      offset = next;
+    }
+    for (const Record &r : records) {
+      buffer[count[(RadixKey(r) >> (digit * 8)) & 0xFF]++] = r;
+    }
+    records.swap(buffer);
+  }
+}
+
+template <class Record, class Less>
+void SortNumbers(std::vector<Record> &records, Less less, bool stable) {
+  if (records.size() >= kMinRadixSortSize) {
+    RadixSort(records);
+  } else if (stable) {
+    std::stable_sort(records.begin(), records.end(), less);
+  } else {
+    std::sort(records.begin(), records.end(), less);
+  }
+}
+
+template <class Record, class Less>
+void SequentialSort(Record *first, Record *last, Less less, bool stable) {
+  if (stable) {
+    std::stable_sort(first, last, less);
+  } else {
+    std::sort(first, last, less);
+  }
+}
+
+// Sorts chunks of the records on separate threads, then merges neighbouring
+// runs in rounds until one is left. std::merge prefers the left run on
+// ties, so the result is stable whenever the chunk sorts are.
+template <class Record, class Less>
+void ParallelMergeSort(std::vector<Record> &records, Less less, bool stable) {
+  size_t size = records.size();
+  size_t chunks = std::min<size_t>(std::thread::hardware_concurrency(),
+                                   size / kMinParallelChunkSize);
+  if (chunks < 2) {
+    SequentialSort(records.data(), records.data() + size, less, stable);
+    return;
+  }
+
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i <= chunks; ++i) {
+    bounds.push_back(size * i / chunks);
+  }
+
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < chunks; ++i) {
+      workers.emplace_back([&, i] {
+        SequentialSort(records.data() + bounds[i],
+                       records.data() + bounds[i + 1], less, stable);
+      });
+    }
+  }
+
+  std::vector<Record> buffer(size);
+  while (bounds.size() > 2) {
+    std::vector<size_t> merged = {0};
+    {
+      std::vector<std::jthread> workers;
+      size_t i = 0;
+      for (; i + 2 < bounds.size(); i += 2) {
+        size_t low = bounds[i], middle = bounds[i + 1], high = bounds[i + 2];
+        workers.emplace_back([&, low, middle, high] {
+          std::merge(records.data() + low, records.data() + middle,
+                     records.data() + middle, records.data() + high,
+                     buffer.data() + low, less);
+        });
+        merged.push_back(high);
+      }
+      if (i + 1 < bounds.size()) {
+        std::copy(records.data() + bounds[i], records.data() + size,
+                  buffer.data() + bounds[i]);
+        merged.push_back(size);
+      }
+    }
+    records.swap(buffer);
+    bounds = std::move(merged);
+  }
+}
+
+template <class Record, class Less>
+void SortRecords(std::vector<Record> &records, Less less, bool stable) {
+  if (records.size() >= kMinParallelSortSize) {
+    ParallelMergeSort(records, less, stable);
+  } else {
+    SequentialSort(records.data(), records.data() + records.size(), less,
+                   stable);
+  }
+}
+
+template <class Record>
+void ApplyOrder(std::vector<Value> &values,
+                const std::vector<Record> &records) {
+  std::vector<Value> sorted;
+  sorted.reserve(values.size());
+  for (const Record &r : records) {
+    sorted.push_back(std::move(values[r.index]));
+  }
+  values = std::move(sorted);
+}
+
+} // namespace
+
+int CompareValues(const Value &l, const Value &r) {
+  TypeRank lrank = RankOf(l);
+  TypeRank rrank = RankOf(r);
+  if (lrank != rrank) {
+    return lrank < rrank ? -1 : 1;
+  }
+
+  switch (lrank) {
+  case TypeRank::NIL:
+    return 0;
+  case TypeRank::BOOL:
+    return int(std::get<bool>(l)) - int(std::get<bool>(r));
+  case TypeRank::NUMBER: {
+    // NaN sorts after every other number.
+    std::partial_ordering order = CompareNumbers(l, r);
+    if (order == std::partial_ordering::unordered) {
+      bool lnan = std::isnan(l.GetNumber());
+      bool rnan = std::isnan(r.GetNumber());
+      return int(lnan) - int(rnan);
+    }
+    return order < 0 ? -1 : (order > 0 ? 1 : 0);
+  }
+  case TypeRank::STRING:
+    return l.GetStringView().compare(r.GetStringView());
+  case TypeRank::LIST: {
+    std::span<const Value> lv = l.GetListView();
+    std::span<const Value> rv = r.GetListView();
+    for (size_t i = 0; i < lv.size() && i < rv.size(); ++i) {
+      if (int c = CompareValues(lv[i], rv[i]); c != 0) {
+        return c;
+      }
+    }
+    return lv.size() < rv.size() ? -1 : (lv.size() > rv.size() ? 1 : 0);
+  }
+  }
+  return 0;
+}
+
+void SortValues(std::vector<Value> &values, const std::vector<Value> *keys,
+                bool stable, ElementKind kind) {
+  const std::vector<Value> &order = keys ? *keys : values;
+  if (order.size() != values.size()) {
+    throw std::runtime_error("Every element needs one sort key");
+  }
+  if (order.empty()) {
+    return;
+  }
+
+  if (keys) {
+    kind = ElementKind::MIXED;
+  }
+  auto all_of_rank = [&order](TypeRank rank) {
+    return std::all_of(order.begin(), order.end(), [rank](const Value &v) {
+      return RankOf(v) == rank;
+    });
+  };
+
+  if (kind == ElementKind::NUMBER ||
+      (kind == ElementKind::MIXED && all_of_rank(TypeRank::NUMBER))) {
+    // Integers and doubles are radix sorted on their own keys. Next to
+    // doubles, integers are keyed as doubles, which is exact up to 2^53;
+    // larger ones are left to the comparison sort below.
+    bool integers = std::all_of(order.begin(), order.end(), [](auto &v) {
+      return std::holds_alternative<int64_t>(v);
+    });
+    bool doubles = !integers && std::all_of(order.begin(), order.end(),
+                                            [](const Value &v) {
+                                              return std::holds_alternative<
+                                                  double>(v);
+                                            });
+    bool exact = integers || doubles ||
+                 std::all_of(order.begin(), order.end(), [](const Value &v) {
+                   auto i = std::get_if<int64_t>(&v);
+                   return i == nullptr ||
+                          (*i <= kMaxExactInteger && *i >= -kMaxExactInteger);
+                 });
+    if (exact) {
+      auto key_of = [integers](const Value &v) {
+        return integers ? IntegerBits(std::get<int64_t>(v))
+                        : OrderedBits(v.GetNumber());
+      };
+
+      // Lists of one representation without -0.0 and NaN are fully
+      // described by their keys, so sorting the keys alone is enough and
+      // the values are rebuilt from them. Otherwise equal keys may stand for
+      // different values, and records carry the element index.
+      bool plain =
+          !keys && (integers ||
+                    (doubles &&
+                     std::none_of(order.begin(), order.end(),
+                                  [](const Value &v) {
+                                    double d = std::get<double>(v);
+                                    return std::isnan(d) ||
+                                           (d == 0 && std::signbit(d));
+                                  })));
+      if (plain) {
+        std::vector<uint64_t> sorted(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+          sorted[i] = key_of(order[i]);
+        }
+        SortNumbers(sorted, std::less<uint64_t>(), stable);
+        for (size_t i = 0; i < sorted.size(); ++i) {
+          if (integers) {
+            values[i] = IntegerFromBits(sorted[i]);
+          } else {
+            values[i] = NumberFromOrderedBits(sorted[i]);
+          }
+        }
+        return;
+      }
+
+      std::vector<NumberRecord> records(order.size());
+      for (size_t i = 0; i < order.size(); ++i) {
+        records[i] = {key_of(order[i]), i};
+      }
+      SortNumbers(
+          records,
+          [](const NumberRecord &a, const NumberRecord &b) {
+            return a.key < b.key;
+          },
+          stable);
+      ApplyOrder(values, records);
+      return;
+    }
+  }
+
+  if (kind == ElementKind::STRING ||
+      (kind == ElementKind::MIXED && all_of_rank(TypeRank::STRING))) {
+    std::vector<StringRecord> records(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      std::string_view view = order[i].GetStringView();
+      records[i] = {Prefix(view), view, i};
+    }
+    SortRecords(
+        records,
+        [](const StringRecord &a, const StringRecord &b) {
+          if (a.prefix != b.prefix) {
+            return a.prefix < b.prefix;
+          }
+          return a.view < b.view;
+        },
+        stable);
+    ApplyOrder(values, records);
+    return;
+  }
+
+  // Mixed lists are rare and their comparisons may throw, so they are
+  // sorted on this thread only.
+  std::vector<ValueRecord> records(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    records[i] = {&order[i], i};
+  }
+  SequentialSort(
+      records.data(), records.data() + records.size(),
+      [](const ValueRecord &a, const ValueRecord &b) {
+        return CompareValues(*a.value, *b.value) < 0;
+      },
+      stable);
+  ApplyOrder(values, records);
+}
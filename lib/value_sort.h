@@ -0,0 +1,22 @@
+#pragma once
+
+#include "value.h"
+#include <vector>
+
+// Total order used by sort. Values of different types are ordered nil,
+// bool, number, string, list; lists compare lexicographically. NaN sorts
+// after every other number. Returns a negative number, zero or a positive
+// number like strcmp. Throws for functions and iterators.
+int CompareValues(const Value &l, const Value &r);
+
+// Sorts `values` in place. With `keys`, which hold one value per element,
+// the elements are ordered by their keys. A stable sort keeps elements that
+// compare equal in their original order.
+//
+// Lists of numbers are radix sorted on unboxed keys, strings are compared
+// by a cached 8-byte prefix first, and large lists are sorted in parallel.
+// `kind` is what the elements of `values` are known to be (see
+// Value::ListKind); without keys, a NUMBER or STRING kind saves the scan
+// that picks the specialized sort.
+void SortValues(std::vector<Value> &values, const std::vector<Value> *keys,
+                bool stable, ElementKind kind = ElementKind::MIXED);
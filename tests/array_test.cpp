@@ -0,0 +1,131 @@
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <lib/array_kernels.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+namespace {
+
+// Runs every check once per SIMD level this CPU supports.
+class ArrayKernelsTest : public ::testing::TestWithParam<SimdLevel> {
+protected:
+  void SetUp() override {
+    if (GetParam() > DetectSimdLevel()) {
+      GTEST_SKIP();
+    }
+    SetSimdLevel(GetParam());
+  }
+
+  void TearDown() override { SetSimdLevel(DetectSimdLevel()); }
+};
+
+} // namespace
+
+TEST_P(ArrayKernelsTest, Elementwise) {
+  // Odd sizes leave a tail after every vector width.
+  for (size_t size : {0, 1, 3, 7, 8, 9, 33}) {
+    std::vector<double> l(size), r(size), out(size);
+    for (size_t i = 0; i < size; ++i) {
+      l[i] = double(i) + 0.5;
+      r[i] = double(size - i);
+    }
+
+    ApplyArrayOp(ArrayOp::ADD, l.data(), r.data(), out.data(), size);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(out[i], l[i] + r[i]);
+    }
+    ApplyArrayOp(ArrayOp::SUB, l.data(), 2.0, out.data(), size);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(out[i], l[i] - 2);
+    }
+    ApplyArrayOp(ArrayOp::DIV, 1.0, r.data(), out.data(), size);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(out[i], 1 / r[i]);
+    }
+    ApplyArrayOp(ArrayOp::POW, l.data(), 2.0, out.data(), size);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(out[i], std::pow(l[i], 2));
+    }
+    // In place.
+    ApplyArrayOp(ArrayOp::MUL, l.data(), l.data(), l.data(), size);
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(l[i], (double(i) + 0.5) * (double(i) + 0.5));
+    }
+  }
+}
+
+TEST_P(ArrayKernelsTest, Reductions) {
+  for (size_t size : {1, 2, 5, 8, 13, 100}) {
+    std::vector<double> v(size);
+    for (size_t i = 0; i < size; ++i) {
+      v[i] = double((i * 7) % 11) - 5;
+    }
+    double sum = 0, dot = 0;
+    for (double x : v) {
+      sum += x;
+      dot += x * x;
+    }
+    ASSERT_EQ(ArraySum(v), sum);
+    ASSERT_EQ(ArrayDot(v, v), dot);
+    ASSERT_EQ(ArrayMin(v), *std::min_element(v.begin(), v.end()));
+    ASSERT_EQ(ArrayMax(v), *std::max_element(v.begin(), v.end()));
+    ASSERT_FALSE(ContainsZero(std::vector<double>(size, 1)));
+    v[size - 1] = -0.0;
+    ASSERT_TRUE(ContainsZero(v));
+  }
+
+  std::vector<double> nan_later = {1, std::nan(""), -1, 3, 2, 0, 5, -2, 4};
+  ASSERT_EQ(ArrayMin(nan_later), -2);
+  ASSERT_EQ(ArrayMax(nan_later), 5);
+  std::vector<double> nan_first = {std::nan(""), 1, 2, 3, 4, 5};
+  ASSERT_TRUE(std::isnan(ArrayMin(nan_first)));
+}
+
+INSTANTIATE_TEST_SUITE_P(ArrayKernelsSuite, ArrayKernelsTest,
+                         ::testing::Values(SimdLevel::SCALAR, SimdLevel::SSE2,
+                                           SimdLevel::AVX2));
+
+TEST(ArraySuite, Arithmetic) {
+  ASSERT_EQ(RunScript(R"(
+        a = to_array([1, 2, 3, 4])
+        b = array(4, 2)
+        c = a + b
+        d = a - 1
+        e = 10 * a
+        f = a / b
+        g = a ^ 2
+        h = 1 - a
+        println(c, d, e, f, g, h)
+        tail = a[2:]
+        println(len(a), " ", a[2], " ", a[1:3], " ", to_list(tail))
+    )"),
+            "[3, 4, 5, 6][0, 1, 2, 3][10, 20, 30, 40][0.5, 1, 1.5, 2]"
+            "[1, 4, 9, 16][0, -1, -2, -3]\n4 3 [2, 3] [3, 4]\n");
+}
+
+TEST(ArraySuite, Reductions) {
+  ASSERT_EQ(RunScript(R"(
+        a = to_array([3, -1, 4, 1, 5])
+        println(sum(a), " ", min(a), " ", max(a), " ", dot(a, a))
+        println(sum([1, 2, 3]), " ", max([2, 7, 1]))
+        total = 0
+        for x in a[1:4] then
+            total += x
+        end for
+        println(total)
+    )"),
+            "12 -1 5 52\n6 7\n4\n");
+}
+
+TEST(ArraySuite, Errors) {
+  for (std::string code : {"a = array(3) / array(3, 0)", "a = array(2) / 0",
+                           "a = array(2) + array(3)", "a = array(2) == 1",
+                           "a = to_array([1, \"x\"])", "a = min(array(0))"}) {
+    std::istringstream input(code);
+    std::ostringstream output;
+    ASSERT_FALSE(interpret(input, output)) << code;
+  }
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <lib/dict.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+TEST(DictTableSuite, SetFindErase) {
+  DictTable table;
+  for (int i = 0; i < 1000; ++i) {
+    table.Set(Value(double(i)), Value(double(i * i)));
+    table.Set(Value("k" + std::to_string(i)), Value(double(-i)));
+  }
+  ASSERT_EQ(table.Size(), 2000);
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(table.Erase(Value(double(i))));
+  }
+  ASSERT_FALSE(table.Erase(Value(0.0)));
+  ASSERT_EQ(table.Size(), 1500);
+
+  for (int i = 0; i < 1000; ++i) {
+    const Value *number = table.Find(Value(double(i)));
+    if (i % 2 == 0) {
+      ASSERT_EQ(number, nullptr);
+    } else {
+      ASSERT_NE(number, nullptr);
+      ASSERT_EQ(std::get<double>(*number), i * i);
+    }
+    const Value *string = table.Find(Value("k" + std::to_string(i)));
+    ASSERT_NE(string, nullptr);
+    ASSERT_EQ(std::get<double>(*string), -i);
+  }
+}
+
+TEST(DictTableSuite, KeysAreNormalized) {
+  DictTable table;
+  table.Set(Value(-0.0), Value(1.0));
+  ASSERT_NE(table.Find(Value(0.0)), nullptr);
+  // A slice and a std::string with the same characters are the same key.
+  auto owner = std::make_shared<const std::string>("abcdef");
+  table.Set(Value(StringSlice{owner, std::string_view(*owner).substr(1, 3)}),
+            Value(2.0));
+  ASSERT_EQ(std::get<double>(*table.Find(Value(std::string("bcd")))), 2);
+  ASSERT_EQ(table.Size(), 2);
+  ASSERT_THROW(table.Set(Value(std::nan("")), Value(1.0)), std::runtime_error);
+  ASSERT_THROW(table.Set(Value(true), Value(1.0)), std::runtime_error);
+}
+
+TEST(DictTableSuite, IterationKeepsInsertionOrder) {
+  DictTable table;
+  for (int i = 0; i < 100; ++i) {
+    table.Set(Value(double(i)), Value(nullptr));
+  }
+  for (int i = 0; i < 100; i += 3) {
+    table.Erase(Value(double(i)));
+  }
+  // Inserting after erasing rebuilds the index at some point; the order of
+  // the remaining entries must survive that.
+  for (int i = 100; i < 200; ++i) {
+    table.Set(Value(double(i)), Value(nullptr));
+  }
+  std::vector<double> keys;
+  size_t position = 0;
+  while (const Value *key = table.NextKey(position)) {
+    keys.push_back(std::get<double>(*key));
+  }
+  ASSERT_EQ(keys.size(), table.Size());
+  ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+TEST(DictSuite, LiteralIndexAndPrint) {
+  ASSERT_EQ(RunScript(R"(
+        d = {"a": 1, "b": "x", 3: [1, 2]}
+        println(d["a"], d["b"], d[3])
+        println(d)
+        println(len(d), len({}))
+    )"),
+            "1x[1, 2]\n{a: 1, b: x, 3: [1, 2]}\n30\n");
+}
+
+TEST(DictSuite, AssignmentByIndex) {
+  ASSERT_EQ(RunScript(R"(
+        d = {}
+        d["n"] = 1
+        d["n"] += 41
+        d["s"] = "ab"
+        d["s"] += "cd"
+        d["l"] = [1, 2, 3]
+        d["l"][1] = 20
+        l = [[0, 0], [0, 0]]
+        l[1][0] = 5
+        println(d, l)
+    )"),
+            "{n: 42, s: abcd, l: [1, 20, 3]}[[0, 0], [5, 0]]\n");
+}
+
+TEST(DictSuite, ValueSemantics) {
+  ASSERT_EQ(RunScript(R"(
+        a = {"x": 1}
+        b = a
+        b["x"] = 2
+        c = del(b, "x")
+        println(a, b, c)
+        f = function(d)
+            d["y"] = 1
+            return d
+        end function
+        println(f(a), a)
+    )"),
+            "{x: 1}{x: 2}{}\n{x: 1, y: 1}{x: 1}\n");
+}
+
+TEST(DictSuite, KeysValuesHas) {
+  ASSERT_EQ(RunScript(R"(
+        d = {"b": 2, "a": 1}
+        d["c"] = 3
+        println(keys(d), values(d))
+        println(has(d, "a"), has(d, "z"), has(d, 2))
+        for k in d then
+            print(k)
+        end for
+    )"),
+            "[b, a, c][2, 1, 3]\ntruefalsefalse\nbac");
+}
+
+TEST(DictSuite, GroupBy) {
+  ASSERT_EQ(RunScript(R"(
+        words = ["apple", "avocado", "banana", "cherry", "blueberry"]
+        groups = {}
+        for w in words then
+            k = w[0]
+            if has(groups, k) then
+                groups[k] = push(groups[k], w)
+            else
+                groups[k] = [w]
+            end if
+        end for
+        println(groups)
+    )"),
+            "{a: [apple, avocado], b: [banana, blueberry], c: [cherry]}\n");
+}
+
+TEST(DictSuite, CountsManyKeys) {
+  ASSERT_EQ(RunScript(R"(
+        counts = {}
+        for i in range(0, 20000, 1) then
+            k = i % 1000
+            if has(counts, k) then
+                counts[k] += 1
+            else
+                counts[k] = 1
+            end if
+        end for
+        println(len(counts), " ", counts[999])
+    )"),
+            "1000 20\n");
+}
+
+TEST(DictSuite, Errors) {
+  for (std::string code : {"d = {}\nx = d[\"a\"]", "d = {}\nd[\"a\"] += 1",
+                           "d = {}\nd[true] = 1", "d = {[1]: 2}",
+                           "d = del({}, 1)", "x = keys([1])",
+                           "l = [1]\nl[1] = 2"}) {
+    std::istringstream input(code);
+    std::ostringstream output;
+    ASSERT_FALSE(interpret(input, output)) << code;
+  }
+}
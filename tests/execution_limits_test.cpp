@@ -0,0 +1,159 @@
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <lib/isolate.h>
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr const char *kForever = R"(
+    i = 0
+    while true then
+        i += 1
+    end while
+)";
+
+} // namespace
+
+TEST(ExecutionLimitsSuite, StepLimitStopsEndlessLoop) {
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.max_steps = 10000;
+  Isolate isolate(sink, options);
+
+  ASSERT_FALSE(isolate.Run(kForever));
+  ASSERT_EQ(isolate.Stopped(), StopReason::STEP_LIMIT);
+  ASSERT_EQ(isolate.Error(), "Execution stopped: step limit exceeded");
+  ASSERT_EQ(std::get<int64_t>(isolate.Get("i")), 10000);
+
+  // The isolate stays usable, and every run gets the full budget.
+  ASSERT_TRUE(isolate.Run("i = 0"));
+  ASSERT_EQ(isolate.Stopped(), StopReason::NONE);
+  ASSERT_FALSE(isolate.Run(kForever));
+  ASSERT_EQ(std::get<int64_t>(isolate.Get("i")), 10000);
+}
+
+TEST(ExecutionLimitsSuite, StepsAreIterationsAndCalls) {
+  std::string code = R"(
+    f = function(x)
+        return x
+    end function
+    for i in range(0, 10, 1) then
+        f(i)
+    end for
+  )";
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.max_steps = 20;
+  options.limits.check_interval = 7;
+  Isolate enough(sink, options);
+  ASSERT_TRUE(enough.Run(code));
+
+  options.limits.max_steps = 19;
+  Isolate short_by_one(sink, options);
+  ASSERT_FALSE(short_by_one.Run(code));
+  ASSERT_EQ(short_by_one.Stopped(), StopReason::STEP_LIMIT);
+}
+
+TEST(ExecutionLimitsSuite, DeadlineStopsLoopInFunction) {
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.timeout = milliseconds(50);
+  Isolate isolate(sink, options);
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_FALSE(isolate.Run(R"(
+    spin = function(n)
+        while true then
+            n += 1
+        end while
+    end function
+    spin(0)
+  )"));
+  ASSERT_EQ(isolate.Stopped(), StopReason::DEADLINE);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, milliseconds(5000));
+}
+
+TEST(ExecutionLimitsSuite, AnotherThreadCancels) {
+  std::atomic<bool> cancel = false;
+  std::istringstream input(kForever);
+  std::ostringstream output;
+  InterpretOptions options;
+  options.limits.cancel = &cancel;
+  StopReason reason = StopReason::NONE;
+  options.stop_reason = &reason;
+
+  std::thread canceller([&cancel] {
+    std::this_thread::sleep_for(milliseconds(20));
+    cancel = true;
+  });
+  bool ok = interpret(input, output, options);
+  canceller.join();
+
+  ASSERT_FALSE(ok);
+  ASSERT_EQ(reason, StopReason::CANCELLED);
+  ASSERT_EQ(output.str(), "Execution stopped: cancelled\n");
+}
+
+TEST(ExecutionLimitsSuite, OtherErrorsAreNotStops) {
+  std::istringstream input("x = y + 1");
+  std::ostringstream output;
+  InterpretOptions options;
+  options.limits.max_steps = 100;
+  StopReason reason = StopReason::CANCELLED;
+  options.stop_reason = &reason;
+  ASSERT_FALSE(interpret(input, output, options));
+  ASSERT_EQ(reason, StopReason::NONE);
+}
+
+TEST(ExecutionLimitsSuite, SafePointRunsEveryInterval) {
+  int calls = 0;
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.check_interval = 100;
+  options.limits.safe_point = [&calls] { ++calls; };
+  Isolate isolate(sink, options);
+
+  ASSERT_TRUE(isolate.Run(R"(
+    for i in range(0, 1000, 1) then
+    end for
+  )"));
+  ASSERT_EQ(calls, 10);
+}
+
+TEST(ExecutionLimitsSuite, SafePointCanStopTheRun) {
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.safe_point = [] { throw std::runtime_error("preempted"); };
+  Isolate isolate(sink, options);
+
+  ASSERT_FALSE(isolate.Run(kForever));
+  ASSERT_EQ(isolate.Error(), "preempted");
+  ASSERT_EQ(isolate.Stopped(), StopReason::NONE);
+}
+
+TEST(ExecutionLimitsSuite, WorkersShareTheBudget) {
+  StringSink sink;
+  IsolateOptions options;
+  options.limits.max_steps = 100000;
+  Isolate isolate(sink, options);
+
+  ASSERT_FALSE(isolate.Run(R"(
+    spin = function(x)
+        while true then
+            x += 1
+        end while
+    end function
+    l = range(0, 8, 1)
+    m = pmap(l, spin)
+  )"));
+  ASSERT_EQ(isolate.Stopped(), StopReason::STEP_LIMIT);
+
+  ASSERT_FALSE(isolate.Run(R"(
+    t = spawn(spin, 1)
+    await(t)
+  )"));
+  ASSERT_EQ(isolate.Stopped(), StopReason::STEP_LIMIT);
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/isolate.h>
+
+#include "test_helpers.h"
+
+namespace {
+
+class FileTestSuite : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = TempPath("itmoscript_file_test").string();
+    std::filesystem::remove(path_);
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  std::string Run(const std::string &code) {
+    std::istringstream input("path = \"" + path_ + "\"\n" + code);
+    std::ostringstream output;
+    EXPECT_TRUE(interpret(input, output));
+    return output.str();
+  }
+
+  std::string path_;
+};
+
+} // namespace
+
+TEST_F(FileTestSuite, WriteAndMap) {
+  ASSERT_EQ(Run("write_file(path, \"hello\n\")\n"
+                "append_file(path, 239)\n"
+                "text = open_mmap(path)\n"
+                "print(len(text), \" \", text)\n"),
+            "9 hello\n239");
+}
+
+TEST_F(FileTestSuite, WriteList) {
+  ASSERT_EQ(Run(R"(
+      l = [1, "a"]
+      write_file(path, l)
+      text = open_mmap(path)
+      print(text)
+  )"),
+            "[1, a]");
+}
+
+TEST_F(FileTestSuite, LinesAreStrings) {
+  std::string code = "write_file(path, \"a,b\nskip\nc,d,e\")" R"(
+      for line in lines(path) then
+          if line == "skip" then
+              continue
+          end if
+          parts = split(line, ",")
+          print(len(parts), upper(line), line[0], " ")
+      end for
+  )";
+
+  ASSERT_EQ(Run(code), "2A,Ba 3C,D,Ec ");
+}
+
+TEST_F(FileTestSuite, SlicesCombineWithStrings) {
+  std::string code = "write_file(path, \"abc\nabd\")" R"(
+      l = []
+      for line in lines(path) then
+          l = push(l, line)
+      end for
+      l = push(l, "abb")
+      s = sort(l)
+      x = l[0] + "!"
+      y = l[0] != l[1]
+      print(s, x, y)
+  )";
+
+  ASSERT_EQ(Run(code), "[abb, abc, abd]abc!true");
+}
+
+TEST_F(FileTestSuite, MissingFile) {
+  std::istringstream input("x = open_mmap(\"/nonexistent/itmoscript\")");
+  std::ostringstream output;
+
+  ASSERT_FALSE(interpret(input, output));
+}
+
+TEST_F(FileTestSuite, LinesFromSeveralThreads) {
+  constexpr int kLines = 20000;
+  {
+    std::ofstream fout(path_);
+    for (int i = 0; i < kLines; ++i) {
+      fout << i << "\n";
+    }
+  }
+  StringSink sink;
+  Isolate isolate(sink);
+  ASSERT_TRUE(isolate.Run("it = lines(\"" + path_ + "\")"));
+  auto it = std::get<std::shared_ptr<Iterator>>(isolate.Get("it"));
+
+  std::vector<std::vector<int>> read(8);
+  {
+    std::vector<std::jthread> readers;
+    for (auto &numbers : read) {
+      readers.emplace_back([&it, &numbers] {
+        Value line;
+        while (it->Next(line)) {
+          numbers.push_back(std::stoi(std::string(line.GetStringView())));
+        }
+      });
+    }
+  }
+
+  std::vector<int> all;
+  for (const auto &numbers : read) {
+    all.insert(all.end(), numbers.begin(), numbers.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), kLines);
+  for (int i = 0; i < kLines; ++i) {
+    ASSERT_EQ(all[i], i);
+  }
+}
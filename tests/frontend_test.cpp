@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <lib/memory_stats.h>
+#include <lib/parser.h>
+
+#include <script_generator.h>
+
+namespace {
+
+std::unique_ptr<AST::BlockNode> Parse(const std::string &source) {
+  std::istringstream input(source);
+  return Parser(Lexer(input).GetTokens()).ParseCode();
+}
+
+size_t Depth(const AST::BaseNode *node) {
+  size_t depth = 0;
+  const AST::BlockNode *block = nullptr;
+  if (auto if_node = dynamic_cast<const AST::IfNode *>(node)) {
+    block = if_node->then.get();
+  } else if (auto while_node = dynamic_cast<const AST::WhileNode *>(node)) {
+    block = while_node->then.get();
+  }
+  if (block != nullptr) {
+    for (const auto &stmt : block->nodes) {
+      depth = std::max(depth, Depth(stmt.get()));
+    }
+    ++depth;
+  }
+  return depth;
+}
+
+} // namespace
+
+class FrontendShapeTest : public ::testing::TestWithParam<ScriptShape> {};
+
+TEST_P(FrontendShapeTest, GeneratedScriptParses) {
+  GeneratedScript script = GenerateScript(GetParam());
+  ASSERT_GE(script.source.size(), GetParam().target_bytes);
+
+  std::unique_ptr<AST::BlockNode> root = Parse(script.source);
+  ASSERT_EQ(root->nodes.size(), script.top_level_statements);
+  // Every statement on its own line, so the last one ends on the last line.
+  ASSERT_EQ(root->nodes.back()->span.end.line, script.lines);
+}
+
+INSTANTIATE_TEST_SUITE_P(FrontendSuite, FrontendShapeTest,
+                         ::testing::ValuesIn(StandardShapes(256 << 10)),
+                         [](const auto &info) { return info.param.name; });
+
+TEST(FrontendSuite, DeepNesting) {
+  ScriptShape shape;
+  shape.nesting_depth = 200;
+  shape.function_percent = 0;
+  shape.target_bytes = 64 << 10;
+  std::unique_ptr<AST::BlockNode> root = Parse(GenerateScript(shape).source);
+
+  size_t depth = 0;
+  for (const auto &stmt : root->nodes) {
+    depth = std::max(depth, Depth(stmt.get()));
+  }
+  ASSERT_EQ(depth, 200);
+}
+
+TEST(FrontendSuite, GeneratorIsDeterministic) {
+  ScriptShape shape;
+  shape.target_bytes = 16 << 10;
+  ASSERT_EQ(GenerateScript(shape).source, GenerateScript(shape).source);
+  shape.seed = 1;
+  ASSERT_NE(GenerateScript(shape).source,
+            GenerateScript(ScriptShape{.target_bytes = 16 << 10}).source);
+}
+
+// Tokens and the tree should take a bounded multiple of the source size, so
+// large generated scripts do not run out of memory.
+TEST(FrontendSuite, MemoryGrowsLinearly) {
+  std::vector<uint64_t> peaks;
+  std::vector<size_t> sizes;
+  for (size_t size : {128 << 10, 512 << 10}) {
+    ScriptShape shape;
+    shape.target_bytes = size;
+    std::string source = GenerateScript(shape).source;
+    sizes.push_back(source.size());
+
+    MemoryStats::Reset();
+    MemoryStats::Enable();
+    Parse(source);
+    MemoryStats::Disable();
+    peaks.push_back(MemoryStats::Total().peak_bytes);
+    MemoryStats::Reset();
+  }
+  double small = static_cast<double>(peaks[0]) / sizes[0];
+  double large = static_cast<double>(peaks[1]) / sizes[1];
+  ASSERT_LT(large, small * 1.5);
+}
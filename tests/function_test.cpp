@@ -32,6 +32,28 @@ TEST(FunctionTestSuite, Fibonacci) {
   ASSERT_EQ(output.str(), expected);
 }
 
+TEST(FunctionTestSuite, RecursionKeepsArgumentsLocal) {
+  std::string code = R"(
+          fib = function(n)
+              if n < 2 then
+                  return n
+              end if
+              a = n - 1
+              b = n - 2
+              return fib(a) + fib(b)
+          end function
+
+          n = 239
+          print(fib(15), " ", n)
+      )";
+
+  std::istringstream input(code);
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "610 239");
+}
+
 TEST(FunctionTestSuite, FizzBuzz) {
   std::string code = R"(
       fizzBuzz = function(n)
@@ -216,7 +238,7 @@ TEST(FunctionTestSuite, Sqrt) {
   std::ostringstream output;
 
   ASSERT_TRUE(interpret(input, output));
-  ASSERT_EQ(output.str(), "15.4674");
+  ASSERT_EQ(output.str(), "15.467352714669696");
 }
 
 TEST(FunctionTestSuite, ParseNum) {
@@ -337,3 +359,29 @@ TEST(FunctionTestSuite, Sort) {
   ASSERT_TRUE(interpret(input, output));
   ASSERT_EQ(output.str(), "[2, 23, 239]");
 }
+
+TEST(FunctionTestSuite, ParseNumInvalid) {
+  std::istringstream input("a = \"12abc\" \n d = parse_num(a) print(d)");
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "nil");
+}
+
+TEST(FunctionTestSuite, ParseNumExponent) {
+  std::istringstream input("a = \" 1.5e3 \" \n d = parse_num(a) print(d)");
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "1500");
+}
+
+TEST(FunctionTestSuite, ToString) {
+  std::istringstream input(
+      "a = to_string(0.1) \n b = to_string(1e6) \n c = to_string(1.5e-7) \n "
+      "print(a, \" \", b, \" \", c)");
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "0.1 1000000 1.5e-07");
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+TEST(GeneratorSuite, YieldInLoops) {
+  ASSERT_EQ(RunScript(R"(
+        evens = function(n)
+            i = 0
+            while i < n then
+                if i % 2 == 0 then
+                    yield i
+                end if
+                i += 1
+            end while
+        end function
+        for x in evens(7) then
+            print(x)
+        end for
+    )"),
+            "0246");
+}
+
+TEST(GeneratorSuite, BodyRunsLazily) {
+  ASSERT_EQ(RunScript(R"(
+        gen = function()
+            print("a")
+            yield 1
+            print("b")
+            yield 2
+            print("c")
+        end function
+        g = gen()
+        print("start ")
+        for x in g then
+            print(x)
+        end for
+    )"),
+            "start a1b2c");
+}
+
+TEST(GeneratorSuite, UnboundedPipeline) {
+  ASSERT_EQ(RunScript(R"(
+        naturals = function()
+            n = 0
+            while true then
+                yield n
+                n += 1
+            end while
+        end function
+        squares = function(source)
+            for x in source then
+                yield x * x
+            end for
+        end function
+        print(take(squares(naturals()), 5))
+    )"),
+            "[0, 1, 4, 9, 16]");
+}
+
+TEST(GeneratorSuite, BreakContinueAndReturn) {
+  ASSERT_EQ(RunScript(R"(
+        gen = function(items)
+            for x in items then
+                if x == 2 then
+                    continue
+                end if
+                if x == 5 then
+                    break
+                end if
+                yield x
+            end for
+            yield 10
+            return nil
+            yield 11
+        end function
+        print(collect(gen([1, 2, 3, 4, 5, 6])))
+    )"),
+            "[1, 3, 4, 10]");
+}
+
+TEST(GeneratorSuite, ArgumentsAndStateArePerCall) {
+  ASSERT_EQ(RunScript(R"(
+        count = function(from)
+            while true then
+                yield from
+                from += 1
+            end while
+        end function
+        a = count(10)
+        b = count(20)
+        print(take(a, 2), take(b, 1), take(a, 2))
+    )"),
+            "[10, 11][20][12, 13]");
+}
+
+TEST(GeneratorSuite, ConsumedByJoin) {
+  ASSERT_EQ(RunScript(R"(
+        words = function(s)
+            for w in split(s, " ") then
+                yield upper(w)
+            end for
+        end function
+        print(join(words("a lazy pipeline"), "-"))
+    )"),
+            "A-LAZY-PIPELINE");
+}
+
+TEST(GeneratorSuite, YieldOutsideFunction) {
+  std::istringstream input("yield 1");
+  std::ostringstream output;
+  ASSERT_FALSE(interpret(input, output));
+}
+
+TEST(GeneratorSuite, SharedByParallelWorkers) {
+  ASSERT_EQ(RunScript(R"(
+        numbers = function(n)
+            for i in range(0, n, 1) then
+                yield i
+            end for
+        end function
+        g = numbers(2000)
+        drain = function(x)
+            total = 0
+            for v in g then
+                total += v
+            end for
+            return total
+        end function
+        print(sum(pmap(range(0, 8, 1), drain)))
+    )"),
+            "1999000");
+}
+
+TEST(GeneratorSuite, CallFromOwnBodyFails) {
+  std::istringstream input(R"(
+        again = function()
+            yield next_of_g()
+        end function
+        g = again()
+        next_of_g = function()
+            for v in g then
+                return v
+            end for
+        end function
+        for v in g then
+        end for
+    )");
+  std::ostringstream output;
+  ASSERT_FALSE(interpret(input, output));
+  ASSERT_EQ(output.str(), "Generator is already running\n");
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+namespace {
+
+std::string RunWithInput(const std::string &code, const std::string &data,
+                         size_t buffer_size = 4) {
+  std::istringstream stdin_data(data);
+  InputSource source(stdin_data, buffer_size);
+  InterpretOptions options;
+  options.input = &source;
+
+  std::istringstream input(code);
+  std::ostringstream output;
+  EXPECT_TRUE(interpret(input, output, options));
+  return output.str();
+}
+
+} // namespace
+
+TEST(InputTestSuite, Read) {
+  ASSERT_EQ(RunWithInput("a = read() \n b = read() \n c = read() \n "
+                         "print(a, \"|\", b, \"|\", c)",
+                         "first line\nsecond"),
+            "first line|second|nil");
+}
+
+TEST(InputTestSuite, ReadEmptyLine) {
+  ASSERT_EQ(RunWithInput("a = read() \n b = read() \n print(len(a), b)",
+                         "\nx\n"),
+            "0x");
+}
+
+TEST(InputTestSuite, ReadAll) {
+  ASSERT_EQ(RunWithInput("a = read() \n b = read_all() \n print(a, \"|\", b)",
+                         "head\nline one\nline two\n"),
+            "head|line one\nline two\n");
+}
+
+TEST(InputTestSuite, ReadLinesInFor) {
+  std::string code = R"(
+      n = 0
+      for line in read_lines() then
+          if line == "skip" then
+              continue
+          end if
+          n += 1
+          println(upper(line))
+      end for
+      print(n)
+  )";
+
+  ASSERT_EQ(RunWithInput(code, "abc\nskip\nlonger line\nx"),
+            "ABC\nLONGER LINE\nX\n3");
+}
+
+TEST(InputTestSuite, SourceLinesAcrossBuffers) {
+  std::istringstream data("0123456789\n\nab");
+  InputSource source(data, 3);
+  std::string line;
+
+  ASSERT_TRUE(source.ReadLine(line));
+  ASSERT_EQ(line, "0123456789");
+  ASSERT_TRUE(source.ReadLine(line));
+  ASSERT_EQ(line, "");
+  ASSERT_TRUE(source.ReadLine(line));
+  ASSERT_EQ(line, "ab");
+  ASSERT_FALSE(source.ReadLine(line));
+}
+
+TEST(InputTestSuite, ConcurrentReadersSplitLines) {
+  constexpr int kLines = 2000;
+  std::string data;
+  for (int i = 0; i < kLines; ++i) {
+    data += std::to_string(i) + "\n";
+  }
+  std::istringstream stream(data);
+  InputSource source(stream, 7);
+
+  std::vector<std::vector<int>> read(4);
+  {
+    std::vector<std::jthread> readers;
+    for (auto &lines : read) {
+      readers.emplace_back([&source, &lines] {
+        std::string line;
+        while (source.ReadLine(line)) {
+          lines.push_back(std::stoi(line));
+        }
+      });
+    }
+  }
+
+  std::vector<int> all;
+  for (const auto &lines : read) {
+    ASSERT_TRUE(std::is_sorted(lines.begin(), lines.end()));
+    all.insert(all.end(), lines.begin(), lines.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), kLines);
+  for (int i = 0; i < kLines; ++i) {
+    ASSERT_EQ(all[i], i);
+  }
+}
+
+TEST(InputTestSuite, ReadBuiltinsTakeNoArguments) {
+  for (const char *code : {"read(1)", "read_all(\"x\")", "read_lines(nil)"}) {
+    std::istringstream data("line\n");
+    InputSource source(data);
+    InterpretOptions options;
+    options.input = &source;
+    std::istringstream input(code);
+    std::ostringstream output;
+    ASSERT_FALSE(interpret(input, output, options));
+    ASSERT_NE(output.str().find("takes no arguments"), std::string::npos);
+  }
+}
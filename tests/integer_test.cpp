@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/number_ops.h>
+
+#include "test_helpers.h"
+
+TEST(NumberOpsSuite, IntegersStayExact) {
+  Value big = NumberArithmetic(TokenType::PLUS, Value(int64_t(1) << 53),
+                               Value(int64_t(1)));
+  ASSERT_EQ(std::get<int64_t>(big), (int64_t(1) << 53) + 1);
+  ASSERT_EQ(std::get<int64_t>(NumberArithmetic(
+                TokenType::DIVIDE, Value(int64_t(12)), Value(int64_t(4)))),
+            3);
+  ASSERT_EQ(std::get<double>(NumberArithmetic(
+                TokenType::DIVIDE, Value(int64_t(7)), Value(int64_t(2)))),
+            3.5);
+  ASSERT_EQ(std::get<int64_t>(NumberArithmetic(
+                TokenType::MOD, Value(int64_t(-7)), Value(int64_t(3)))),
+            -1);
+  ASSERT_EQ(std::get<int64_t>(NumberArithmetic(
+                TokenType::POW, Value(int64_t(3)), Value(int64_t(39)))),
+            4052555153018976267);
+}
+
+TEST(NumberOpsSuite, OverflowBecomesDouble) {
+  Value max(INT64_MAX);
+  Value sum = NumberArithmetic(TokenType::PLUS, max, Value(int64_t(1)));
+  ASSERT_EQ(std::get<double>(sum), 9223372036854775808.0);
+  Value product = NumberArithmetic(TokenType::MULTIPLY, max, Value(int64_t(2)));
+  ASSERT_TRUE(std::holds_alternative<double>(product));
+  Value power =
+      NumberArithmetic(TokenType::POW, Value(int64_t(2)), Value(int64_t(64)));
+  ASSERT_EQ(std::get<double>(power), 18446744073709551616.0);
+  ASSERT_EQ(std::get<double>(NegateNumber(Value(INT64_MIN))),
+            9223372036854775808.0);
+  ASSERT_THROW(NumberArithmetic(TokenType::DIVIDE, Value(int64_t(1)),
+                                Value(int64_t(0))),
+               std::runtime_error);
+}
+
+TEST(NumberOpsSuite, MixedComparisons) {
+  Value exact((int64_t(1) << 53) + 1);
+  Value rounded(9007199254740992.0);
+  ASSERT_TRUE(CompareNumbers(exact, rounded) > 0);
+  ASSERT_TRUE(CompareNumbers(rounded, exact) < 0);
+  ASSERT_TRUE(CompareNumbers(Value(int64_t(2)), Value(2.0)) == 0);
+  ASSERT_TRUE(CompareNumbers(Value(int64_t(2)), Value(2.5)) < 0);
+  ASSERT_TRUE(CompareNumbers(Value(int64_t(-2)), Value(-2.5)) > 0);
+  ASSERT_TRUE(CompareNumbers(Value(INT64_MAX), Value(9223372036854775808.0)) <
+              0);
+  ASSERT_TRUE(CompareNumbers(Value(int64_t(0)), Value(std::nan(""))) ==
+              std::partial_ordering::unordered);
+
+  int64_t i;
+  ASSERT_TRUE(GetInteger(Value(-0.0), i));
+  ASSERT_EQ(i, 0);
+  ASSERT_FALSE(GetInteger(Value(0.5), i));
+  ASSERT_FALSE(GetInteger(Value(1e19), i));
+}
+
+TEST(IntegerSuite, InvisibleToScripts) {
+  ASSERT_EQ(RunScript(R"(
+        println([2 == 2.0, 7 / 2, 6 / 2, -7 % 3, 2 ^ 10, 1.5 * 2, -0])
+        l = [10, 20, 30]
+        println([l[2.0], l[0:2.0], insert(l, 3, 40), remove(l, 1.0)])
+        d = {2: "two"}
+        d[2.0] = "still two"
+        println(d)
+    )"),
+            "[true, 3.5, 3, -1, 1024, 3, -0]\n"
+            "[30, [10, 20], [10, 20, 30, 40], [10, 30]]\n"
+            "{2: still two}\n");
+}
+
+TEST(IntegerSuite, LargeIdsAreExact) {
+  ASSERT_EQ(RunScript(R"(
+        id = 9007199254740993
+        ids = [id + 2, id, id + 1, 9007199254740992]
+        println([id + 1, id * 1, sort(ids)])
+        next = parse_num("1700000000123456789") + 1
+        println([next, 9223372036854775807 + 1 > 9223372036854775807])
+    )"),
+            "[9007199254740994, 9007199254740993, [9007199254740992, "
+            "9007199254740993, 9007199254740994, 9007199254740995]]\n"
+            "[1700000000123456790, true]\n");
+}
+
+TEST(IntegerSuite, IndexLoops) {
+  ASSERT_EQ(RunScript(R"(
+        l = range(0, 1000, 1)
+        i = 0
+        total = 0
+        while i < len(l) then
+            total += l[i]
+            i += 1
+        end while
+        println([total, i, range(0, 1, 0.25)])
+    )"),
+            "[499500, 1000, [0, 0.25, 0.5, 0.75]]\n");
+}
+
+TEST(IntegerSuite, Errors) {
+  for (std::string code : {"l = [1, 2]\nx = l[0.5]", "l = [1, 2]\nx = l[2]",
+                           "l = insert([1], 3, 0)", "l = remove([1], -1)",
+                           "x = 1 / 0", "x = \"ab\"[1:0]"}) {
+    std::istringstream input(code);
+    std::ostringstream output;
+    ASSERT_FALSE(interpret(input, output)) << code;
+  }
+}
@@ -0,0 +1,146 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <lib/isolate.h>
+
+TEST(IsolateSuite, GlobalsPersistBetweenRuns) {
+  StringSink sink;
+  Isolate isolate(sink);
+  isolate.Set("x", 21.0);
+
+  ASSERT_TRUE(isolate.Run("y = x * 2"));
+  ASSERT_TRUE(isolate.Run("println(y)"));
+  ASSERT_EQ(sink.Str(), "42\n");
+  ASSERT_EQ(std::get<double>(isolate.Get("y")), 42);
+}
+
+TEST(IsolateSuite, ErrorKeepsStackTrace) {
+  StringSink sink;
+  Isolate isolate(sink);
+  ASSERT_FALSE(isolate.Run(R"(
+        f = function(x)
+            return g(x)
+        end function
+        f(1)
+    )"));
+  ASSERT_EQ(isolate.Error(), "No variable g");
+  ASSERT_EQ(isolate.StackTrace(), std::vector<std::string>({"f", "g"}));
+  ASSERT_EQ(sink.Str(), "No variable g\n");
+  ASSERT_EQ(isolate.StackTraceLines(), std::vector<uint32_t>({5, 3}));
+}
+
+TEST(IsolateSuite, StackTraceOfFailingBuiltin) {
+  StringSink sink;
+  Isolate isolate(sink);
+  ASSERT_FALSE(isolate.Run(R"(
+        inner = function(x)
+            return sqrt(x)
+        end function
+        outer = function(x)
+            t = stacktrace()
+            println(t)
+            return inner(x)
+        end function
+        outer("text")
+    )"));
+  ASSERT_EQ(isolate.StackTrace(),
+            std::vector<std::string>({"outer", "inner", "sqrt"}));
+  ASSERT_EQ(sink.Str(), "[outer]\nArgument must be a number\n");
+
+  // Frames of the failed run are gone.
+  ASSERT_TRUE(isolate.Run("println(stacktrace())"));
+  ASSERT_EQ(sink.Str(), "[outer]\nArgument must be a number\n[println]\n");
+}
+
+TEST(IsolateSuite, DeepStackTraceIsTruncated) {
+  StringSink sink;
+  Isolate isolate(sink);
+  ASSERT_FALSE(isolate.Run(R"(
+        down = function(n)
+            if n == 0 then
+                return missing
+            end if
+            return down((n - 1))
+        end function
+        down(1100)
+    )"));
+  const std::vector<std::string> &trace = isolate.StackTrace();
+  ASSERT_EQ(trace.size(), 1025);
+  ASSERT_EQ(trace[0], "down");
+  ASSERT_EQ(trace.back(), "... 77 more frames");
+}
+
+TEST(IsolateSuite, StackTraceWithFullNameTable) {
+  // Fill whatever earlier tests of this process left free.
+  for (uint32_t i = 0; i < NameTable::kMaxNames; ++i) {
+    NameTable::Intern("filler_" + std::to_string(i));
+  }
+  ASSERT_EQ(NameTable::Intern("never_interned_before"), NameTable::kUnnamed);
+
+  StringSink sink;
+  Isolate isolate(sink);
+  ASSERT_FALSE(isolate.Run(R"(
+        late_outer = function(x)
+            return late_inner(x)
+        end function
+        late_inner = function(x)
+            t = stacktrace()
+            println(t)
+            return missing
+        end function
+        late_outer(1)
+    )"));
+  ASSERT_EQ(isolate.StackTrace(),
+            std::vector<std::string>({"late_outer", "late_inner"}));
+  ASSERT_EQ(sink.Str(), "[late_outer, late_inner]\nNo variable missing\n");
+}
+
+TEST(IsolateSuite, ManyIsolatesInParallel) {
+  auto program = Program::Compile(R"(
+        total = 0
+        for i in range(0, 1000, 1) then
+            total = total + i * seed
+        end for
+        s = ""
+        for w in split("a b c", " ") then
+            s = s + upper(w)
+        end for
+        add_seed = function(x)
+            return x + seed
+        end function
+        r = pmap(range(0, 10, 1), add_seed)
+        println(total, " ", s, " ", r[9], " ", len(stacktrace()))
+    )");
+
+  constexpr int kIsolates = 16;
+  constexpr int kRuns = 20;
+  std::vector<std::string> outputs(kIsolates);
+  std::vector<bool> ok(kIsolates, true);
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < kIsolates; ++i) {
+      threads.emplace_back([&, i] {
+        StringSink sink;
+        Isolate isolate(sink);
+        isolate.Set("seed", static_cast<double>(i));
+        for (int run = 0; run < kRuns; ++run) {
+          if (!isolate.Run(*program)) {
+            ok[i] = false;
+          }
+        }
+        outputs[i] = sink.Take();
+      });
+    }
+  }
+
+  for (int i = 0; i < kIsolates; ++i) {
+    ASSERT_TRUE(ok[i]) << outputs[i];
+    std::string line = std::to_string(499500 * i) + " ABC " +
+                       std::to_string(9 + i) + " 2\n";
+    std::string expected;
+    for (int run = 0; run < kRuns; ++run) {
+      expected += line;
+    }
+    ASSERT_EQ(outputs[i], expected);
+  }
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <lib/ast_serializer.h>
+#include <lib/interpreter.h>
+#include <lib/line_profiler.h>
+
+namespace {
+
+const LineProfiler::LineStats *FindLine(
+    const std::vector<LineProfiler::LineStats> &lines, uint32_t line) {
+  for (const LineProfiler::LineStats &stats : lines) {
+    if (stats.line == line) {
+      return &stats;
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<AST::BlockNode> Parse(const std::string &code) {
+  std::istringstream input(code);
+  return Parser(Lexer(input).GetTokens()).ParseCode();
+}
+
+} // namespace
+
+TEST(LineProfilerSuite, TokensHaveSpans) {
+  std::istringstream input("x = 12\n  print(\"ab\")");
+  std::vector<Token> tokens = Lexer(input).GetTokens();
+  ASSERT_EQ(tokens[1].GetValue(), "=");
+  ASSERT_EQ(tokens[1].GetSpan().begin.line, 1);
+  ASSERT_EQ(tokens[1].GetSpan().begin.column, 3);
+  ASSERT_EQ(tokens[2].GetSpan().begin.column, 5);
+  ASSERT_EQ(tokens[2].GetSpan().end.column, 7);
+
+  ASSERT_EQ(tokens[3].GetValue(), "print");
+  ASSERT_EQ(tokens[3].GetSpan().begin.line, 2);
+  ASSERT_EQ(tokens[3].GetSpan().begin.column, 3);
+  ASSERT_EQ(tokens[5].GetValue(), "ab");
+  ASSERT_EQ(tokens[5].GetSpan().begin.column, 9);
+  ASSERT_EQ(tokens[5].GetSpan().end.column, 13);
+}
+
+TEST(LineProfilerSuite, StatementsHaveSpans) {
+  auto root = Parse("x = 1\nwhile x < 3 then\n  x += 1\nend while\n");
+  ASSERT_EQ(root->nodes.size(), 2);
+  ASSERT_EQ(root->nodes[0]->span.begin.line, 1);
+
+  auto while_node = dynamic_cast<AST::WhileNode *>(root->nodes[1].get());
+  ASSERT_NE(while_node, nullptr);
+  ASSERT_EQ(while_node->span.begin.line, 2);
+  ASSERT_EQ(while_node->span.end.line, 4);
+  ASSERT_EQ(while_node->span.end.column, 10);
+
+  const auto &body = while_node->then->nodes;
+  ASSERT_EQ(body[0]->span.begin.line, 3);
+  ASSERT_EQ(body[0]->span.begin.column, 3);
+  auto assignment = dynamic_cast<AST::AssignmentNode *>(body[0].get());
+  ASSERT_EQ(assignment->value->span.begin.column, 8);
+}
+
+TEST(LineProfilerSuite, SpansSurviveTheCache) {
+  auto root = Parse("a = 1\nb = a + 2\n");
+  auto restored = DeserializeProgram(SerializeProgram(*root));
+  ASSERT_EQ(restored->nodes[1]->span.begin.line, 2);
+  auto assignment = dynamic_cast<AST::AssignmentNode *>(
+      restored->nodes[1].get());
+  ASSERT_EQ(assignment->variable.GetSpan().begin.line, 2);
+  ASSERT_EQ(assignment->value->span.begin.column, 5);
+}
+
+TEST(LineProfilerSuite, SelfExcludesNestedLines) {
+  LineProfiler profiler;
+  profiler.Enter(1);
+  profiler.Enter(2);
+  profiler.Leave();
+  profiler.Enter(1);
+  profiler.Leave();
+  profiler.Leave();
+
+  std::vector<LineProfiler::LineStats> lines = profiler.Lines();
+  ASSERT_EQ(lines.size(), 2);
+  ASSERT_EQ(lines[0].line, 1);
+  ASSERT_EQ(lines[0].hits, 2);
+  ASSERT_EQ(lines[1].hits, 1);
+  // Line 1 is counted once towards its total although it ran nested.
+  ASSERT_EQ(lines[0].total_cycles,
+            lines[0].self_cycles + lines[1].self_cycles);
+}
+
+TEST(LineProfilerSuite, CountsLinesOfScript) {
+  std::string code = "s = 0\n"
+                     "i = 0\n"
+                     "while i < 100 then\n"
+                     "  s += i\n"
+                     "  i += 1\n"
+                     "end while\n"
+                     "f = function(x)\n"
+                     "  return x * 2\n"
+                     "end function\n"
+                     "for k in range(0, 5, 1) then\n"
+                     "  s += f(k)\n"
+                     "end for\n"
+                     "print(s)\n";
+  LineProfiler profiler;
+  InterpretOptions options;
+  options.line_profiler = &profiler;
+  std::istringstream input(code);
+  std::ostringstream output;
+  ASSERT_TRUE(interpret(input, output, options));
+  ASSERT_EQ(output.str(), "4970");
+
+  std::vector<LineProfiler::LineStats> lines = profiler.Lines();
+  ASSERT_EQ(FindLine(lines, 1)->hits, 1);
+  // The loop statement itself and its condition, once per check.
+  ASSERT_EQ(FindLine(lines, 3)->hits, 102);
+  ASSERT_EQ(FindLine(lines, 4)->hits, 100);
+  ASSERT_EQ(FindLine(lines, 5)->hits, 100);
+  ASSERT_EQ(FindLine(lines, 8)->hits, 5);
+  ASSERT_EQ(FindLine(lines, 11)->hits, 5);
+  ASSERT_EQ(FindLine(lines, 6), nullptr);
+  ASSERT_GE(FindLine(lines, 3)->total_cycles,
+            FindLine(lines, 4)->total_cycles);
+
+  std::ostringstream listing;
+  profiler.WriteListing(listing, code, 1);
+  std::string text = listing.str();
+  ASSERT_NE(text.find("|   s += i\n"), std::string::npos);
+  ASSERT_NE(text.find("|   return x * 2\n"), std::string::npos);
+  ASSERT_EQ(std::count(text.begin(), text.end(), '>'), 1);
+  ASSERT_EQ(std::count(text.begin(), text.end(), '\n'), 14);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+namespace {
+
+std::vector<Value> Numbers(size_t n) {
+  std::vector<Value> elems;
+  for (size_t i = 0; i < n; ++i) {
+    elems.push_back(double(i));
+  }
+  return elems;
+}
+
+} // namespace
+
+TEST(ListKindSuite, SharedListsRecordTheirKind) {
+  Value numbers(Numbers(100));
+  ASSERT_EQ(numbers.ListKind(), ElementKind::NUMBER);
+  numbers.Share();
+  ASSERT_EQ(std::get<ListSlice>(numbers).kind, ElementKind::NUMBER);
+  ASSERT_EQ(numbers.Slice(10, 50).ListKind(), ElementKind::NUMBER);
+
+  std::vector<Value> elems = Numbers(100);
+  elems[50] = std::string("x");
+  Value mixed(std::move(elems));
+  mixed.Share();
+  ASSERT_EQ(mixed.ListKind(), ElementKind::MIXED);
+
+  Value strings = Value::MakeList(
+      std::vector<Value>(20, Value(std::string("s"))), ElementKind::STRING);
+  ASSERT_TRUE(std::holds_alternative<ListSlice>(strings));
+  ASSERT_EQ(strings.ListKind(), ElementKind::STRING);
+  ASSERT_EQ(Value(std::vector<Value>()).ListKind(), ElementKind::MIXED);
+}
+
+TEST(ListKindSuite, WritesOfAnotherKindMakeListsMixed) {
+  ASSERT_EQ(RunScript(R"(
+        l = range(0, 10, 1)
+        l[3] = "x"
+        m = push(range(0, 10, 1), "y")
+        n = range(0, 10, 1) + split("a b", " ")
+        println(sort(l))
+        println(sort(m))
+        println(sort(n))
+    )"),
+            "[0, 1, 2, 4, 5, 6, 7, 8, 9, x]\n"
+            "[0, 1, 2, 3, 4, 5, 6, 7, 8, 9, y]\n"
+            "[0, 1, 2, 3, 4, 5, 6, 7, 8, 9, a, b]\n");
+}
+
+TEST(ListKindSuite, SpecializedBuiltins) {
+  ASSERT_EQ(RunScript(R"(
+        words = split("d,c,b,a,e,f,g,h,i", ",")
+        println(join(sort(words), ""))
+        twice = words * 2
+        println(join(twice, "-"))
+        n = range(0, 1000, 1)
+        println(sum(n), " ", max(n))
+        total = 0
+        for x in n then
+            if x % 2 == 0 then
+                continue
+            end if
+            total += x
+            x = "changed"
+        end for
+        println(total)
+    )"),
+            "abcdefghi\nd-c-b-a-e-f-g-h-i-d-c-b-a-e-f-g-h-i\n499500 999\n250000\n");
+}
@@ -140,4 +140,21 @@ TEST(LoopTestSuit, Continue) {
 
   ASSERT_TRUE(interpret(in, out));
   ASSERT_EQ(out.str(), "5\n7\n9\n11\n");
-}
\ No newline at end of file
+}
+TEST(LoopTestSuit, ForBreakContinue) {
+  std::istringstream in(R"(
+    for i in range(0, 10, 1) then
+      if i == 1 then
+        continue
+      end if
+      if i == 4 then
+        break
+      end if
+      print(i)
+    end for
+    )");
+  std::ostringstream out;
+
+  ASSERT_TRUE(interpret(in, out));
+  ASSERT_EQ(out.str(), "023");
+}
@@ -0,0 +1,156 @@
+#include <limits>
+#include <new>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/memory_stats.h>
+
+namespace {
+
+// Counts allocations for the lifetime of a test.
+class MemoryStatsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    MemoryStats::Reset();
+    MemoryStats::Enable();
+  }
+  void TearDown() override {
+    MemoryStats::Disable();
+    MemoryStats::Reset();
+  }
+};
+
+const MemoryStats::SiteStats *FindSite(
+    const std::vector<MemoryStats::SiteStats> &sites,
+    const std::string &name) {
+  for (const MemoryStats::SiteStats &site : sites) {
+    if (site.site == name) {
+      return &site;
+    }
+  }
+  return nullptr;
+}
+
+uint64_t KindAllocations(const MemoryStats::SiteStats &site, AllocKind kind) {
+  return site.kinds[static_cast<size_t>(kind)].allocations;
+}
+
+int new_handler_calls = 0;
+
+} // namespace
+
+TEST_F(MemoryStatsTest, CountsLiveAndCumulative) {
+  MemoryStats::Counters before = MemoryStats::Total();
+  {
+    AllocationScope scope(AllocKind::LIST, MemoryStats::NamedSite("test"));
+    std::vector<int> *v = new std::vector<int>(1000);
+    MemoryStats::Counters during = MemoryStats::OfKind(AllocKind::LIST);
+    ASSERT_EQ(during.live_allocations, 2);
+    ASSERT_EQ(during.live_bytes, sizeof(std::vector<int>) + 4000);
+    delete v;
+  }
+  MemoryStats::Counters list = MemoryStats::OfKind(AllocKind::LIST);
+  ASSERT_EQ(list.allocations, 2);
+  ASSERT_EQ(list.live_bytes, 0);
+  ASSERT_EQ(list.peak_bytes, sizeof(std::vector<int>) + 4000);
+  ASSERT_GE(MemoryStats::Total().bytes, before.bytes + 4000);
+
+  const MemoryStats::SiteStats *site = FindSite(MemoryStats::Sites(), "test");
+  ASSERT_NE(site, nullptr);
+  ASSERT_EQ(KindAllocations(*site, AllocKind::LIST), 2);
+}
+
+TEST_F(MemoryStatsTest, CountsArrayAndAlignedForms) {
+  struct alignas(64) Line {
+    char bytes[64];
+  };
+  {
+    AllocationScope scope(AllocKind::DICT);
+    Line *line = new Line;
+    Line *lines = new Line[4];
+    char *chars = new char[100];
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(line) % 64, 0);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(lines) % 64, 0);
+    ASSERT_EQ(MemoryStats::OfKind(AllocKind::DICT).live_allocations, 3);
+    delete line;
+    delete[] lines;
+    delete[] chars;
+  }
+  MemoryStats::Counters dict = MemoryStats::OfKind(AllocKind::DICT);
+  ASSERT_EQ(dict.allocations, 3);
+  ASSERT_EQ(dict.live_allocations, 0);
+  ASSERT_EQ(dict.live_bytes, 0);
+}
+
+TEST_F(MemoryStatsTest, DisabledCountsNothing) {
+  MemoryStats::Disable();
+  std::string *s = new std::string(100, 'a');
+  MemoryStats::Enable();
+  delete s;
+  ASSERT_EQ(MemoryStats::Total().allocations, 0);
+  ASSERT_EQ(MemoryStats::Total().live_bytes, 0);
+}
+
+TEST_F(MemoryStatsTest, AttributesScriptLines) {
+  std::istringstream input("a = []\n"
+                           "i = 0\n"
+                           "while i < 50 then\n"
+                           "  s = \"abcdefghij\" * 10\n"
+                           "  a = push(a, s)\n"
+                           "  i += 1\n"
+                           "end while\n"
+                           "f = function(x)\n"
+                           "  return x\n"
+                           "end function\n"
+                           "f(1)\n");
+  std::ostringstream output;
+  ASSERT_TRUE(interpret(input, output));
+
+  std::vector<MemoryStats::SiteStats> sites = MemoryStats::Sites();
+  const MemoryStats::SiteStats *line4 = FindSite(sites, "line 4");
+  ASSERT_NE(line4, nullptr);
+  ASSERT_GE(KindAllocations(*line4, AllocKind::STRING), 50);
+  ASSERT_NE(FindSite(sites, "push (line 5)"), nullptr);
+  const MemoryStats::SiteStats *line8 = FindSite(sites, "line 8");
+  ASSERT_NE(line8, nullptr);
+  ASSERT_GT(KindAllocations(*line8, AllocKind::FUNCTION), 0);
+  const MemoryStats::SiteStats *line11 = FindSite(sites, "line 11");
+  ASSERT_NE(line11, nullptr);
+  ASSERT_GT(KindAllocations(*line11, AllocKind::SCOPE), 0);
+
+  std::ostringstream report;
+  MemoryStats::WriteReport(report, 5);
+  ASSERT_NE(report.str().find("line 4 string"), std::string::npos);
+  ASSERT_NE(report.str().find("peak RSS"), std::string::npos);
+}
+
+TEST_F(MemoryStatsTest, MemStatsBuiltin) {
+  std::istringstream input("s = \"abcdefghij\" * 10\n"
+                           "m = mem_stats()\n"
+                           "k = m[\"string\"]\n"
+                           "strings = k[\"allocations\"] > 0\n"
+                           "live = m[\"live_bytes\"] > 0\n"
+                           "print(m[\"enabled\"], strings, live)\n");
+  std::ostringstream output;
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "truetruetrue");
+}
+
+TEST(MemoryStatsSuite, FailedAllocationCallsNewHandler) {
+  new_handler_calls = 0;
+  std::new_handler previous = std::set_new_handler([] {
+    // Nothing to free: give up on the next attempt.
+    ++new_handler_calls;
+    std::set_new_handler(nullptr);
+  });
+  volatile std::size_t huge = std::numeric_limits<std::size_t>::max() / 2;
+  bool threw = false;
+  try {
+    ::operator delete(::operator new(huge));
+  } catch (const std::bad_alloc &) {
+    threw = true;
+  }
+  std::set_new_handler(previous);
+  ASSERT_TRUE(threw);
+  ASSERT_EQ(new_handler_calls, 1);
+}
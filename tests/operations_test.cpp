@@ -17,3 +17,11 @@ TEST(TypesTestSuite, OrderTest2) {
     ASSERT_EQ(output.str(), "9");
 }
 
+
+TEST(TypesTestSuite, MinusWithoutSpaces) {
+    std::istringstream input("x = 5-3 \n y = 2e-1 \n print(x, \" \", y) \n");
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "2 0.2");
+}
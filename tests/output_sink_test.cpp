@@ -0,0 +1,78 @@
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+namespace {
+
+class FdSinkTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = TempPath("itmoscript_sink_test");
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd_, 0);
+  }
+
+  void TearDown() override {
+    ::close(fd_);
+    std::filesystem::remove(path_);
+  }
+
+  size_t Written() { return std::filesystem::file_size(path_); }
+
+  std::filesystem::path path_;
+  int fd_;
+};
+
+} // namespace
+
+TEST_F(FdSinkTest, NewlinePolicy) {
+  FdSink sink(fd_, FlushPolicy::NEWLINE, 64);
+  sink.Write("abc");
+  ASSERT_EQ(Written(), 0);
+  sink.Write("d\n");
+  ASSERT_EQ(Written(), 5);
+}
+
+TEST_F(FdSinkTest, SizePolicy) {
+  FdSink sink(fd_, FlushPolicy::SIZE, 64, 8);
+  sink.Write("abc\n");
+  ASSERT_EQ(Written(), 0);
+  sink.Write("defgh");
+  ASSERT_EQ(Written(), 9);
+}
+
+TEST_F(FdSinkTest, NonePolicyFlushesOnlyWhenFull) {
+  {
+    FdSink sink(fd_, FlushPolicy::NONE, 8);
+    sink.Write("abc\n");
+    ASSERT_EQ(Written(), 0);
+    sink.Write("defgh");
+    ASSERT_EQ(Written(), 4);
+    sink.Write(std::string(100, 'x'));
+    ASSERT_EQ(Written(), 109);
+    sink.Write("y");
+  }
+  ASSERT_EQ(Written(), 110);
+}
+
+TEST_F(FdSinkTest, InterpretWritesThroughSink) {
+  std::istringstream input("println(\"a\") \n print(239)");
+  {
+    FdSink sink(fd_, FlushPolicy::NONE);
+    ASSERT_TRUE(interpret(input, sink));
+  }
+  ASSERT_EQ(Written(), 5);
+}
+
+TEST(OutputSinkSuite, StringSinkCapture) {
+  std::istringstream input("println(\"a\") \n print(239)");
+  StringSink sink;
+
+  ASSERT_TRUE(interpret(input, sink));
+  ASSERT_EQ(sink.Str(), "a\n239");
+}
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/thread_pool.h>
+
+#include "test_helpers.h"
+
+TEST(ParallelSuite, ParallelForCoversEveryIndexOnce) {
+  ThreadPool pool(3);
+  std::vector<std::atomic<int>> hits(10007);
+  pool.ParallelFor(hits.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      ++hits[i];
+    }
+  });
+  for (auto &h : hits) {
+    ASSERT_EQ(h, 1);
+  }
+}
+
+TEST(ParallelSuite, ParallelForRethrows) {
+  ThreadPool pool(3);
+  ASSERT_THROW(pool.ParallelFor(1000,
+                                [](size_t begin, size_t end) {
+                                  if (begin <= 500 && 500 < end) {
+                                    throw std::runtime_error("boom");
+                                  }
+                                }),
+               std::runtime_error);
+}
+
+TEST(ParallelSuite, NestedParallelForRunsInline) {
+  ThreadPool pool(2);
+  std::atomic<int> total = 0;
+  pool.ParallelFor(8, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      pool.ParallelFor(10, [&](size_t b, size_t e) { total += e - b; });
+    }
+  });
+  ASSERT_EQ(total, 80);
+}
+
+TEST(ParallelSuite, MapFilterReduce) {
+  std::string code = R"(
+        offset = 1
+        inc = function(x)
+            if x % 250 == 0 then
+                println(x)
+            end if
+            return x + offset
+        end function
+        odd = function(x)
+            return x % 2 == 1
+        end function
+        add = function(a, b)
+            return a + b
+        end function
+        l = range(0, 1000, 1)
+        m = pmap(l, inc)
+        f = pfilter(m, odd)
+        println(m[0], " ", m[999], " ", len(f), " ", f[1])
+        println(preduce(l, add), " ", preduce([], add, 0))
+        println(preduce(["b", "c", "d"], add, "a"))
+    )";
+
+  std::istringstream input(code);
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(),
+            "0\n250\n500\n750\n1 1000 500 3\n499500 0\nabcd\n");
+}
+
+TEST(ParallelSuite, SharedVariablesAreReadOnly) {
+  std::string code = R"(
+        total = 0
+        count = function(x)
+            total = total + x
+            return x
+        end function
+        r = pmap([1, 2, 3], count)
+    )";
+
+  std::istringstream input(code);
+  std::ostringstream output;
+
+  ASSERT_FALSE(interpret(input, output));
+  ASSERT_EQ(output.str(),
+            "Can not assign to total while it is shared between threads\n");
+}
+
+TEST(ParallelSuite, SharedIteratorHandsOutEachElementOnce) {
+  std::filesystem::path path = TempPath("itmoscript_parallel_test");
+  {
+    std::ofstream file(path);
+    for (int i = 0; i < 20000; ++i) {
+      file << i << "\n";
+    }
+  }
+
+  std::string result = RunScript(R"(
+        it = lines(")" + path.string() + R"(")
+        drain = function(x)
+            total = 0
+            for line in it then
+                total += parse_num(line)
+            end for
+            return total
+        end function
+        print(sum(pmap(range(0, 8, 1), drain)))
+    )");
+  std::filesystem::remove(path);
+  ASSERT_EQ(result, "199990000");
+}
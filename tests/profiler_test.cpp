@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/isolate.h>
+#include <lib/profiler.h>
+
+namespace {
+
+using std::chrono::milliseconds;
+
+const Profiler::FunctionStats *FindFunction(
+    const std::vector<Profiler::FunctionStats> &stats,
+    const std::string &name) {
+  for (const Profiler::FunctionStats &s : stats) {
+    if (s.name == name) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(ProfilerSuite, CountsSelfAndTotal) {
+  Profiler profiler;
+  profiler.Sample(milliseconds(1));
+  profiler.Enter("outer");
+  profiler.Sample(milliseconds(2));
+  profiler.Enter("inner");
+  profiler.Sample(milliseconds(4));
+  profiler.Sample(milliseconds(4));
+  profiler.Leave();
+  profiler.Enter("outer");
+  profiler.Sample(milliseconds(4));
+  profiler.Leave();
+  profiler.Leave();
+
+  std::vector<Profiler::FunctionStats> stats = profiler.Functions();
+  ASSERT_EQ(profiler.Samples(), 5);
+  ASSERT_EQ(stats.size(), 3);
+  ASSERT_EQ(stats[0].name, "inner");
+  ASSERT_EQ(stats[0].self_time, milliseconds(8));
+
+  const Profiler::FunctionStats *outer = FindFunction(stats, "outer");
+  ASSERT_NE(outer, nullptr);
+  ASSERT_EQ(outer->self_samples, 2);
+  ASSERT_EQ(outer->self_time, milliseconds(6));
+  // The recursive sample counts once towards the total.
+  ASSERT_EQ(outer->total_samples, 4);
+  ASSERT_EQ(outer->total_time, milliseconds(14));
+
+  const Profiler::FunctionStats *script = FindFunction(stats, "<script>");
+  ASSERT_NE(script, nullptr);
+  ASSERT_EQ(script->self_samples, 1);
+  ASSERT_EQ(script->total_time, milliseconds(15));
+
+  std::ostringstream folded;
+  profiler.WriteFolded(folded);
+  ASSERT_EQ(folded.str(), "<script> 1\n"
+                          "<script>;outer 1\n"
+                          "<script>;outer;outer 1\n"
+                          "<script>;outer;inner 2\n");
+}
+
+TEST(ProfilerSuite, DeepStacksAreTruncated) {
+  Profiler profiler;
+  for (int i = 0; i < 1000; ++i) {
+    profiler.Enter("f");
+  }
+  profiler.Sample(milliseconds(1));
+  for (int i = 0; i < 1000; ++i) {
+    profiler.Leave();
+  }
+  profiler.Leave();
+  profiler.Sample(milliseconds(1));
+
+  std::vector<Profiler::FunctionStats> stats = profiler.Functions();
+  ASSERT_EQ(profiler.Samples(), 2);
+  ASSERT_EQ(FindFunction(stats, "f")->self_samples, 1);
+  ASSERT_EQ(FindFunction(stats, "<script>")->self_samples, 1);
+}
+
+TEST(ProfilerSuite, SamplesRunningScript) {
+  Profiler profiler(std::chrono::microseconds(100));
+  std::ostringstream output;
+  InterpretOptions options;
+  options.profiler = &profiler;
+
+  std::istringstream input(R"(
+        spin = function(n)
+            i = 0
+            while i < n then
+                i += 1
+            end while
+            return i
+        end function
+        x = 0
+        while x < 20 then
+            spin(2000)
+            x += 1
+        end while
+        f = function()
+            s = "a" * 3
+            return s[5]
+        end function
+        f()
+    )");
+  profiler.Start();
+  ASSERT_FALSE(interpret(input, output, options));
+  profiler.Stop();
+
+  uint64_t samples = profiler.Samples();
+  ASSERT_GT(samples, 0);
+  // The failed call to f is unwound, so this sample is the top level's.
+  std::vector<Profiler::FunctionStats> before = profiler.Functions();
+  uint64_t script_samples = FindFunction(before, "<script>")->self_samples;
+  profiler.Sample(milliseconds(1));
+  std::vector<Profiler::FunctionStats> stats = profiler.Functions();
+  ASSERT_EQ(FindFunction(stats, "<script>")->self_samples, script_samples + 1);
+  ASSERT_NE(FindFunction(stats, "spin"), nullptr);
+  ASSERT_GT(FindFunction(stats, "spin")->self_samples, 0);
+
+  std::ostringstream folded;
+  profiler.WriteFolded(folded);
+  ASSERT_NE(folded.str().find("<script>;spin "), std::string::npos);
+
+  std::ostringstream top;
+  profiler.WriteTop(top, 2);
+  ASSERT_NE(top.str().find("self ms"), std::string::npos);
+  ASSERT_NE(top.str().find(std::to_string(samples + 1) + " samples"),
+            std::string::npos);
+}
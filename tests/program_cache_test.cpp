@@ -0,0 +1,199 @@
+#include <filesystem>
+
+#include <gtest/gtest.h>
+#include <lib/ast_serializer.h>
+#include <lib/interpreter.h>
+
+namespace {
+
+std::string kCacheCode = R"(
+    add = function(a, b)
+        return a + b
+    end function
+
+    for i in range(0, 3, 1) then
+        if i == 1 then
+            print("one ")
+        else if i == 5 then
+            print("five ")
+        else
+            print(add(i, 10), " ")
+        end if
+    end for
+
+    i = 0
+    while true then
+        i += 1
+        if i == 2 then continue end if
+        if i > 3 then break end if
+        print(i)
+    end while
+
+    s = "abcdef"
+    l = [1, "x", nil, true]
+    n = -len(l)
+    print(s[1], l[1], n)
+)";
+
+std::filesystem::path MakeCacheDir(const std::string &name) {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+} // namespace
+
+TEST(ProgramCacheSuite, SerializeRoundTrip) {
+  auto root = ProgramCache::Global().Load(kCacheCode);
+  std::string image = SerializeProgram(*root);
+  auto restored = DeserializeProgram(image);
+
+  ASSERT_EQ(SerializeProgram(*restored), image);
+}
+
+TEST(ProgramCacheSuite, CorruptedImageIsRejected) {
+  auto root = ProgramCache::Global().Load(kCacheCode);
+  std::string image = SerializeProgram(*root);
+  image.resize(image.size() / 2);
+
+  ASSERT_THROW(DeserializeProgram(image), std::runtime_error);
+}
+
+TEST(ProgramCacheSuite, MissingRequiredChildIsRejected) {
+  AST::BlockNode root;
+  root.nodes.push_back(std::make_unique<AST::IfNode>(
+      nullptr, std::make_unique<AST::BlockNode>(),
+      std::vector<std::pair<std::unique_ptr<AST::BaseNode>,
+                            std::unique_ptr<AST::BlockNode>>>(),
+      nullptr));
+
+  ASSERT_THROW(DeserializeProgram(SerializeProgram(root)), std::runtime_error);
+}
+
+TEST(ProgramCacheSuite, DeepNestingIsRejected) {
+  std::string code = "x = " + std::string(2000, '-') + "1\nprint(x)";
+  auto root = ProgramCache::Global().Load(code);
+  ASSERT_THROW(DeserializeProgram(SerializeProgram(*root)),
+               std::runtime_error);
+
+  // Such a program still runs; it is parsed every time instead.
+  auto dir = MakeCacheDir("itmoscript_deep_cache_test");
+  InterpretOptions options;
+  options.cache_dir = dir.string();
+  for (int i = 0; i < 2; ++i) {
+    ProgramCache::Global().Clear();
+    std::istringstream input(code);
+    std::ostringstream output;
+    ASSERT_TRUE(interpret(input, output, options));
+    ASSERT_EQ(output.str(), "1");
+  }
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ProgramCacheSuite, MemoryCacheReusesProgram) {
+  ProgramCache cache(2);
+  auto first = cache.Load(kCacheCode);
+  auto second = cache.Load(kCacheCode);
+  ASSERT_EQ(first, second);
+
+  cache.Load("print(1)");
+  cache.Load("print(2)");
+  ASSERT_EQ(cache.Size(), 2);
+  ASSERT_NE(cache.Load(kCacheCode), first);
+}
+
+TEST(ProgramCacheSuite, RepeatedRunsGiveSameOutput) {
+  for (int i = 0; i < 3; ++i) {
+    std::istringstream input(kCacheCode);
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "10 one 12 13bx-4");
+  }
+}
+
+TEST(ProgramCacheSuite, DiskCacheIsWrittenAndLoaded) {
+  auto dir = MakeCacheDir("itmoscript_cache_test");
+  auto file = dir / ProgramCache::CacheFileName(kCacheCode);
+
+  ProgramCache writer(0);
+  writer.Load(kCacheCode, dir.string());
+  ASSERT_TRUE(std::filesystem::exists(file));
+
+  ProgramCache reader(0);
+  auto root = reader.Load(kCacheCode, dir.string());
+  ASSERT_EQ(SerializeProgram(*root),
+            SerializeProgram(*ProgramCache::Global().Load(kCacheCode)));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ProgramCacheSuite, BrokenCacheFileFallsBackToParser) {
+  auto dir = MakeCacheDir("itmoscript_broken_cache_test");
+  std::filesystem::create_directories(dir);
+  {
+    std::ofstream fout(dir / ProgramCache::CacheFileName(kCacheCode));
+    fout << "garbage";
+  }
+
+  InterpretOptions options;
+  options.cache_dir = dir.string();
+  ProgramCache::Global().Clear();
+
+  std::istringstream input(kCacheCode);
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output, options));
+  ASSERT_EQ(output.str(), "10 one 12 13bx-4");
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ProgramCacheSuite, CacheFileOfOtherSourceIsRejected) {
+  // A file claiming the hash and size of `code` but holding another
+  // program, as a hash collision would leave behind.
+  std::string code = "print(\"mine\")";
+  std::string other = "print(\"else\")";
+  ASSERT_EQ(code.size(), other.size());
+  auto dir = MakeCacheDir("itmoscript_collision_cache_test");
+  std::filesystem::create_directories(dir);
+  {
+    std::ofstream fout(dir / ProgramCache::CacheFileName(code),
+                       std::ios::binary);
+    uint64_t hash = HashSource(code);
+    uint64_t size = code.size();
+    fout << "ISC\x01" << kInterpreterVersion << '\0';
+    for (uint64_t field : {hash, size}) {
+      for (int i = 0; i < 8; ++i) {
+        fout.put(static_cast<char>((field >> (8 * i)) & 0xFF));
+      }
+    }
+    fout << SerializeProgram(*ProgramCache::Global().Load(other));
+  }
+
+  ProgramCache reader(0);
+  auto root = reader.Load(code, dir.string());
+  ASSERT_EQ(SerializeProgram(*root),
+            SerializeProgram(*ProgramCache::Global().Load(code)));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ProgramCacheSuite, FunctionLiteralEvaluatedTwice) {
+  std::string code = R"(
+        make = function()
+            return function(x) return x * 2 end function
+        end function
+
+        f = make()
+        g = make()
+        print(f(2), g(3))
+    )";
+
+  std::istringstream input(code);
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(), "46");
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/value_sort.h>
+
+#include "test_helpers.h"
+
+TEST(SortSuite, MixedTypes) {
+  ASSERT_EQ(RunScript(R"(
+        l = ["b", 2, nil, [1, 2], true, "a", -1, [1], false]
+        print(sort(l))
+    )"),
+            "[nil, false, true, -1, 2, a, b, [1], [1, 2]]");
+}
+
+TEST(SortSuite, KeyFunction) {
+  ASSERT_EQ(RunScript(R"(
+        by_len = function(s) return len(s) end function
+        l = ["ccc", "a", "bb", "d", "ee", "f"]
+        print(stable_sort(l, by_len))
+    )"),
+            "[a, d, f, bb, ee, ccc]");
+}
+
+TEST(SortSuite, NumbersWithNanAndSignedZero) {
+  std::vector<Value> values = {3.0, std::nan(""), -0.0, -5.0, 0.0, 1e300};
+  SortValues(values, nullptr, true);
+  ASSERT_EQ(std::get<double>(values[0]), -5.0);
+  ASSERT_TRUE(std::signbit(std::get<double>(values[1])));
+  ASSERT_FALSE(std::signbit(std::get<double>(values[2])));
+  ASSERT_EQ(std::get<double>(values[4]), 1e300);
+  ASSERT_TRUE(std::isnan(std::get<double>(values[5])));
+}
+
+TEST(SortSuite, LargeNumberList) {
+  std::mt19937 rng(239);
+  std::uniform_real_distribution<double> dist(-1e6, 1e6);
+  std::vector<double> expected(100000);
+  std::vector<Value> values;
+  for (double &d : expected) {
+    d = std::round(dist(rng));
+    values.push_back(d);
+  }
+  std::sort(expected.begin(), expected.end());
+
+  SortValues(values, nullptr, false);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(std::get<double>(values[i]), expected[i]);
+  }
+}
+
+TEST(SortSuite, LargeStringListIsStable) {
+  std::mt19937 rng(239);
+  std::vector<std::pair<std::string, double>> expected;
+  std::vector<Value> values, keys;
+  for (int i = 0; i < 100000; ++i) {
+    // Long common prefixes make the cached prefixes tie.
+    std::string key = "prefix-" + std::to_string(rng() % 5000);
+    expected.emplace_back(key, i);
+    keys.push_back(key);
+    values.push_back(static_cast<double>(i));
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](auto &a, auto &b) { return a.first < b.first; });
+
+  SortValues(values, &keys, true);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(std::get<double>(values[i]), expected[i].second);
+  }
+}
+
+TEST(SortSuite, FunctionsCanNotBeSorted) {
+  std::istringstream input("l = [print, 1] \n print(sort(l))");
+  std::ostringstream output;
+
+  ASSERT_FALSE(interpret(input, output));
+}
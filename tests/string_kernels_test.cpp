@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cctype>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/string_kernels.h>
+
+namespace {
+
+// Runs every check once per SIMD level this CPU supports.
+class StringKernelsTest : public ::testing::TestWithParam<SimdLevel> {
+protected:
+  void SetUp() override {
+    if (GetParam() > DetectSimdLevel()) {
+      GTEST_SKIP();
+    }
+    SetSimdLevel(GetParam());
+  }
+
+  void TearDown() override { SetSimdLevel(DetectSimdLevel()); }
+};
+
+std::string AsciiLower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+} // namespace
+
+TEST_P(StringKernelsTest, FindMatchesStdFind) {
+  std::string text;
+  for (int i = 0; i < 300; ++i) {
+    text += static_cast<char>('a' + i * 7 % 26);
+  }
+  for (std::string needle : {"a", "z", "ab", "hov", "xelsz", "aho", "#"}) {
+    for (size_t pos = 0; pos <= text.size(); pos += 13) {
+      ASSERT_EQ(FindSubstring(text, needle, pos), text.find(needle, pos))
+          << needle << " " << pos;
+    }
+  }
+  ASSERT_EQ(FindSubstring(text, "", 5), 5);
+  ASSERT_EQ(FindSubstring(text, "a", text.size() + 1), std::string::npos);
+}
+
+TEST_P(StringKernelsTest, FindAtEveryOffset) {
+  std::string text(100, '.');
+  for (size_t pos = 0; pos + 3 <= text.size(); ++pos) {
+    std::string s = text;
+    s.replace(pos, 3, "abc");
+    ASSERT_EQ(FindSubstring(s, "abc"), pos);
+    ASSERT_EQ(FindSubstring(s, "c"), pos + 2);
+  }
+}
+
+TEST_P(StringKernelsTest, AsciiCaseMapping) {
+  std::string text;
+  for (int i = 0; i < 200; ++i) {
+    text += static_cast<char>(32 + i * 13 % 95);
+  }
+  for (size_t len = 0; len <= text.size(); len += 7) {
+    std::string part = text.substr(len / 3, len - len / 3);
+    ASSERT_EQ(ToLowerUtf8(part), AsciiLower(part));
+  }
+  ASSERT_EQ(ToUpperUtf8("Hello, World! [`{@]"), "HELLO, WORLD! [`{@]");
+}
+
+TEST_P(StringKernelsTest, Utf8CaseMapping) {
+  std::string mixed = "Привет, Мир! ЁЖИК ёжик Ѐ ÀÉÎÕÜ × àéîõü ÷ 日本 🙂";
+  std::string long_mixed;
+  for (int i = 0; i < 10; ++i) {
+    long_mixed += "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ ";
+    long_mixed += mixed;
+  }
+
+  ASSERT_EQ(ToLowerUtf8(mixed),
+            "привет, мир! ёжик ёжик ѐ àéîõü × àéîõü ÷ 日本 🙂");
+  ASSERT_EQ(ToUpperUtf8(mixed),
+            "ПРИВЕТ, МИР! ЁЖИК ЁЖИК Ѐ ÀÉÎÕÜ × ÀÉÎÕÜ ÷ 日本 🙂");
+  ASSERT_EQ(ToUpperUtf8(ToLowerUtf8(long_mixed)), ToUpperUtf8(long_mixed));
+  ASSERT_EQ(ToLowerUtf8("АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯ"),
+            "абвгдежзийклмнопрстуфхцчшщъыьэюя");
+}
+
+TEST_P(StringKernelsTest, Utf8Validation) {
+  std::string ascii(100, 'a');
+  ASSERT_TRUE(IsValidUtf8(ascii + "Привет 日本 🙂" + ascii));
+  for (std::string bad : {"\x80", "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80",
+                          "\xF4\x90\x80\x80", "\xD0", "\xF0\x9F\x99"}) {
+    ASSERT_FALSE(IsValidUtf8(ascii + bad + ascii));
+    ASSERT_THROW(ToLowerUtf8(ascii + bad), std::runtime_error);
+  }
+}
+
+TEST_P(StringKernelsTest, Replace) {
+  std::string text;
+  for (int i = 0; i < 50; ++i) {
+    text += "one two three ";
+  }
+  std::string expected_longer, expected_shorter;
+  for (int i = 0; i < 50; ++i) {
+    expected_longer += "one 2222 three ";
+    expected_shorter += "one  three ";
+  }
+
+  ASSERT_EQ(ReplaceAll(text, "two", "2222"), expected_longer);
+  ASSERT_EQ(ReplaceAll(text, "two", ""), expected_shorter);
+  ASSERT_EQ(ReplaceAll("aaaa", "aa", "b"), "bb");
+  ASSERT_EQ(ReplaceAll("abc", "", "x"), "abc");
+  ASSERT_EQ(ReplaceAll("abc", "d", "x"), "abc");
+}
+
+INSTANTIATE_TEST_SUITE_P(StringKernelsSuite, StringKernelsTest,
+                         ::testing::Values(SimdLevel::SCALAR, SimdLevel::SSE2,
+                                           SimdLevel::AVX2));
+
+TEST(StringKernelsSuite, Builtins) {
+  std::string code = R"(
+        s = "Привет, Мир"
+        println(lower(s), " ", upper(s))
+        println(find(s, "Мир"), " ", find(s, "мир"))
+        chars = split("añ日", "")
+        println(len(chars), " ", chars[2])
+        println(replace("a-b-c", "-", "+-+"))
+    )";
+
+  std::istringstream input(code);
+  std::ostringstream output;
+
+  ASSERT_TRUE(interpret(input, output));
+  ASSERT_EQ(output.str(),
+            "привет, мир ПРИВЕТ, МИР\n14 -1\n3 日\na+-+b+-+c\n");
+}
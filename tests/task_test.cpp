@@ -0,0 +1,174 @@
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+#include "test_helpers.h"
+
+TEST(TaskSuite, SpawnAndAwait) {
+  ASSERT_EQ(RunScript(R"(
+        square = function(x)
+            return x * x
+        end function
+        t = spawn(square, 7)
+        print(await(t))
+        print(await_all([spawn(square, 1), spawn(square, 2), spawn(square, 3)]))
+    )"),
+            "49[1, 4, 9]");
+}
+
+TEST(TaskSuite, DivideAndConquer) {
+  ASSERT_EQ(RunScript(R"(
+        fib = function(n)
+            if n < 2 then
+                return n
+            end if
+            a = n - 1
+            b = n - 2
+            if n < 10 then
+                return fib(a) + fib(b)
+            end if
+            left = spawn(fib, a)
+            right = fib(b)
+            return await(left) + right
+        end function
+        print(fib(18))
+    )"),
+            "2584");
+}
+
+TEST(TaskSuite, OutputFollowsAwaitOrder) {
+  ASSERT_EQ(RunScript(R"(
+        say = function(s)
+            print(s)
+            return nil
+        end function
+        a = spawn(say, "a")
+        b = spawn(say, "b")
+        c = spawn(say, "c")
+        print("start ")
+        await(b)
+        await(a)
+        print(" end ")
+    )"),
+            "start ba end c");
+}
+
+TEST(TaskSuite, TasksSeeSnapshot) {
+  ASSERT_EQ(RunScript(R"(
+        counter = 1
+        read_counter = function()
+            counter += 10
+            return counter
+        end function
+        t = spawn(read_counter)
+        counter = 100
+        print(await(t), " ", counter)
+    )"),
+            "11 100");
+}
+
+TEST(TaskSuite, ErrorsPropagate) {
+  std::istringstream input(R"(
+        fail = function()
+            print("before ")
+            return 1 / 0
+        end function
+        t = spawn(fail)
+        await(t)
+        print("unreachable")
+    )");
+  std::ostringstream output;
+  ASSERT_FALSE(interpret(input, output));
+  ASSERT_EQ(output.str(), "before Division by 0\n");
+}
+
+TEST(TaskSuite, UnawaitedErrorFailsScript) {
+  std::istringstream input(R"(
+        fail = function()
+            return 1 / 0
+        end function
+        spawn(fail)
+        print("done ")
+    )");
+  std::ostringstream output;
+  ASSERT_FALSE(interpret(input, output));
+  ASSERT_EQ(output.str(), "done Division by 0\n");
+}
+
+TEST(TaskSuite, SnapshotTakenInLoop) {
+  ASSERT_EQ(RunScript(R"(
+        show = function()
+            return i
+        end function
+        tasks = []
+        for i in range(0, 5, 1) then
+            tasks = push(tasks, spawn(show))
+        end for
+        print(await_all(tasks), " ", i)
+    )"),
+            "[0, 1, 2, 3, 4] 4");
+}
+
+TEST(TaskSuite, ClosuresAreCopied) {
+  ASSERT_EQ(RunScript(R"(
+        make_counter = function()
+            n = 0
+            return function()
+                n += 1
+                return n
+            end function
+        end function
+        next = make_counter()
+        next()
+        twice = function()
+            next()
+            return next()
+        end function
+        t = spawn(twice)
+        a = next()
+        print(await(t), " ", a, " ", next())
+    )"),
+            "3 2 3");
+}
+
+TEST(TaskSuite, BuiltinsCanBeHidden) {
+  ASSERT_EQ(RunScript(R"(
+        hide = function()
+            len = 7
+            return len
+        end function
+        t = spawn(hide)
+        print(await(t), " ", len("abc"), " ", hide(), " ", len)
+    )"),
+            "7 3 7 7");
+}
+
+TEST(TaskSuite, TasksSplitSharedIterator) {
+  std::filesystem::path path = TempPath("itmoscript_task_test");
+  {
+    std::ofstream file(path);
+    for (int i = 0; i < 20000; ++i) {
+      file << i << "\n";
+    }
+  }
+
+  std::string result = RunScript(R"(
+        it = lines(")" + path.string() + R"(")
+        drain = function(x)
+            total = 0
+            for line in it then
+                total += parse_num(line)
+            end for
+            return total
+        end function
+        tasks = []
+        for i in range(0, 16, 1) then
+            tasks = push(tasks, spawn(drain, i))
+        end for
+        print(sum(await_all(tasks)))
+    )");
+  std::filesystem::remove(path);
+  ASSERT_EQ(result, "199990000");
+}
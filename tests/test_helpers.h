@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+
+// Output of a script that is expected to run without errors.
+inline std::string RunScript(const std::string &code) {
+  std::istringstream input(code);
+  std::ostringstream output;
+  EXPECT_TRUE(interpret(input, output));
+  return output.str();
+}
+
+// A path in the temp directory that no other test uses: ctest runs every
+// test in its own process, possibly at the same time.
+inline std::filesystem::path TempPath(const std::string &prefix) {
+  return std::filesystem::temp_directory_path() /
+         (prefix + "_" + std::to_string(::getpid()) + "_" +
+          ::testing::UnitTest::GetInstance()->current_test_info()->name());
+}
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <lib/interpreter.h>
+#include <lib/tracer.h>
+
+namespace {
+
+using std::chrono::hours;
+
+size_t Count(const std::string &text, const std::string &part) {
+  size_t count = 0;
+  for (size_t pos = text.find(part); pos != std::string::npos;
+       pos = text.find(part, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+std::string TraceScript(const std::string &code, TraceOptions options = {}) {
+  std::ostringstream trace;
+  Tracer tracer(trace, std::move(options));
+  tracer.Start();
+  std::istringstream input(code);
+  std::ostringstream output;
+  InterpretOptions interpret_options;
+  interpret_options.tracer = &tracer;
+  EXPECT_TRUE(interpret(input, output, interpret_options));
+  tracer.Stop();
+  return trace.str();
+}
+
+} // namespace
+
+TEST(TracerSuite, WritesBeginAndEndEvents) {
+  std::ostringstream trace;
+  Tracer tracer(trace);
+  tracer.Start();
+  ASSERT_TRUE(tracer.Begin(Tracer::Category::FUNCTION, "outer", 1500));
+  ASSERT_TRUE(tracer.Begin(Tracer::Category::BUILTIN, "say \"hi\"", 2000));
+  ASSERT_TRUE(tracer.End(Tracer::Category::BUILTIN, "say \"hi\"", 2250));
+  ASSERT_TRUE(tracer.End(Tracer::Category::FUNCTION, "outer", 3000));
+  tracer.Stop();
+
+  std::string json = trace.str();
+  ASSERT_EQ(tracer.Written(), 4);
+  ASSERT_TRUE(json.starts_with("{\"traceEvents\":["));
+  ASSERT_NE(json.find("{\"name\":\"outer\",\"cat\":\"function\",\"ph\":\"B\","
+                      "\"ts\":1.500,\"pid\":1,"),
+            std::string::npos);
+  ASSERT_NE(json.find("{\"name\":\"say \\\"hi\\\"\",\"cat\":\"builtin\","
+                      "\"ph\":\"E\",\"ts\":2.250,"),
+            std::string::npos);
+  ASSERT_NE(json.find("\"dropped_events\":0}}"), std::string::npos);
+}
+
+TEST(TracerSuite, RecordsPhasesAndCalls) {
+  std::string json = TraceScript(R"(
+trace_fib = function(n)
+    if n < 2 then
+        return n
+    end if
+    return trace_fib((n - 1)) + trace_fib((n - 2))
+end function
+result = trace_fib(5)
+print(result)
+)");
+
+  for (const char *phase : {"compile", "lex", "parse", "execute"}) {
+    ASSERT_EQ(Count(json, std::string("\"name\":\"") + phase +
+                              "\",\"cat\":\"phase\",\"ph\":\"B\""),
+              1)
+        << phase;
+  }
+  // trace_fib(5) makes 15 calls.
+  ASSERT_EQ(Count(json, "\"name\":\"trace_fib\",\"cat\":\"function\",\"ph\":\"B\""),
+            15);
+  ASSERT_EQ(Count(json, "\"name\":\"trace_fib\",\"cat\":\"function\",\"ph\":\"E\""),
+            15);
+  ASSERT_EQ(Count(json, "\"name\":\"print\",\"cat\":\"builtin\""), 2);
+}
+
+TEST(TracerSuite, FiltersAndSamplesCalls) {
+  std::string code = R"(
+for i in range(0, 100, 1) then
+    sampled_id = function(x)
+        return x
+    end function
+    x = abs(i)
+    sampled_id(x)
+end for
+)";
+  TraceOptions filtered;
+  filtered.filter = {"sampled"};
+  std::string json = TraceScript(code, filtered);
+  ASSERT_EQ(Count(json, "\"name\":\"sampled_id\",\"cat\":\"function\",\"ph\":\"B\""),
+            100);
+  ASSERT_EQ(Count(json, "\"name\":\"abs\""), 0);
+  ASSERT_EQ(Count(json, "\"name\":\"execute\""), 2);
+
+  TraceOptions sampled;
+  sampled.filter = {"sampled"};
+  sampled.sample_every = 10;
+  json = TraceScript(code, sampled);
+  ASSERT_EQ(Count(json, "\"name\":\"sampled_id\",\"cat\":\"function\",\"ph\":\"B\""),
+            10);
+  ASSERT_EQ(Count(json, "\"ph\":\"B\""), Count(json, "\"ph\":\"E\""));
+}
+
+TEST(TracerSuite, DropsShortCalls) {
+  TraceOptions options;
+  options.min_duration = hours(1);
+  std::string json = TraceScript(R"(
+short_call = function()
+    return 1
+end function
+short_call()
+)",
+                                 options);
+  ASSERT_EQ(Count(json, "short_call"), 0);
+  ASSERT_EQ(Count(json, "\"name\":\"execute\""), 2);
+}
+
+TEST(TracerSuite, CountsEventsThatDoNotFit) {
+  std::ostringstream trace;
+  TraceOptions options;
+  options.buffer_events = 4;
+  options.flush_interval = hours(1);
+  Tracer tracer(trace, options);
+  tracer.Start();
+  for (int i = 0; i < 10; ++i) {
+    tracer.Begin(Tracer::Category::FUNCTION, "f", i);
+  }
+  tracer.Stop();
+
+  ASSERT_EQ(tracer.Written(), 4);
+  ASSERT_EQ(tracer.Dropped(), 6);
+  ASSERT_NE(trace.str().find("\"dropped_events\":6}}"), std::string::npos);
+}
+
+TEST(TracerSuite, ScopeSkipsEndWhenBeginWasDropped) {
+  std::ostringstream trace;
+  TraceOptions options;
+  options.buffer_events = 2;
+  options.flush_interval = hours(1);
+  Tracer tracer(trace, options);
+  tracer.Start();
+  {
+    TraceScope outer(&tracer, Tracer::Category::FUNCTION, "outer");
+    TraceScope inner(&tracer, Tracer::Category::FUNCTION, "inner");
+    TraceScope dropped(&tracer, Tracer::Category::FUNCTION, "dropped");
+  }
+  tracer.Stop();
+
+  ASSERT_EQ(Count(trace.str(), "dropped\""), 0);
+  ASSERT_EQ(tracer.Dropped(), 3);
+}
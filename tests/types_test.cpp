@@ -33,3 +33,101 @@ TEST(TypesTestSuite, StringTest) {
     ASSERT_TRUE(interpret(input, output));
     ASSERT_EQ(output.str(), expected);
 }
+
+TEST(TypesTestSuite, StringSlices) {
+    std::string code = R"(
+        s = "abcdefghijklmnopqrstuvwxyz"
+        a = s[1:3]
+        b = s[:4]
+        c = s[20:]
+        d = s[2:22]
+        e = d[1:3]
+        println(a, " ", b, " ", c, " ", len(d), " ", e)
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "bc abcd uvwxyz 20 de\n");
+}
+
+TEST(TypesTestSuite, RepeatedConcatenation) {
+    std::string code = R"(
+        s = ""
+        for i in range(0, 2000, 1) then
+            s = s + "ab"
+        end for
+        t = s + "x"
+        u = s + "y"
+        s += "z"
+        println(len(s), " ", len(t), " ", len(u))
+        same = t == u
+        println(t[4000], u[4000], s[4000], " ", s[1:5], " ", same)
+        parts = split(s, "b")
+        println(len(parts), " ", parts[0], parts[2000])
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "4001 4001 4001\nxyz baba false\n2001 az\n");
+}
+
+TEST(TypesTestSuite, ListSlices) {
+    std::string code = R"(
+        l = range(0, 20, 1)
+        a = l[2:12]
+        b = a[1:3]
+        a = push(a, 239)
+        println(a, " ", b, " ", len(l))
+        c = l[:2] + l[18:]
+        d = l[5:15] * 0.5
+        println(c, " ", d)
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "[2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 239] [3, 4] 20\n"
+                            "[0, 1, 18, 19] [5, 6, 7, 8, 9]\n");
+}
+
+TEST(TypesTestSuite, SplitParts) {
+    std::string code = R"(
+        s = "a first long field;second long field;x"
+        parts = split(s, ";")
+        f = parts[1]
+        g = f[7:11]
+        x = parts[2] == "x"
+        println(len(parts), " ", f, " ", g, " ", x)
+        for p in parts then
+            print(upper(p[0]))
+        end for
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(interpret(input, output));
+    ASSERT_EQ(output.str(), "3 second long field long true\nASX");
+}
+
+TEST(TypesTestSuite, SliceOfSliceDoesNotPinOwner) {
+    Value s(std::string(4096, 'a'));
+    Value quarter = s.Slice(0, 1024);
+    ASSERT_TRUE(std::holds_alternative<StringSlice>(quarter));
+    // A quarter of its parent, but a sixteenth of the buffer it would pin.
+    Value part = quarter.Slice(0, 256);
+    ASSERT_TRUE(std::holds_alternative<std::string>(part));
+    ASSERT_EQ(part.GetStringView(), std::string(256, 'a'));
+
+    Value l(std::vector<Value>(4096, Value(1.0)));
+    Value l_quarter = l.Slice(0, 1024);
+    ASSERT_TRUE(std::holds_alternative<ListSlice>(l_quarter));
+    Value l_part = l_quarter.Slice(0, 256);
+    ASSERT_TRUE(std::holds_alternative<std::vector<Value>>(l_part));
+    ASSERT_EQ(l_part.GetListView().size(), 256);
+}